@@ -0,0 +1,73 @@
+#include "arena.h"
+
+namespace ip {
+
+// -----------------------------------------------------------------------------
+Arena::Arena(                       // constructor
+    u64   capacity,                     // bytes of the first chunk
+    const Huge_Alloc &alloc)            // backing & account of chunks
+    : capacity_(std::max(capacity, ARENA_ALIGN)), total_(0UL), used_(0UL), 
+    alloc_(alloc)
+{
+    add_chunk(capacity_);
+}
+
+// -----------------------------------------------------------------------------
+Arena::~Arena()                     // destructor
+{
+    release();
+}
+
+// -----------------------------------------------------------------------------
+void Arena::add_chunk(              // add a chunk
+    u64   size)                         // number of bytes
+{
+    // reserve ARENA_ALIGN more bytes to align the first array of the chunk
+    chunks_.push_back((char*) huge_alloc(size + ARENA_ALIGN, alloc_));
+    sizes_.push_back(size + ARENA_ALIGN);
+    total_ += size + ARENA_ALIGN;
+    used_   = 0UL;
+}
+
+// -----------------------------------------------------------------------------
+void* Arena::alloc_bytes(           // allocate bytes (aligned)
+    u64   size)                         // number of bytes
+{
+    if (chunks_.empty()) add_chunk(capacity_);
+    
+    // align the next free byte of the last chunk, and add a chunk if the
+    // array does not fit in the rest of it
+    u64 base  = (u64) chunks_.back();
+    u64 start = (base + used_ + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+    if (start - base + size > sizes_.back()) {
+        add_chunk(std::max(size, capacity_));
+        base  = (u64) chunks_.back();
+        start = (base + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+    }
+    used_ = start - base + size;
+    
+    return (void*) start;
+}
+
+// -----------------------------------------------------------------------------
+void Arena::release()               // release all arrays (and chunks)
+{
+    for (auto chunk : chunks_) huge_free(chunk);
+    std::vector<char*>().swap(chunks_);
+    std::vector<u64>().swap(sizes_);
+    total_ = 0UL; used_ = 0UL;
+}
+
+// -----------------------------------------------------------------------------
+void Arena::reset()                 // release all arrays (keep the first chunk)
+{
+    // the first chunk is reused by the arrays allocated next, e.g., by the 
+    // payload of the next leaf streamed out of a cone-tree
+    for (size_t i = 1; i < chunks_.size(); ++i) huge_free(chunks_[i]);
+    chunks_.resize(std::min(chunks_.size(), (size_t) 1));
+    sizes_.resize(chunks_.size());
+    total_ = sizes_.empty() ? 0UL : sizes_[0];
+    used_  = 0UL;
+}
+
+} // end namespace ip
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <iostream>
+#include <algorithm>
+#include <vector>
+
+#include "def.h"
+#include "huge_page.h"
+
+namespace ip {
+
+const u64 ARENA_ALIGN = 64;         // alignment of arrays (a cache line)
+
+// -----------------------------------------------------------------------------
+//  Arena: a bump allocator of arrays, which are released all at once (by
+//  release() or the destructor) rather than one by one
+//
+//  The first chunk is sized up front by the caller; if it is exhausted, a
+//  new chunk (of at least the same size) is added, so that an arena never
+//  fails but only loses the contiguity across chunks. The arrays are placed
+//  in the order of allocation, each aligned to ARENA_ALIGN bytes. The chunks
+//  are allocated by huge_alloc() with the allocator of the arena
+// -----------------------------------------------------------------------------
+class Arena {
+public:
+    // -------------------------------------------------------------------------
+    Arena(                          // constructor
+        u64   capacity,                 // bytes of the first chunk
+        const Huge_Alloc &alloc);       // backing & account of chunks
+    
+    // -------------------------------------------------------------------------
+    ~Arena();                       // destructor
+    
+    // -------------------------------------------------------------------------
+    template<class T>
+    T* alloc(                       // allocate an array (uninitialized)
+        u64   n) {                      // number of elements
+        return (T*) alloc_bytes(sizeof(T)*n);
+    }
+    
+    // -------------------------------------------------------------------------
+    void* alloc_bytes(              // allocate bytes (aligned)
+        u64   size);                    // number of bytes
+    
+    // -------------------------------------------------------------------------
+    void release();                 // release all arrays (and chunks)
+    
+    // -------------------------------------------------------------------------
+    void reset();                   // release all arrays (keep the first chunk)
+    
+    // -------------------------------------------------------------------------
+    int num_chunks() const { return (int) chunks_.size(); } // # chunks
+    
+    // -------------------------------------------------------------------------
+    u64 get_estimated_memory() const { return total_; } // bytes of chunks
+
+protected:
+    u64   capacity_;                // bytes of the first chunk
+    u64   total_;                   // bytes of all chunks
+    u64   used_;                    // bytes used in the last chunk
+    Huge_Alloc alloc_;              // backing & account of chunks
+    std::vector<char*> chunks_;     // chunks (by huge_alloc())
+    std::vector<u64>   sizes_;      // bytes of chunks
+    
+    // -------------------------------------------------------------------------
+    void add_chunk(                 // add a chunk
+        u64   size);                    // number of bytes
+};
+
+} // end namespace ip
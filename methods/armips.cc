@@ -1,28 +1,62 @@
 #pragma once
 
 #include <cstdint>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
 #include "armips.h"
 
 namespace ip {
 
+// -----------------------------------------------------------------------------
+static void update_index_info(      // update global pre-processing time & memory
+    Reverse_KMIPS *index)               // index of a method
+{
+    g_pre_time = index->pre_time_;
+    g_memory   = index->get_estimated_memory();
+    
+    // the measured memory is the bytes of the arrays & arenas of this index 
+    // (without the shared artifacts), and the peak rss is since its build
+    g_heap_memory = index->heap_bytes_.load();
+    g_build_rss   = get_peak_rss();
+    g_huge_mode   = index->alloc_.mode_;
+    get_huge_memory(g_huge_mapped, g_huge_backed);
+}
+
+// -----------------------------------------------------------------------------
+static void update_query_stats(     // update global query time & # ip
+    const Query_Stats &stats)           // stats of a query
+{
+    g_run_time += stats.time_;
+    g_ip_count += stats.ip_count_;
+    
+    g_latency.add((u64) (stats.time_ * 1000000000.0));
+    g_ip_hist.add(stats.ip_count_);
+    g_prune.add(stats.prune_);
+}
+
 // -----------------------------------------------------------------------------
 int ground_truth(                   // generate ground truth results for query
     int   n,                            // item  cardinality
     int   m,                            // user  cardinality
     int   qn,                           // query cardinality
     int   d,                            // dimensionality
+    int   huge,                         // backing of big arrays (HUGE_*)
     const char  *truth_addr,            // address of truth set
     const float *item_set,              // set of item  vectors
     const float *user_set,              // set of user  vectors
     const float *query_set)             // set of query vectors
 {
     // pre-processing
-    Scan *scan = new Scan(n, m, d, K_MAX, true, item_set, user_set);
+    reset_peak_rss(); // the peak rss of build is since here
+    Scan *scan = new Scan(n, m, d, K_MAX, true, huge, item_set, user_set);
+    update_index_info(scan);
     scan->display();
     
-    // find ground truth results
+    // find ground truth results (in both csv & binary formats)
     std::vector<std::vector<int> > truth; // ground truth
     std::vector<int> result;              // results by this method
+    Truth_Set *truth_set = new Truth_Set(m);
     
     for (int k : Ks) {
         init_global_metric();
@@ -30,12 +64,16 @@ int ground_truth(                   // generate ground truth results for query
         for (int i = 0; i < qn; ++i) {
             const float *query = query_set + (u64) i*d;
             scan->reverse_kmips(k, query, result);
+            update_query_stats(scan->stats_);
             truth.push_back(result);
         }
         if (write_ground_truth(k, qn, truth_addr, truth)) return 1;
         
+        truth_set->build(qn, truth);
+        if (truth_set->save(k, truth_addr)) return 1;
         std::vector<std::vector<int> >().swap(truth);
     }
+    delete truth_set;
     delete scan;
     return 0;
 }
@@ -46,6 +84,7 @@ int exhaustive_scan(                // Exhaustive_Scan
     int   m,                            // user  cardinality
     int   qn,                           // query cardinality
     int   d,                            // dimensionality
+    int   huge,                         // backing of big arrays (HUGE_*)
     const char  *method_name,           // method name
     const char  *truth_addr,            // address of truth set
     const char  *out_folder,            // output folder
@@ -58,26 +97,28 @@ int exhaustive_scan(                // Exhaustive_Scan
     if (!fp) { printf("Could not create %s\n", fname); return 1; }
     
     // pre-processing
-    Scan *scan = new Scan(n, m, d, K_MAX, false, item_set, user_set);
+    reset_peak_rss(); // the peak rss of build is since here
+    Scan *scan = new Scan(n, m, d, K_MAX, false, huge, item_set, user_set);
+    update_index_info(scan);
     write_index_info(fp);
     
     // online query for reverse k-maximum inner product search
-    std::vector<std::vector<int> > truth; // ground truth
+    Truth_Set *truth = new Truth_Set(m);  // ground truth
     std::vector<int> result;              // results by this method
     
-    head(method_name);
+    head(method_name, fp);
     for (int k : Ks) {
-        read_ground_truth(k, qn, truth_addr, truth);
+        truth->load(k, qn, truth_addr);
         init_global_metric();
         
         for (int i = 0; i < qn; ++i) {
             const float *query = query_set + (u64) i*d;
             scan->reverse_kmips(k, query, result);
+            update_query_stats(scan->stats_);
             
-            update_global_metric(truth[i], result);
+            truth->update_global_metric(i, result);
         }
         calc_and_write_global_metric(k, qn, fp);
-        std::vector<std::vector<int> >().swap(truth);
     }
     foot(fp);
     fclose(fp);
@@ -89,6 +130,196 @@ int exhaustive_scan(                // Exhaustive_Scan
     // float ip = calc_inner_product(d, query_set+i*d, user_set+j*d);
     // printf("ip=%f, %d-th mip=%f\n", ip, k, scan->lower_bound_[j*K_MAX+k-1]);
     
+    delete truth;
+    delete scan;
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+static void close_truth_parts(      // close & remove the partial truth files
+    int   num_k,                        // number of k values
+    const char *truth_addr,             // address of truth set
+    FILE  **part)                       // partial truth files (nullptr: none)
+{
+    char fname[200];
+    for (int j = 0; j < num_k; ++j) {
+        if (part[j] == nullptr) continue;
+        
+        fclose(part[j]);
+        sprintf(fname, "%s_k=%d.part", truth_addr, Ks[j]);
+        remove(fname);
+    }
+    delete[] part;
+}
+
+// -----------------------------------------------------------------------------
+int ground_truth_stream(            // generate ground truth by user chunks
+    int   n,                            // item  cardinality
+    int   m,                            // user  cardinality
+    int   qn,                           // query cardinality
+    int   d,                            // dimensionality
+    int   chunk,                        // # users of a chunk
+    int   huge,                         // backing of big arrays (HUGE_*)
+    const char  *truth_addr,            // address of truth set
+    const char  *users_addr,            // address of user  set
+    const float *item_set,              // set of item  vectors
+    const float *query_set)             // set of query vectors
+{
+    // open the k bounds file & the partial truth file for each k (before
+    // the pre-processing, so that a failure only closes the files)
+    int  num_k = (int) Ks.size();
+    char fname[200]; sprintf(fname, "%s_bounds.bin", truth_addr);
+    FILE *fp = fopen(fname, "wb");
+    if (!fp) { printf("Could not create %s\n", fname); return 1; }
+    
+    FILE **part = new FILE*[num_k]();
+    for (int j = 0; j < num_k; ++j) {
+        sprintf(fname, "%s_k=%d.part", truth_addr, Ks[j]);
+        part[j] = fopen(fname, "wb+");
+        if (!part[j]) {
+            printf("Could not create %s\n", fname);
+            close_truth_parts(num_k, truth_addr, part); fclose(fp); return 1;
+        }
+    }
+    
+    // pre-processing (only the sorted item_set is resident)
+    reset_peak_rss(); // the peak rss of build is since here
+    Scan *scan = new Scan(n, d, K_MAX, chunk, true, huge, item_set);
+    float *user_set = new float[(u64) chunk*d];
+    double *run_time = new double[num_k]();
+    u64    *ip_count = new u64[num_k]();
+    
+    // find the k bounds & ground truth results chunk by chunk, and write them
+    // to disk incrementally
+    int ret = 0;
+    std::vector<int> result; // results by this method
+    for (int start = 0; start < m; start += chunk) {
+        int cnt = std::min(chunk, m - start);
+        if (read_bin_data(start, cnt, d, users_addr, user_set)) {
+            ret = 1; break;
+        }
+        
+        scan->load_users(cnt, user_set);
+        fwrite(scan->k_bounds_, sizeof(float), (u64) cnt*K_MAX, fp);
+        
+        for (int j = 0; j < num_k; ++j) {
+            init_global_metric();
+            for (int i = 0; i < qn; ++i) {
+                const float *query = query_set + (u64) i*d;
+                scan->reverse_kmips(Ks[j], query, result);
+                update_query_stats(scan->stats_);
+                write_ground_truth_part(i, start, result, part[j]);
+            }
+            run_time[j] += g_run_time;
+            ip_count[j] += g_ip_count;
+        }
+        printf("users [%d, %d): %g Seconds\n", start, start+cnt, 
+            scan->pre_time_);
+    }
+    fclose(fp);
+    if (ret == 0) {
+        update_index_info(scan);
+        scan->display();
+    }
+    
+    // merge the partial truth of all chunks for each k (and write them in 
+    // both csv & binary formats)
+    std::vector<std::vector<int> > truth; // ground truth
+    Truth_Set *truth_set = new Truth_Set(m);
+    for (int j = 0; j < num_k && ret == 0; ++j) {
+        init_global_metric();
+        g_run_time = run_time[j];
+        g_ip_count = ip_count[j];
+        
+        if (read_ground_truth_part(qn, part[j], truth) ||
+            write_ground_truth(Ks[j], qn, truth_addr, truth)) {
+            ret = 1; break;
+        }
+        truth_set->build(qn, truth);
+        if (truth_set->save(Ks[j], truth_addr)) { ret = 1; break; }
+        std::vector<std::vector<int> >().swap(truth);
+    }
+    close_truth_parts(num_k, truth_addr, part);
+    delete truth_set;
+    delete[] run_time;
+    delete[] ip_count;
+    delete[] user_set;
+    delete scan;
+    return ret;
+}
+
+// -----------------------------------------------------------------------------
+int exhaustive_scan_stream(         // Exhaustive_Scan by user chunks
+    int   n,                            // item  cardinality
+    int   m,                            // user  cardinality
+    int   qn,                           // query cardinality
+    int   d,                            // dimensionality
+    int   chunk,                        // # users of a chunk
+    int   huge,                         // backing of big arrays (HUGE_*)
+    const char  *method_name,           // method name
+    const char  *truth_addr,            // address of truth set
+    const char  *out_folder,            // output folder
+    const char  *users_addr,            // address of user  set
+    const float *item_set,              // set of item  vectors
+    const float *query_set)             // set of query vectors
+{
+    char fname[200]; sprintf(fname, "%s%s.csv", out_folder, method_name);
+    FILE *fp = fopen(fname, "w");
+    if (!fp) { printf("Could not create %s\n", fname); return 1; }
+    
+    // pre-processing (only the sorted item_set is resident)
+    reset_peak_rss(); // the peak rss of build is since here
+    Scan *scan = new Scan(n, d, K_MAX, chunk, false, huge, item_set);
+    float *user_set = new float[(u64) chunk*d];
+    
+    // online query for reverse k-maximum inner product search chunk by chunk,
+    // and merge the results of all chunks
+    int num_k = (int) Ks.size();
+    std::vector<std::vector<std::vector<int> > > results(num_k, 
+        std::vector<std::vector<int> >(qn));
+    std::vector<Query_Stats> stats((u64) num_k*qn); // of all chunks
+    for (auto &s : stats) s.reset();
+    
+    std::vector<int> result; // results by this method
+    for (int start = 0; start < m; start += chunk) {
+        int cnt = std::min(chunk, m - start);
+        if (read_bin_data(start, cnt, d, users_addr, user_set)) {
+            fclose(fp); delete[] user_set; delete scan; return 1;
+        }
+        
+        scan->load_users(cnt, user_set);
+        for (int j = 0; j < num_k; ++j) {
+            for (int i = 0; i < qn; ++i) {
+                const float *query = query_set + (u64) i*d;
+                scan->reverse_kmips(Ks[j], query, result);
+                
+                stats[(u64) j*qn+i].add(scan->stats_);
+                
+                std::vector<int> &all = results[j][i];
+                for (int id : result) all.push_back(id + start);
+            }
+        }
+    }
+    update_index_info(scan);
+    write_index_info(fp);
+    
+    Truth_Set *truth = new Truth_Set(m);  // ground truth
+    head(method_name, fp);
+    for (int j = 0; j < num_k; ++j) {
+        truth->load(Ks[j], qn, truth_addr);
+        init_global_metric();
+        
+        for (int i = 0; i < qn; ++i) {
+            update_query_stats(stats[(u64) j*qn+i]);
+            truth->update_global_metric(i, results[j][i]);
+        }
+        calc_and_write_global_metric(Ks[j], qn, fp);
+    }
+    foot(fp);
+    fclose(fp);
+    
+    delete[] user_set;
+    delete truth;
     delete scan;
     return 0;
 }
@@ -101,24 +332,29 @@ int sa_simpfer(                     // SA_ALSH + Simpfer
     int   d,                            // dimensionality
     int   K,                            // # hash tables
     float b,                            // interval ratio for blocking items
+    int   huge,                         // backing of big arrays (HUGE_*)
     const char  *method_name,           // method name
     const char  *truth_addr,            // address of truth set
     const char  *out_folder,            // output folder
     const float *item_set,              // set of item  vectors
     const float *user_set,              // set of user  vectors
-    const float *query_set)             // set of query vectors
+    const float *query_set,             // set of query vectors
+    const Lower_Bounds *lb)             // precomputed lower bounds
 {
     char fname[200]; sprintf(fname, "%s%s.csv", out_folder, method_name);
     FILE *fp = fopen(fname, "a+");
     if (!fp) { printf("Could not create %s\n", fname); return 1; }
     
     // pre-processing
-    SA_Simpfer *lsh = new SA_Simpfer(n, m, d, K_MAX, K, b, item_set, user_set);
+    reset_peak_rss(); // the peak rss of build is since here
+    SA_Simpfer *lsh = new SA_Simpfer(n, m, d, K_MAX, K, b, huge, item_set, 
+        user_set, lb);
+    update_index_info(lsh);
     lsh->display();
     write_index_info(fp);
     
     // online query for reverse k-maximum inner product search
-    std::vector<std::vector<int> > truth; // ground truth
+    Truth_Set *truth = new Truth_Set(m);  // ground truth
     std::vector<int> result;              // results by this method
     
     write_params(K, b, method_name, fp);
@@ -126,23 +362,24 @@ int sa_simpfer(                     // SA_ALSH + Simpfer
         // char k_fname[200]; 
         // sprintf(k_fname, "%s%s_k=%d.csv", out_folder, method_name, k);
         
-        read_ground_truth(k, qn, truth_addr, truth);
+        truth->load(k, qn, truth_addr);
         init_global_metric();
         
         for (int i = 0; i < qn; ++i) {
             const float *query = query_set + (u64) i*d;
             lsh->reverse_kmips(k, query, result);
+            update_query_stats(lsh->stats_);
             
-            update_global_metric(truth[i], result);
+            truth->update_global_metric(i, result);
             // output_reverse_kmips_results(i, result, k_fname);
         }
         calc_and_write_global_metric(k, qn, fp);
-        std::vector<std::vector<int> >().swap(truth);
         std::vector<int>().swap(result);
     }
     foot(fp);
     fclose(fp);
     
+    delete truth;
     delete lsh;
     return 0;
 }
@@ -156,34 +393,33 @@ int sa_cone(                        // SA_ALSH + Cone-Tree Blocking
     int   K,                            // # hash tables
     int   leaf,                         // leaf size of Cone-Tree
     float b,                            // interval ratio for blocking items
+    int   huge,                         // backing of big arrays (HUGE_*)
     const char  *method_name,           // method name
     const char  *truth_addr,            // address of truth set
     const char  *out_folder,            // output folder
     const float *item_set,              // set of item  vectors
     const float *user_set,              // set of user  vectors
-    const float *query_set)             // set of query vectors
+    const float *query_set,             // set of query vectors
+    const Lower_Bounds *lb)             // precomputed lower bounds
 {
     char fname[200]; sprintf(fname, "%s%s_%d.csv", out_folder, method_name, K);
     FILE *fp = fopen(fname, "a+");
     if (!fp) { printf("Could not create %s\n", fname); return 1; }
     
     // normalized the user set
-    float *norm_user_set = new float[m*d];
-    for (int i = 0; i < m; ++i) {
-        const float *user = user_set + (u64) i*d;
-        float norm = sqrt(calc_inner_product(d, user, user));
-        
-        float *new_user = norm_user_set + (u64)i*d;
-        for (int j = 0; j < d; ++j) new_user[j] = user[j] / norm;
-    }
+    float *norm_user_set = new float[(u64) m*d];
+    normalize_data(m, d, user_set, nullptr, norm_user_set);
     
     // pre-processing
-    SA_CONE *lsh = new SA_CONE(n, m, d, K_MAX, K, leaf, b, item_set, norm_user_set);
+    reset_peak_rss(); // the peak rss of build is since here
+    SA_CONE *lsh = new SA_CONE(n, m, d, K_MAX, K, leaf, b, huge, item_set, 
+        norm_user_set, nullptr, lb);
+    update_index_info(lsh);
     lsh->display();
     write_index_info(fp);
     
     // online query for reverse k-maximum inner product search
-    std::vector<std::vector<int> > truth; // ground truth
+    Truth_Set *truth = new Truth_Set(m);  // ground truth
     std::vector<int> result;              // results by this method
     
     write_params(K, leaf, b, method_name, fp);
@@ -191,28 +427,136 @@ int sa_cone(                        // SA_ALSH + Cone-Tree Blocking
         // char k_fname[200]; 
         // sprintf(k_fname, "%s%s_k=%d.csv", out_folder, method_name, k);
         
-        read_ground_truth(k, qn, truth_addr, truth);
+        truth->load(k, qn, truth_addr);
         init_global_metric();
         
         for (int i = 0; i < qn; ++i) {
             const float *query = query_set + (u64) i*d;
             lsh->reverse_kmips(k, query, result);
+            update_query_stats(lsh->stats_);
             
-            update_global_metric(truth[i], result);
+            truth->update_global_metric(i, result);
             // output_reverse_kmips_results(i, result, k_fname);
         }
         calc_and_write_global_metric(k, qn, fp);
-        std::vector<std::vector<int> >().swap(truth);
         std::vector<int>().swap(result);
     }
     foot(fp);
     fclose(fp);
     
+    delete truth;
     delete lsh;
     delete[] norm_user_set;
     return 0;
 }
 
+// -----------------------------------------------------------------------------
+static int normalize_users_stream(  // normalize users by chunks to a file
+    int   m,                            // user cardinality
+    int   d,                            // dimensionality
+    int   chunk,                        // # users of a chunk
+    const char *users_addr,             // address of user set
+    const char *norm_addr)              // address of normalized users (return)
+{
+    FILE *fp = fopen(norm_addr, "wb");
+    if (!fp) { printf("Could not create %s\n", norm_addr); return 1; }
+    
+    int ret = 0;
+    float *user_set = new float[(u64) chunk*d];
+    for (int start = 0; start < m; start += chunk) {
+        int cnt = std::min(chunk, m - start);
+        if (read_bin_data(start, cnt, d, users_addr, user_set)) {
+            ret = 1; break;
+        }
+        normalize_data(cnt, d, user_set, nullptr, user_set);
+        if (fwrite(user_set, sizeof(float), (u64) cnt*d, fp) != 
+            (u64) cnt*d) {
+            printf("Could not write %s\n", norm_addr); ret = 1; break;
+        }
+    }
+    delete[] user_set;
+    if (fclose(fp) != 0) ret = 1;
+    return ret;
+}
+
+// -----------------------------------------------------------------------------
+int sa_cone_stream(                 // SA_Cone with disk-resident leaves
+    int   n,                            // item  cardinality
+    int   m,                            // user  cardinality
+    int   qn,                           // query cardinality
+    int   d,                            // dimensionality
+    int   K,                            // # hash tables
+    int   leaf,                         // leaf size of Cone-Tree
+    float b,                            // interval ratio for blocking items
+    int   chunk,                        // # users of a chunk
+    int   huge,                         // backing of big arrays (HUGE_*)
+    const char  *method_name,           // method name
+    const char  *truth_addr,            // address of truth set
+    const char  *out_folder,            // output folder
+    const char  *users_addr,            // address of user  set
+    const char  *leaf_addr,             // address of leaf file
+    const float *item_set,              // set of item  vectors
+    const float *query_set)             // set of query vectors
+{
+    char fname[200]; sprintf(fname, "%s%s_%d.csv", out_folder, method_name, K);
+    FILE *fp = fopen(fname, "a+");
+    if (!fp) { printf("Could not create %s\n", fname); return 1; }
+    
+    // normalize the user set by chunks to a file next to the leaf file, and
+    // map it read-only for the tree build, so that the users are never held
+    // in the heap but paged in (and out) by the kernel
+    char norm_addr[220]; sprintf(norm_addr, "%s.users", leaf_addr);
+    u64  size = sizeof(float)*(u64) m*d;
+    if (normalize_users_stream(m, d, chunk, users_addr, norm_addr)) {
+        remove(norm_addr); fclose(fp); return 1;
+    }
+    int fd = open(norm_addr, O_RDONLY);
+    void *norm_user_set = fd < 0 ? MAP_FAILED : 
+        mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (fd >= 0) close(fd);
+    if (norm_user_set == MAP_FAILED) {
+        printf("Could not map %s\n", norm_addr); 
+        remove(norm_addr); fclose(fp); return 1;
+    }
+    
+    // pre-processing (each leaf is written to the leaf file as it is built,
+    // and then the normalized users are dropped)
+    reset_peak_rss(); // the peak rss of build is since here
+    SA_CONE *lsh = new SA_CONE(n, m, d, K_MAX, K, leaf, b, huge, item_set, 
+        (const float*) norm_user_set, leaf_addr, nullptr);
+    munmap(norm_user_set, size);
+    remove(norm_addr);
+    update_index_info(lsh);
+    lsh->display();
+    write_index_info(fp);
+    
+    // online query for reverse k-maximum inner product search
+    Truth_Set *truth = new Truth_Set(m);  // ground truth
+    std::vector<int> result;              // results by this method
+    
+    write_params(K, leaf, b, method_name, fp);
+    for (int k : Ks) {
+        truth->load(k, qn, truth_addr);
+        init_global_metric();
+        
+        for (int i = 0; i < qn; ++i) {
+            const float *query = query_set + (u64) i*d;
+            lsh->reverse_kmips(k, query, result);
+            update_query_stats(lsh->stats_);
+            
+            truth->update_global_metric(i, result);
+        }
+        calc_and_write_global_metric(k, qn, fp);
+        std::vector<int>().swap(result);
+    }
+    foot(fp);
+    fclose(fp);
+    
+    delete truth;
+    delete lsh;
+    return 0;
+}
+
 // -----------------------------------------------------------------------------
 int h2_alsh(                        // H2_ALSH
     int   n,                            // item  cardinality
@@ -220,6 +564,7 @@ int h2_alsh(                        // H2_ALSH
     int   qn,                           // query cardinality
     int   d,                            // dimensionality
     float b,                            // interval ratio for blocking items
+    int   huge,                         // backing of big arrays (HUGE_*)
     const char  *method_name,           // method name
     const char  *truth_addr,            // address of truth set
     const char  *out_folder,            // output folder
@@ -232,12 +577,14 @@ int h2_alsh(                        // H2_ALSH
     if (!fp) { printf("Could not create %s\n", fname); return 1; }
     
     // pre-processing
-    H2_ALSH *lsh = new H2_ALSH(n, m, d, b, item_set, user_set);
+    reset_peak_rss(); // the peak rss of build is since here
+    H2_ALSH *lsh = new H2_ALSH(n, m, d, b, huge, item_set, user_set);
+    update_index_info(lsh);
     lsh->display();
     write_index_info(fp);
     
     // online query for reverse k-maximum inner product search
-    std::vector<std::vector<int> > truth; // ground truth
+    Truth_Set *truth = new Truth_Set(m);  // ground truth
     std::vector<int> result;              // results by this method
     
     write_params(b, method_name, fp);
@@ -245,23 +592,24 @@ int h2_alsh(                        // H2_ALSH
         // char k_fname[200]; 
         // sprintf(k_fname, "%s%s_k=%d.csv", out_folder, method_name, k);
         
-        read_ground_truth(k, qn, truth_addr, truth);
+        truth->load(k, qn, truth_addr);
         init_global_metric();
         
         for (int i = 0; i < qn; ++i) {
             const float *query = query_set + (u64) i*d;
             lsh->reverse_kmips(k, query, result);
+            update_query_stats(lsh->stats_);
             
-            update_global_metric(truth[i], result);
+            truth->update_global_metric(i, result);
             // output_reverse_kmips_results(i, result, k_fname);
         }
         calc_and_write_global_metric(k, qn, fp);
-        std::vector<std::vector<int> >().swap(truth);
         std::vector<int>().swap(result);
     }
     foot(fp);
     fclose(fp);
     
+    delete truth;
     delete lsh;
     return 0;
 }
@@ -273,24 +621,29 @@ int h2_simpfer(                     // H2_ALSH + Simpfer
     int   qn,                           // query cardinality
     int   d,                            // dimensionality
     float b,                            // interval ratio for blocking items
+    int   huge,                         // backing of big arrays (HUGE_*)
     const char  *method_name,           // method name
     const char  *truth_addr,            // address of truth set
     const char  *out_folder,            // output folder
     const float *item_set,              // set of item  vectors
     const float *user_set,              // set of user  vectors
-    const float *query_set)             // set of query vectors
+    const float *query_set,             // set of query vectors
+    const Lower_Bounds *lb)             // precomputed lower bounds
 {
     char fname[200]; sprintf(fname, "%s%s.csv", out_folder, method_name);
     FILE *fp = fopen(fname, "a+");
     if (!fp) { printf("Could not create %s\n", fname); return 1; }
     
     // pre-processing
-    H2_Simpfer *lsh = new H2_Simpfer(n, m, d, K_MAX, b, item_set, user_set);
+    reset_peak_rss(); // the peak rss of build is since here
+    H2_Simpfer *lsh = new H2_Simpfer(n, m, d, K_MAX, b, huge, item_set, 
+        user_set, lb);
+    update_index_info(lsh);
     lsh->display();
     write_index_info(fp);
     
     // online query for reverse k-maximum inner product search
-    std::vector<std::vector<int> > truth; // ground truth
+    Truth_Set *truth = new Truth_Set(m);  // ground truth
     std::vector<int> result;              // results by this method
     
     write_params(b, method_name, fp);
@@ -298,23 +651,24 @@ int h2_simpfer(                     // H2_ALSH + Simpfer
         // char k_fname[200]; 
         // sprintf(k_fname, "%s%s_k=%d.csv", out_folder, method_name, k);
         
-        read_ground_truth(k, qn, truth_addr, truth);
+        truth->load(k, qn, truth_addr);
         init_global_metric();
         
         for (int i = 0; i < qn; ++i) {
             const float *query = query_set + (u64) i*d;
             lsh->reverse_kmips(k, query, result);
+            update_query_stats(lsh->stats_);
             
-            update_global_metric(truth[i], result);
+            truth->update_global_metric(i, result);
             // output_reverse_kmips_results(i, result, k_fname);
         }
         calc_and_write_global_metric(k, qn, fp);
-        std::vector<std::vector<int> >().swap(truth);
         std::vector<int>().swap(result);
     }
     foot(fp);
     fclose(fp);
     
+    delete truth;
     delete lsh;
     return 0;
 }
@@ -327,34 +681,33 @@ int h2_cone(                        // H2_ALSH with Cone_Tree for blocking
     int   d,                            // dimensionality
     int   leaf,                         // leaf size of Cone-Tree
     float b,                            // interval ratio for blocking items
+    int   huge,                         // backing of big arrays (HUGE_*)
     const char  *method_name,           // method name
     const char  *truth_addr,            // address of truth set
     const char  *out_folder,            // output folder
     const float *item_set,              // set of item  vectors
     const float *user_set,              // set of user  vectors
-    const float *query_set)             // set of query vectors
+    const float *query_set,             // set of query vectors
+    const Lower_Bounds *lb)             // precomputed lower bounds
 {
     char fname[200]; sprintf(fname, "%s%s.csv", out_folder, method_name);
     FILE *fp = fopen(fname, "a+");
     if (!fp) { printf("Could not create %s\n", fname); return 1; }
     
     // normalized the user set
-    float *norm_user_set = new float[m*d];
-    for (int i = 0; i < m; ++i) {
-        const float *user = user_set + (u64) i*d;
-        float norm = sqrt(calc_inner_product(d, user, user));
-        
-        float *new_user = norm_user_set + (u64)i*d;
-        for (int j = 0; j < d; ++j) new_user[j] = user[j] / norm;
-    }
+    float *norm_user_set = new float[(u64) m*d];
+    normalize_data(m, d, user_set, nullptr, norm_user_set);
     
     // pre-processing
-    H2_CONE *lsh = new H2_CONE(n, m, d, K_MAX, leaf, b, item_set, norm_user_set);
+    reset_peak_rss(); // the peak rss of build is since here
+    H2_CONE *lsh = new H2_CONE(n, m, d, K_MAX, leaf, b, huge, item_set, 
+        norm_user_set, lb);
+    update_index_info(lsh);
     lsh->display();
     write_index_info(fp);
     
     // online query for reverse k-maximum inner product search
-    std::vector<std::vector<int> > truth; // ground truth
+    Truth_Set *truth = new Truth_Set(m);  // ground truth
     std::vector<int> result;              // results by this method
     
     write_params_leaf(leaf, b, method_name, fp);
@@ -362,28 +715,117 @@ int h2_cone(                        // H2_ALSH with Cone_Tree for blocking
         // char k_fname[200]; 
         // sprintf(k_fname, "%s%s_k=%d.csv", out_folder, method_name, k);
         
-        read_ground_truth(k, qn, truth_addr, truth);
+        truth->load(k, qn, truth_addr);
         init_global_metric();
         
         for (int i = 0; i < qn; ++i) {
             const float *query = query_set + (u64) i*d;
             lsh->reverse_kmips(k, query, result);
+            update_query_stats(lsh->stats_);
             
-            update_global_metric(truth[i], result);
+            truth->update_global_metric(i, result);
             // output_reverse_kmips_results(i, result, k_fname);
         }
         calc_and_write_global_metric(k, qn, fp);
-        std::vector<std::vector<int> >().swap(truth);
         std::vector<int>().swap(result);
     }
     foot(fp);
     fclose(fp);
     
+    delete truth;
     delete lsh;
     delete[] norm_user_set;
     return 0;
 }
 
+// -----------------------------------------------------------------------------
+int dual_cone(                      // Dual-Tree (User & Item Cone-Trees)
+    int   n,                            // item  cardinality
+    int   m,                            // user  cardinality
+    int   qn,                           // query cardinality
+    int   d,                            // dimensionality
+    int   leaf,                         // leaf size of Cone-Tree
+    int   huge,                         // backing of big arrays (HUGE_*)
+    const char  *method_name,           // method name
+    const char  *truth_addr,            // address of truth set
+    const char  *out_folder,            // output folder
+    const float *item_set,              // set of item  vectors
+    const float *user_set,              // set of user  vectors
+    const float *query_set)             // set of query vectors
+{
+    char fname[200]; sprintf(fname, "%s%s.csv", out_folder, method_name);
+    FILE *fp = fopen(fname, "a+");
+    if (!fp) { printf("Could not create %s\n", fname); return 1; }
+    
+    // normalized the user set
+    float *norm_user_set = new float[(u64) m*d];
+    normalize_data(m, d, user_set, nullptr, norm_user_set);
+    
+    // pre-processing
+    reset_peak_rss(); // the peak rss of build is since here
+    Dual_Cone *tree = new Dual_Cone(n, m, d, K_MAX, leaf, huge, item_set, 
+        norm_user_set);
+    update_index_info(tree);
+    tree->display();
+    write_index_info(fp);
+    
+    // online query for reverse k-maximum inner product search
+    Truth_Set *truth = new Truth_Set(m);  // ground truth
+    std::vector<int> result;              // results by this method
+    
+    write_params_leaf(leaf, method_name, fp);
+    for (int k : Ks) {
+        truth->load(k, qn, truth_addr);
+        init_global_metric();
+        
+        for (int i = 0; i < qn; ++i) {
+            const float *query = query_set + (u64) i*d;
+            tree->reverse_kmips(k, query, result);
+            update_query_stats(tree->stats_);
+            
+            truth->update_global_metric(i, result);
+        }
+        calc_and_write_global_metric(k, qn, fp);
+        std::vector<int>().swap(result);
+    }
+    foot(fp);
+    fclose(fp);
+    
+    delete truth;
+    delete tree;
+    delete[] norm_user_set;
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+int lower_bounds(                   // precompute lower bounds for users
+    int   n,                            // item  cardinality
+    int   m,                            // user  cardinality
+    int   d,                            // dimensionality
+    int   coeff,                        // n0 = min(K_MAX*coeff, n)
+    const char  *lb_addr,               // address of lower bounds
+    const float *item_set,              // set of item  vectors
+    const float *user_set)              // set of user  vectors
+{
+    gettimeofday(&g_start_time, nullptr);
+    
+    // compute the lower bounds keyed by the hash of dataset & k_max
+    u64 hash = calc_dataset_hash(n, m, d, item_set, user_set);
+    Lower_Bounds *lb = new Lower_Bounds();
+    lb->build(n, m, d, K_MAX, coeff, hash, item_set, user_set);
+    
+    gettimeofday(&g_end_time, nullptr);
+    double lb_time = g_end_time.tv_sec - g_start_time.tv_sec + 
+        (g_end_time.tv_usec - g_start_time.tv_usec) / 1000000.0;
+    
+    lb->display();
+    printf("Lower Bounds: %g Seconds\n\n", lb_time);
+    
+    int ret = lb->save(lb_addr);
+    delete lb;
+    return ret;
+}
+
 // -----------------------------------------------------------------------------
 int linear(                         // Linear Scan k-MIPS
     int   m,                            // user  cardinality
@@ -400,32 +842,545 @@ int linear(                         // Linear Scan k-MIPS
     if (!fp) { printf("Could not create %s\n", fname); return 1; }
     
     // online query for reverse k-maximum inner product search
-    std::vector<std::vector<int> > truth; // ground truth
+    Truth_Set *truth = new Truth_Set(m);  // ground truth
     std::vector<int> result;              // results by this method
     
     fprintf(fp, "Linear Scan User Set for k-MIPS\n");
+    write_head(fp);
     for (int k : Ks) {
         // char k_fname[200]; 
         // sprintf(k_fname, "%s%s_k=%d.csv", out_folder, method_name, k);
         
-        read_ground_truth(k, qn, truth_addr, truth);
+        truth->load(k, qn, truth_addr);
         init_global_metric();
         
         for (int i = 0; i < qn; ++i) {
             const float *query = query_set + (u64) i*d;
             linear_scan(m, k, d, query, user_set, result);
             
-            update_global_metric(truth[i], result);
+            truth->update_global_metric(i, result);
             // output_reverse_kmips_results(i, result, k_fname);
         }
         calc_and_write_global_metric(k, qn, fp);
-        std::vector<std::vector<int> >().swap(truth);
         std::vector<int>().swap(result);
     }
     foot(fp);
     fclose(fp);
     
+    delete truth;
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+static void parse_sweep_values(     // parse a comma-separated list of values
+    const char *str,                    // input string
+    std::vector<float> &values)         // values (return)
+{
+    values.clear();
+    std::stringstream ss(str);
+    std::string token;
+    while (std::getline(ss, token, ',')) {
+        if (!token.empty()) values.push_back(atof(token.c_str()));
+    }
+}
+
+// -----------------------------------------------------------------------------
+static void write_sweep_result(     // write a sweep result (csv & json)
+    const char *method_name,            // method name
+    int   K,                            // # hash tables (-1: not used)
+    float b,                            // interval ratio (-1: not used)
+    int   leaf,                         // leaf size (-1: not used)
+    int   k,                            // top-k value
+    double shared_time,                 // time of shared artifacts (seconds)
+    const Metric &metric,               // global metric
+    FILE  *csv,                         // csv file pointer (return)
+    FILE  *json,                        // json file pointer (return)
+    int   &cnt)                         // # results written (return)
+{
+    double memory    = g_memory / 1048576.0;
+    double heap      = g_heap_memory / 1048576.0;
+    double build_rss = g_build_rss / 1048576.0;
+    double query_rss = metric.peak_rss_ / 1048576.0;
+    
+    fprintf(csv, "%s,%d,%g,%d,%d,%lf,%lf,%lf,%lf,%lu,%d,%d,%lf,%lf,%lf,%lf",
+        method_name, K, b, leaf, k, g_pre_time, shared_time, memory, 
+        metric.time_, metric.ip_, metric.nq_count_, metric.nq_found_, 
+        metric.miss_rate_, metric.precision_, metric.recall_, 
+        metric.f1score_);
+    for (double t : metric.time_pcts_) fprintf(csv, ",%lf", t);
+    for (u64 ip : metric.ip_pcts_) fprintf(csv, ",%lu", ip);
+    for (double c : metric.prune_) fprintf(csv, ",%lf", c);
+    fprintf(csv, ",%lf,%lf,%lf\n", heap, build_rss, query_rss);
+    
+    fprintf(json, "%s  {\"method\": \"%s\", \"K\": %d, \"b\": %g, "
+        "\"leaf\": %d, \"k\": %d, \"pre_time\": %lf, \"shared_time\": %lf, "
+        "\"memory\": %lf, \"time_ms\": %lf, \"ip\": %lu, \"nq\": %d, "
+        "\"found\": %d, \"miss\": %lf, \"precision\": %lf, \"recall\": %lf, "
+        "\"f1\": %lf", cnt > 0 ? ",\n" : "", method_name, K, b, leaf, k, 
+        g_pre_time, shared_time, memory, metric.time_, metric.ip_, 
+        metric.nq_count_, metric.nq_found_, metric.miss_rate_, 
+        metric.precision_, metric.recall_, metric.f1score_);
+    
+    const char *names[] = { "p50", "p90", "p99", "p999", "max" };
+    for (int i = 0; i < (int) PCTs.size(); ++i) {
+        fprintf(json, ", \"time_%s_ms\": %lf", names[i], 
+            metric.time_pcts_[i]);
+    }
+    for (int i = 0; i < (int) PCTs.size(); ++i) {
+        fprintf(json, ", \"ip_%s\": %lu", names[i], metric.ip_pcts_[i]);
+    }
+    for (int i = 0; i < NUM_STAGES; ++i) {
+        fprintf(json, ", \"%s\": %lf", STAGE_NAMES[i], metric.prune_[i]);
+    }
+    fprintf(json, ", \"measured_memory\": %lf, \"build_rss\": %lf, "
+        "\"query_rss\": %lf}", heap, build_rss, query_rss);
+    ++cnt;
+}
+
+// -----------------------------------------------------------------------------
+template<class INDEX>
+static void sweep_eval(             // evaluate an index for all k in Ks
+    int   qn,                           // query cardinality
+    int   d,                            // dimensionality
+    int   K,                            // # hash tables (-1: not used)
+    float b,                            // interval ratio (-1: not used)
+    int   leaf,                         // leaf size (-1: not used)
+    const char  *method_name,           // method name
+    const float *query_set,             // set of query vectors
+    const std::vector<Truth_Set*> &truths, // truth sets for Ks
+    const Shared_Index *shared,         // shared artifacts
+    double &used_time,                  // shared time reported (return)
+    INDEX *index,                       // index of a method
+    bool  one_pass,                     // also answer all k in one pass?
+    FILE  *csv,                         // csv file pointer (return)
+    FILE  *json,                        // json file pointer (return)
+    int   &cnt)                         // # results written (return)
+{
+    // the time of shared artifacts built for this index
+    double shared_time = shared->pre_time_ - used_time;
+    used_time = shared->pre_time_;
+    update_index_info(index);
+    
+    printf("%s: K=%d, b=%g, leaf=%d\n", method_name, K, b, leaf);
+    printf("Indexing Time: %g Seconds (Shared: %g Seconds)\n", g_pre_time, 
+        shared_time);
+    printf("Estimated Mem: %g MB (Measured Mem: %g MB, Peak RSS: %g MB)\n", 
+        g_memory / 1048576.0, g_heap_memory / 1048576.0, 
+        g_build_rss / 1048576.0);
+    
+    std::vector<int> result;
+    Metric metric;
+    for (int j = 0; j < (int) Ks.size(); ++j) {
+        int k = Ks[j];
+        init_global_metric();
+        
+        for (int i = 0; i < qn; ++i) {
+            const float *query = query_set + (u64) i*d;
+            index->reverse_kmips(k, query, result);
+            update_query_stats(index->stats_);
+            
+            truths[j]->update_global_metric(i, result);
+        }
+        calc_global_metric(qn, metric);
+        printf("%3d\t\t%.3f\t\t%lu\t\t%d (%d)\t\t%.3f\t\t%.3f\t\t%.3f\t\t"
+            "%.3f\n", k, metric.time_, metric.ip_, metric.nq_count_, 
+            metric.nq_found_, metric.miss_rate_, metric.precision_, 
+            metric.recall_, metric.f1score_);
+        write_sweep_result(method_name, K, b, leaf, k, shared_time, metric, 
+            csv, json, cnt);
+    }
+    printf("\n");
+    if (one_pass) {
+        // answer all k in Ks by one pass (for the max k) of each query, where
+        // the rows of "<method>_one_pass" share the time & # ip of the pass
+        int k_max = Ks.back();
+        std::vector<std::vector<int> > results(qn), ranks(qn);
+        std::vector<Query_Stats> stats(qn);
+        for (int i = 0; i < qn; ++i) {
+            const float *query = query_set + (u64) i*d;
+            index->rank_reverse_kmips(k_max, query, results[i], ranks[i]);
+            stats[i] = index->stats_;
+        }
+        char name[200]; sprintf(name, "%s_one_pass", method_name);
+        for (int j = 0; j < (int) Ks.size(); ++j) {
+            int k = Ks[j];
+            init_global_metric();
+            for (int i = 0; i < qn; ++i) {
+                update_query_stats(stats[i]);
+                result.clear();
+                for (int l = 0; l < (int) results[i].size(); ++l) {
+                    if (ranks[i][l] <= k) result.push_back(results[i][l]);
+                }
+                truths[j]->update_global_metric(i, result);
+            }
+            calc_global_metric(qn, metric);
+            printf("%3d\t\t%.3f\t\t%lu\t\t%d (%d)\t\t%.3f\t\t%.3f\t\t%.3f\t\t"
+                "%.3f\n", k, metric.time_, metric.ip_, metric.nq_count_, 
+                metric.nq_found_, metric.miss_rate_, metric.precision_, 
+                metric.recall_, metric.f1score_);
+            write_sweep_result(name, K, b, leaf, k, shared_time, metric, csv, 
+                json, cnt);
+        }
+        printf("\n");
+    }
+    fflush(csv); fflush(json);
+}
+
+// -----------------------------------------------------------------------------
+int sweep(                          // sweep methods & parameters in a process
+    int   n,                            // item  cardinality
+    int   m,                            // user  cardinality
+    int   qn,                           // query cardinality
+    int   d,                            // dimensionality
+    int   huge,                         // backing of big arrays (HUGE_*)
+    const char  *sweep_addr,            // address of sweep config
+    const char  *truth_addr,            // address of truth set
+    const char  *out_folder,            // output folder
+    const float *item_set,              // set of item  vectors
+    const float *user_set,              // set of user  vectors
+    const float *query_set,             // set of query vectors
+    const Lower_Bounds *lb)             // precomputed lower bounds
+{
+    // each line of sweep config is "alg [-K list] [-b list] [-l list] [-a 1]",
+    // e.g., "3 -K 64,128 -b 0.5 -l 20,50,100", where "-a 1" also answers all 
+    // k by one pass, and "#" starts a comment (alg 7 is k-mips rather than 
+    // reverse k-mips, so it is not supported)
+    FILE *cfg = fopen(sweep_addr, "r");
+    if (!cfg) { printf("Could not open %s\n", sweep_addr); return 1; }
+    
+    char fname[200]; sprintf(fname, "%ssweep.csv", out_folder);
+    FILE *csv = fopen(fname, "w");
+    if (!csv) { printf("Could not create %s\n", fname); return 1; }
+    sprintf(fname, "%ssweep.json", out_folder);
+    FILE *json = fopen(fname, "w");
+    if (!json) { printf("Could not create %s\n", fname); return 1; }
+    
+    fprintf(csv, "method,K,b,leaf,k,pre_time,shared_time,memory,time_ms,ip,"
+        "nq,found,miss,precision,recall,f1,time_p50_ms,time_p90_ms,"
+        "time_p99_ms,time_p999_ms,time_max_ms,ip_p50,ip_p90,ip_p99,ip_p999,"
+        "ip_max");
+    for (int i = 0; i < NUM_STAGES; ++i) fprintf(csv, ",%s", STAGE_NAMES[i]);
+    fprintf(csv, ",measured_memory,build_rss,query_rss\n");
+    fprintf(json, "[\n");
+    
+    // load the truth sets for all k once
+    std::vector<Truth_Set*> truths;
+    for (int k : Ks) {
+        Truth_Set *truth = new Truth_Set(m);
+        if (truth->load(k, qn, truth_addr)) return 1;
+        truths.push_back(truth);
+    }
+    
+    // the sorted items, the sorted users & their lower bounds, and the 
+    // cone-trees of normalized users are built once and shared by methods
+    Shared_Index *shared = new Shared_Index(n, m, d, K_MAX, huge, item_set, 
+        user_set, lb);
+    double used_time = 0.0; // shared time reported so far
+    
+    int  cnt = 0;
+    char line[1000];
+    while (fgets(line, sizeof(line), cfg)) {
+        char *comment = strchr(line, '#');
+        if (comment != nullptr) *comment = '\0';
+        
+        // parse the algorithm and the lists of parameters
+        char *token = strtok(line, " \t\r\n");
+        if (token == nullptr) continue; // skip empty line
+        
+        int alg = atoi(token);
+        std::vector<float> K_list, b_list, leaf_list;
+        bool one_pass = false;
+        while ((token = strtok(nullptr, " \t\r\n")) != nullptr) {
+            char *values = strtok(nullptr, " \t\r\n");
+            if (values == nullptr) break;
+            
+            if (strcmp(token, "-K") == 0) {
+                parse_sweep_values(values, K_list);
+            }
+            else if (strcmp(token, "-b") == 0) {
+                parse_sweep_values(values, b_list);
+            }
+            else if (strcmp(token, "-l") == 0) {
+                parse_sweep_values(values, leaf_list);
+            }
+            else if (strcmp(token, "-a") == 0) {
+                one_pass = atoi(values) != 0;
+            }
+        }
+        bool use_K    = alg == 2 || alg == 3;
+        bool use_b    = alg >= 2 && alg <= 6;
+        bool use_leaf = alg == 3 || alg == 6 || alg == 8;
+        if (alg < 1 || alg > 8 || alg == 7 || (use_K && K_list.empty()) || 
+            (use_b && b_list.empty()) || (use_leaf && leaf_list.empty())) {
+            printf("Skip invalid sweep config for alg %d\n", alg); continue;
+        }
+        if (!use_K)    K_list    = { -1.0f };
+        if (!use_b)    b_list    = { -1.0f };
+        if (!use_leaf) leaf_list = { -1.0f };
+        
+        // evaluate the grid of parameters
+        for (float K_val : K_list) for (float b : b_list) 
+        for (float leaf_val : leaf_list) {
+            int K = (int) K_val, leaf = (int) leaf_val;
+            
+            // build the index (with the shared artifacts if possible) and 
+            // evaluate it; the random seed is reset before each build, so 
+            // that an index is the same as that of a single run of rmips
+            srand(RANDOM_SEED);
+            reset_peak_rss();
+            switch (alg) {
+            case 1: {
+                Scan *scan = new Scan(n, m, d, K_MAX, false, huge, item_set,
+                    user_set);
+                sweep_eval(qn, d, K, b, leaf, "exhaustive_scan", query_set, 
+                    truths, shared, used_time, scan, one_pass, csv, 
+                    json, cnt);
+                delete scan;
+                break; }
+            case 2: {
+                SA_Simpfer *lsh = new SA_Simpfer(K, b, shared);
+                sweep_eval(qn, d, K, b, leaf, "sa_simpfer", query_set, 
+                    truths, shared, used_time, lsh, one_pass, csv, 
+                    json, cnt);
+                delete lsh;
+                break; }
+            case 3: {
+                SA_CONE *lsh = new SA_CONE(K, leaf, b, shared);
+                sweep_eval(qn, d, K, b, leaf, "sa_cone", query_set, 
+                    truths, shared, used_time, lsh, one_pass, csv, 
+                    json, cnt);
+                delete lsh;
+                break; }
+            case 4: {
+                H2_ALSH *lsh = new H2_ALSH(n, m, d, b, huge, item_set, 
+                    user_set);
+                sweep_eval(qn, d, K, b, leaf, "h2_alsh", query_set, 
+                    truths, shared, used_time, lsh, one_pass, csv, 
+                    json, cnt);
+                delete lsh;
+                break; }
+            case 5: {
+                H2_Simpfer *lsh = new H2_Simpfer(b, shared);
+                sweep_eval(qn, d, K, b, leaf, "h2_simpfer", query_set, 
+                    truths, shared, used_time, lsh, one_pass, csv, 
+                    json, cnt);
+                delete lsh;
+                break; }
+            case 6: {
+                H2_CONE *lsh = new H2_CONE(leaf, b, shared);
+                sweep_eval(qn, d, K, b, leaf, "h2_cone", query_set, 
+                    truths, shared, used_time, lsh, one_pass, csv, 
+                    json, cnt);
+                delete lsh;
+                break; }
+            case 8: {
+                shared->prepare_normalized_users();
+                Dual_Cone *tree = new Dual_Cone(n, m, d, K_MAX, leaf, huge,
+                    item_set, shared->norm_user_set_);
+                sweep_eval(qn, d, K, b, leaf, "dual_cone", query_set, 
+                    truths, shared, used_time, tree, one_pass, csv, 
+                    json, cnt);
+                delete tree;
+                break; }
+            }
+        }
+    }
+    fprintf(json, "\n]\n");
+    shared->display();
+    
+    fclose(cfg);
+    fclose(csv);
+    fclose(json);
+    
+    for (auto truth : truths) { delete truth; truth = nullptr; }
+    delete shared;
     return 0;
 }
 
+// -----------------------------------------------------------------------------
+int server(                         // serve reverse k-mips requests
+    int   n,                            // item  cardinality
+    int   m,                            // user  cardinality
+    int   d,                            // dimensionality
+    int   K,                            // # hash tables (-1: not used)
+    int   leaf,                         // leaf size (-1: not used)
+    float b,                            // interval ratio (-1: not used)
+    int   serve_alg,                    // method of index (ALG_*)
+    int   huge,                         // backing of big arrays (HUGE_*)
+    const char  *index_addr,            // address of index params ("": none)
+    const char  *socket_addr,           // address of unix socket ("-": stdio)
+    int   out_fd,                       // file descriptor of stdio responses
+    int   max_batch,                    // max # queries of a batch (1: none)
+    double max_delay,                   // max queueing delay of a batch (ms)
+    const float *item_set,              // set of item  vectors
+    const float *user_set,              // set of user  vectors
+    const u64   *user_attrs,            // attributes of users (nullptr: none)
+    const Lower_Bounds *lb)             // precomputed lower bounds
+{
+    // rebuild the index by its params if they have been saved (so that a 
+    // restarted server serves the same index, checked against the dataset); 
+    // otherwise, build it and save its params, where the pre-processing is
+    // done before serving any request
+    Reverse_KMIPS *index = nullptr;
+    if (index_addr[0] != '\0' && access(index_addr, F_OK) == 0) {
+        index = Reverse_KMIPS::rebuild(index_addr, n, m, d, huge, item_set, 
+            user_set, lb);
+    }
+    else {
+        Index_Param param;
+        param.alg_ = serve_alg; param.n_ = n; param.m_ = m; param.d_ = d;
+        param.k_max_ = K_MAX; param.K_ = K; param.leaf_ = leaf; param.b_ = b;
+        param.huge_ = huge; param.seed_ = RANDOM_SEED;
+        param.hash_ = calc_dataset_hash(n, m, d, item_set, user_set);
+        
+        index = Reverse_KMIPS::build(param, item_set, user_set, lb);
+        if (index != nullptr && index_addr[0] != '\0') {
+            index->save_params(index_addr);
+        }
+    }
+    if (index == nullptr) { printf("Could not build the index\n"); return 1; }
+    if (user_attrs != nullptr) index->set_user_attrs(user_attrs);
+    
+    update_index_info(index);
+    index->display();
+    printf("Indexing Time: %g Seconds\n", g_pre_time);
+    printf("Estimated Mem: %g MB\n\n", g_memory / 1048576.0);
+    
+    // serve the requests until a request to stop the server (or the end of 
+    // stdin), where the queries of concurrent connections are grouped into 
+    // batches if max_batch > 1
+    Server *serv = new Server(index, max_batch, max_delay);
+    int ret = strcmp(socket_addr, "-") == 0 ? serv->serve_stdio(out_fd) : 
+        serv->serve_socket(socket_addr);
+    
+    delete serv;
+    delete index;
+    return ret;
+}
+
+// -----------------------------------------------------------------------------
+static void kill_workers(           // kill & reap the forked workers
+    const char *prefix,                 // prefix of worker sockets
+    const std::vector<pid_t> &pids)     // pids of workers (0: none)
+{
+    for (pid_t pid : pids) if (pid > 0) kill(pid, SIGKILL);
+    for (pid_t pid : pids) if (pid > 0) waitpid(pid, nullptr, 0);
+    
+    // remove the sockets the killed workers may have left
+    for (int i = 0; i < (int) pids.size(); ++i) {
+        char addr[256]; sprintf(addr, "%s.%d", prefix, i); unlink(addr);
+    }
+}
+
+// -----------------------------------------------------------------------------
+int shard(                          // serve requests by user-sharded workers
+    int   n,                            // item  cardinality
+    int   m,                            // user  cardinality
+    int   d,                            // dimensionality
+    int   K,                            // # hash tables (-1: not used)
+    int   leaf,                         // leaf size (-1: not used)
+    float b,                            // interval ratio (-1: not used)
+    int   serve_alg,                    // method of index (ALG_*)
+    int   num_shards,                   // number of user shards (workers)
+    int   numa,                         // bind workers to numa nodes (1: on)
+    int   huge,                         // backing of big arrays (HUGE_*)
+    const char  *socket_addr,           // address of unix socket ("-": stdio)
+    int   out_fd,                       // file descriptor of stdio responses
+    int   max_batch,                    // max # queries of a batch (1: none)
+    double max_delay,                   // max queueing delay of a batch (ms)
+    const float *item_set,              // set of item  vectors
+    const float *user_set,              // set of user  vectors
+    const u64   *user_attrs)            // attributes of users (nullptr: none)
+{
+    // the workers serve the sockets of "<socket_addr>.<shard>"
+    char prefix[200];
+    if (strcmp(socket_addr, "-") == 0) {
+        sprintf(prefix, "/tmp/rmips.%d", (int) getpid());
+    }
+    else strcpy(prefix, socket_addr);
+    
+    Topology topo;
+    if (numa > 0) topo.display();
+    fflush(stdout);
+    
+    // fork a worker for each shard, which shares the item_set and user_set 
+    // (read-only) with the coordinator, and builds its own index over the 
+    // whole item set and the users of its shard
+    std::vector<pid_t> pids(num_shards, 0);
+    for (int i = 0; i < num_shards; ++i) {
+        pids[i] = fork();
+        if (pids[i] < 0) {
+            printf("Could not fork worker %d\n", i);
+            pids[i] = 0; kill_workers(prefix, pids); return 1;
+        }
+        if (pids[i] > 0) continue;
+        
+        // bind the worker to a node (round robin) before its build, so that 
+        // its index (with its own sorted items, i.e., a replica of the item 
+        // index per node) is placed on the node by first touch, and its 
+        // build & query threads run on the cpus of the node
+        if (numa > 0) {
+            int node = i % topo.num_nodes();
+            if (topo.bind(node)) printf("Shard %d: could not bind\n", i);
+            else printf("Shard %d: node %d (%d cpus)\n", i, node, 
+                topo.num_cpus(node));
+        }
+        int start = Shard_Index::get_shard_start(m, num_shards, i);
+        int end   = Shard_Index::get_shard_start(m, num_shards, i+1);
+        const float *shard_set = user_set + (u64) start*d;
+        
+        Index_Param param;
+        param.alg_ = serve_alg; param.n_ = n; param.m_ = end - start; 
+        param.d_ = d; param.k_max_ = K_MAX; param.K_ = K; param.leaf_ = leaf; 
+        param.b_ = b; param.huge_ = huge; param.seed_ = RANDOM_SEED; 
+        param.hash_ = 0UL;
+        
+        Reverse_KMIPS *index = Reverse_KMIPS::build(param, item_set, 
+            shard_set, nullptr);
+        if (index == nullptr) _exit(1);
+        if (user_attrs != nullptr) index->set_user_attrs(user_attrs + start);
+        printf("Shard %d: users [%d, %d), indexing time = %g Seconds\n", i, 
+            start, end, index->pre_time_);
+        
+        // the coordinator groups the queries into batches, so a worker 
+        // answers the pipelined queries of a batch without waiting
+        char addr[256]; sprintf(addr, "%s.%d", prefix, i);
+        Server *serv = new Server(index, max_batch, 0.0);
+        int ret = serv->serve_socket(addr);
+        
+        fflush(stdout);
+        _exit(ret); // skip the destructors of the coordinator
+    }
+    
+    // connect to the workers (after they have built their indexes), where
+    // a worker exiting early stops the others, as the shards are incomplete
+    std::vector<int> fds(num_shards, -1);
+    for (int i = 0; i < num_shards; ++i) {
+        char addr[256]; sprintf(addr, "%s.%d", prefix, i);
+        while ((fds[i] = connect_socket(addr)) < 0) {
+            int status;
+            if (waitpid(pids[i], &status, WNOHANG) == pids[i]) {
+                printf("Worker of shard %d exited\n", i);
+                for (int j = 0; j < i; ++j) close(fds[j]);
+                pids[i] = 0; kill_workers(prefix, pids); return 1;
+            }
+            usleep(100000);
+        }
+    }
+    Shard_Index *index = new Shard_Index(n, m, d, K_MAX, num_shards, 
+        fds.data());
+    index->display();
+    
+    // serve the requests by the workers, where the queries of concurrent 
+    // connections are grouped into batches if max_batch > 1
+    Server *serv = new Server(index, max_batch, max_delay);
+    int ret = strcmp(socket_addr, "-") == 0 ? serv->serve_stdio(out_fd) : 
+        serv->serve_socket(socket_addr);
+    
+    delete serv;
+    delete index; // stop the workers
+    for (int i = 0; i < num_shards; ++i) waitpid(pids[i], nullptr, 0);
+    return ret;
+}
+
 } // end namespace ip
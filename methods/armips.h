@@ -11,6 +11,13 @@
 #include "h2_cone.h"
 #include "sa_simpfer.h"
 #include "sa_cone.h"
+#include "dual_cone.h"
+#include "lower_bounds.h"
+#include "shared_index.h"
+#include "rkmips.h"
+#include "truth.h"
+#include "server.h"
+#include "shard.h"
 
 namespace ip {
 
@@ -20,6 +27,7 @@ int ground_truth(                   // generate ground truth results for query
     int   m,                            // user  cardinality
     int   qn,                           // query cardinality
     int   d,                            // dimensionality
+    int   huge,                         // backing of big arrays (HUGE_*)
     const char  *truth_addr,            // address of truth set
     const float *item_set,              // set of item  vectors
     const float *user_set,              // set of user  vectors
@@ -31,6 +39,7 @@ int exhaustive_scan(                // Exhaustive_Scan
     int   m,                            // user  cardinality
     int   qn,                           // query cardinality
     int   d,                            // dimensionality
+    int   huge,                         // backing of big arrays (HUGE_*)
     const char  *method_name,           // method name
     const char  *truth_addr,            // address of truth set
     const char  *out_folder,            // output folder
@@ -38,6 +47,34 @@ int exhaustive_scan(                // Exhaustive_Scan
     const float *user_set,              // set of user  vectors
     const float *query_set);            // set of query vectors
 
+// -----------------------------------------------------------------------------
+int ground_truth_stream(            // generate ground truth by user chunks
+    int   n,                            // item  cardinality
+    int   m,                            // user  cardinality
+    int   qn,                           // query cardinality
+    int   d,                            // dimensionality
+    int   chunk,                        // # users of a chunk
+    int   huge,                         // backing of big arrays (HUGE_*)
+    const char  *truth_addr,            // address of truth set
+    const char  *users_addr,            // address of user  set
+    const float *item_set,              // set of item  vectors
+    const float *query_set);            // set of query vectors
+
+// -----------------------------------------------------------------------------
+int exhaustive_scan_stream(         // Exhaustive_Scan by user chunks
+    int   n,                            // item  cardinality
+    int   m,                            // user  cardinality
+    int   qn,                           // query cardinality
+    int   d,                            // dimensionality
+    int   chunk,                        // # users of a chunk
+    int   huge,                         // backing of big arrays (HUGE_*)
+    const char  *method_name,           // method name
+    const char  *truth_addr,            // address of truth set
+    const char  *out_folder,            // output folder
+    const char  *users_addr,            // address of user  set
+    const float *item_set,              // set of item  vectors
+    const float *query_set);            // set of query vectors
+
 // -----------------------------------------------------------------------------
 int sa_simpfer(                     // SA_ALSH + Simpfer
     int   n,                            // item  cardinality
@@ -46,12 +83,14 @@ int sa_simpfer(                     // SA_ALSH + Simpfer
     int   d,                            // dimensionality
     int   K,                            // # hash tables
     float b,                            // interval ratio for blocking items
+    int   huge,                         // backing of big arrays (HUGE_*)
     const char  *method_name,           // method name
     const char  *truth_addr,            // address of truth set
     const char  *out_folder,            // output folder
     const float *item_set,              // set of item  vectors
     const float *user_set,              // set of user  vectors
-    const float *query_set);            // set of query vectors
+    const float *query_set,             // set of query vectors
+    const Lower_Bounds *lb);            // precomputed lower bounds
 
 // -----------------------------------------------------------------------------
 int sa_cone(                        // SA_ALSH + Cone-Tree Blocking
@@ -62,11 +101,32 @@ int sa_cone(                        // SA_ALSH + Cone-Tree Blocking
     int   K,                            // # hash tables
     int   leaf,                         // leaf size of Cone-Tree
     float b,                            // interval ratio for blocking items
+    int   huge,                         // backing of big arrays (HUGE_*)
     const char  *method_name,           // method name
     const char  *truth_addr,            // address of truth set
     const char  *out_folder,            // output folder
     const float *item_set,              // set of item  vectors
     const float *user_set,              // set of user  vectors
+    const float *query_set,             // set of query vectors
+    const Lower_Bounds *lb);            // precomputed lower bounds
+
+// -----------------------------------------------------------------------------
+int sa_cone_stream(                 // SA_Cone with disk-resident leaves
+    int   n,                            // item  cardinality
+    int   m,                            // user  cardinality
+    int   qn,                           // query cardinality
+    int   d,                            // dimensionality
+    int   K,                            // # hash tables
+    int   leaf,                         // leaf size of Cone-Tree
+    float b,                            // interval ratio for blocking items
+    int   chunk,                        // # users of a chunk
+    int   huge,                         // backing of big arrays (HUGE_*)
+    const char  *method_name,           // method name
+    const char  *truth_addr,            // address of truth set
+    const char  *out_folder,            // output folder
+    const char  *users_addr,            // address of user  set
+    const char  *leaf_addr,             // address of leaf file
+    const float *item_set,              // set of item  vectors
     const float *query_set);            // set of query vectors
 
 // -----------------------------------------------------------------------------
@@ -76,6 +136,7 @@ int h2_alsh(                        // H2_ALSH
     int   qn,                           // query cardinality
     int   d,                            // dimensionality
     float b,                            // interval ratio for blocking items
+    int   huge,                         // backing of big arrays (HUGE_*)
     const char  *method_name,           // method name
     const char  *truth_addr,            // address of truth set
     const char  *out_folder,            // output folder
@@ -90,12 +151,14 @@ int h2_simpfer(                     // H2_ALSH + Simpfer
     int   qn,                           // query cardinality
     int   d,                            // dimensionality
     float b,                            // interval ratio for blocking items
+    int   huge,                         // backing of big arrays (HUGE_*)
     const char  *method_name,           // method name
     const char  *truth_addr,            // address of truth set
     const char  *out_folder,            // output folder
     const float *item_set,              // set of item  vectors
     const float *user_set,              // set of user  vectors
-    const float *query_set);            // set of query vectors
+    const float *query_set,             // set of query vectors
+    const Lower_Bounds *lb);            // precomputed lower bounds
 
 // -----------------------------------------------------------------------------
 int h2_cone(                        // H2_ALSH + Cone-Tree Blocking
@@ -105,13 +168,40 @@ int h2_cone(                        // H2_ALSH + Cone-Tree Blocking
     int   d,                            // dimensionality
     int   leaf,                         // leaf size of Cone-Tree
     float b,                            // interval ratio for blocking items
+    int   huge,                         // backing of big arrays (HUGE_*)
     const char  *method_name,           // method name
     const char  *truth_addr,            // address of truth set
     const char  *out_folder,            // output folder
     const float *item_set,              // set of item  vectors
     const float *user_set,              // set of user  vectors
-    const float *query_set);            // set of query vectors
+    const float *query_set,             // set of query vectors
+    const Lower_Bounds *lb);            // precomputed lower bounds
     
+// -----------------------------------------------------------------------------
+int dual_cone(                      // Dual-Tree (User & Item Cone-Trees)
+    int   n,                            // item  cardinality
+    int   m,                            // user  cardinality
+    int   qn,                           // query cardinality
+    int   d,                            // dimensionality
+    int   leaf,                         // leaf size of Cone-Tree
+    int   huge,                         // backing of big arrays (HUGE_*)
+    const char  *method_name,           // method name
+    const char  *truth_addr,            // address of truth set
+    const char  *out_folder,            // output folder
+    const float *item_set,              // set of item  vectors
+    const float *user_set,              // set of user  vectors
+    const float *query_set);            // set of query vectors
+
+// -----------------------------------------------------------------------------
+int lower_bounds(                   // precompute lower bounds for users
+    int   n,                            // item  cardinality
+    int   m,                            // user  cardinality
+    int   d,                            // dimensionality
+    int   coeff,                        // n0 = min(K_MAX*coeff, n)
+    const char  *lb_addr,               // address of lower bounds
+    const float *item_set,              // set of item  vectors
+    const float *user_set);             // set of user  vectors
+
 // -----------------------------------------------------------------------------
 int linear(                         // Linear Scan k-MIPS
     int   m,                            // user  cardinality
@@ -123,4 +213,59 @@ int linear(                         // Linear Scan k-MIPS
     const float *user_set,              // set of user  vectors
     const float *query_set);            // set of query vectors
 
+// -----------------------------------------------------------------------------
+int sweep(                          // sweep methods & parameters in a process
+    int   n,                            // item  cardinality
+    int   m,                            // user  cardinality
+    int   qn,                           // query cardinality
+    int   d,                            // dimensionality
+    int   huge,                         // backing of big arrays (HUGE_*)
+    const char  *sweep_addr,            // address of sweep config
+    const char  *truth_addr,            // address of truth set
+    const char  *out_folder,            // output folder
+    const float *item_set,              // set of item  vectors
+    const float *user_set,              // set of user  vectors
+    const float *query_set,             // set of query vectors
+    const Lower_Bounds *lb);            // precomputed lower bounds
+
+// -----------------------------------------------------------------------------
+int server(                         // serve reverse k-mips requests
+    int   n,                            // item  cardinality
+    int   m,                            // user  cardinality
+    int   d,                            // dimensionality
+    int   K,                            // # hash tables (-1: not used)
+    int   leaf,                         // leaf size (-1: not used)
+    float b,                            // interval ratio (-1: not used)
+    int   serve_alg,                    // method of index (ALG_*)
+    int   huge,                         // backing of big arrays (HUGE_*)
+    const char  *index_addr,            // address of index params ("": none)
+    const char  *socket_addr,           // address of unix socket ("-": stdio)
+    int   out_fd,                       // file descriptor of stdio responses
+    int   max_batch,                    // max # queries of a batch (1: none)
+    double max_delay,                   // max queueing delay of a batch (ms)
+    const float *item_set,              // set of item  vectors
+    const float *user_set,              // set of user  vectors
+    const u64   *user_attrs,            // attributes of users (nullptr: none)
+    const Lower_Bounds *lb);            // precomputed lower bounds
+
+// -----------------------------------------------------------------------------
+int shard(                          // serve requests by user-sharded workers
+    int   n,                            // item  cardinality
+    int   m,                            // user  cardinality
+    int   d,                            // dimensionality
+    int   K,                            // # hash tables (-1: not used)
+    int   leaf,                         // leaf size (-1: not used)
+    float b,                            // interval ratio (-1: not used)
+    int   serve_alg,                    // method of index (ALG_*)
+    int   num_shards,                   // number of user shards (workers)
+    int   numa,                         // bind workers to numa nodes (1: on)
+    int   huge,                         // backing of big arrays (HUGE_*)
+    const char  *socket_addr,           // address of unix socket ("-": stdio)
+    int   out_fd,                       // file descriptor of stdio responses
+    int   max_batch,                    // max # queries of a batch (1: none)
+    double max_delay,                   // max queueing delay of a batch (ms)
+    const float *item_set,              // set of item  vectors
+    const float *user_set,              // set of user  vectors
+    const u64   *user_attrs);           // attributes of users (nullptr: none)
+
 } // end namespace ip
@@ -9,11 +9,15 @@ Scan::Scan(                         // constructor
     int   d,                            // dimensionality
     int   k_max,                        // max k value
     bool  parallel,                     // use openmp for parallel computing
+    int   huge,                         // backing of big arrays (HUGE_*)
     const float *item_set,              // item set
     const float *user_set)              // user set
-    : m_(m), d_(d), k_max_(k_max), user_set_(user_set)
+    : Reverse_KMIPS(ALG_SCAN, n, m, d, k_max, -1, -1, -1.0f, huge), n_(n), 
+    m_(m), d_(d), k_max_(k_max), parallel_(parallel), user_set_(user_set), 
+    item_norms_(nullptr), item_set_(nullptr)
 {
-    gettimeofday(&g_start_time, nullptr);
+    timeval start_time, end_time;
+    gettimeofday(&start_time, nullptr);
     
     // compute l2-norm for user_set
     user_norms_ = new float[m_];
@@ -28,9 +32,8 @@ Scan::Scan(                         // constructor
     compute_norm_and_sort(n, item_set, item_norms, items);
     
     // compute k bounds for user_set
-    k_bounds_ = new float[(u64) m*k_max];
+    k_bounds_ = new_huge<float>((u64) m*k_max, alloc_);
     if (parallel) {
-        printf("run openmp\n");
         parallel_k_bounds_computation(n, item_norms, items);
     } else {
         k_bounds_computation(n, item_norms, items);
@@ -39,11 +42,68 @@ Scan::Scan(                         // constructor
     delete[] item_norms;
     delete[] items;
     
-    // get the pre-processing time and estimated memory
-    gettimeofday(&g_end_time, nullptr);
-    g_pre_time = g_end_time.tv_sec - g_start_time.tv_sec + 
-        (g_end_time.tv_usec - g_start_time.tv_usec) / 1000000.0;
-    g_memory = get_estimated_memory();
+    // get the pre-processing time
+    gettimeofday(&end_time, nullptr);
+    pre_time_ = end_time.tv_sec - start_time.tv_sec + 
+        (end_time.tv_usec - start_time.tv_usec) / 1000000.0;
+}
+
+// -----------------------------------------------------------------------------
+Scan::Scan(                         // constructor (streaming mode)
+    int   n,                            // item cardinality
+    int   d,                            // dimensionality
+    int   k_max,                        // max k value
+    int   chunk,                        // max # users of a chunk
+    bool  parallel,                     // use openmp for parallel computing
+    int   huge,                         // backing of big arrays (HUGE_*)
+    const float *item_set)              // item set
+    : Reverse_KMIPS(ALG_SCAN, n, chunk, d, k_max, -1, -1, -1.0f, huge), 
+    n_(n), m_(chunk), d_(d), k_max_(k_max), parallel_(parallel), 
+    user_set_(nullptr)
+{
+    timeval start_time, end_time;
+    gettimeofday(&start_time, nullptr);
+    
+    // compute l2-norm sort item_set in descending order by their l2-norms, 
+    // and keep them resident for all chunks of users
+    item_norms_ = new float[n];
+    item_set_   = new_huge<float>((u64) n*d, alloc_);
+    compute_norm_and_sort(n, item_set, item_norms_, item_set_);
+    
+    // allocate space for the l2-norms and k bounds of a chunk of users
+    user_norms_ = new float[chunk];
+    k_bounds_   = new_huge<float>((u64) chunk*k_max, alloc_);
+    
+    gettimeofday(&end_time, nullptr);
+    pre_time_ = end_time.tv_sec - start_time.tv_sec + 
+        (end_time.tv_usec - start_time.tv_usec) / 1000000.0;
+}
+
+// -----------------------------------------------------------------------------
+void Scan::load_users(              // load a chunk of users (streaming mode)
+    int   m,                            // # users of this chunk
+    const float *user_set)              // users of this chunk
+{
+    assert(item_set_ != nullptr);
+    m_ = m; user_set_ = user_set;
+    
+    // compute l2-norm for this chunk of users
+    timeval start_time, end_time;
+    gettimeofday(&start_time, nullptr);
+    for (int i = 0; i < m_; ++i) {
+        const float *user = user_set_ + (u64) i*d_;
+        user_norms_[i] = sqrt(calc_inner_product(d_, user, user));
+    }
+    // compute k bounds for this chunk of users
+    if (parallel_) {
+        parallel_k_bounds_computation(n_, item_norms_, item_set_);
+    } else {
+        k_bounds_computation(n_, item_norms_, item_set_);
+    }
+    // accumulate the pre-processing time of all chunks
+    gettimeofday(&end_time, nullptr);
+    pre_time_ += end_time.tv_sec - start_time.tv_sec + 
+        (end_time.tv_usec - start_time.tv_usec) / 1000000.0;
 }
 
 // -----------------------------------------------------------------------------
@@ -53,6 +113,8 @@ void Scan::compute_norm_and_sort(   // compute l2-norm and sort (descending)
     float *data_norms,                  // l2-norm of sorted data (return)
     float *data_set)                    // sorted data (return)
 {
+    Perf_Scope perf(PHASE_NORM_SORT);
+    
     // compute l2-norms for item_set
     Result *ret = new Result[n];
     for (int i = 0; i < n; ++i) {
@@ -80,21 +142,104 @@ void Scan::parallel_k_bounds_computation(// compute k bounds for user_set
     const float *item_norms,            // l2-norm of items
     const float *item_set)              // item set
 {
-    MaxK_Array **arr = new MaxK_Array*[m_];
-    for (int i = 0; i < m_; ++i) arr[i] = new MaxK_Array(k_max_);
+    Perf_Scope perf(PHASE_LOWER_BOUNDS);
+    
+    // split user_set into tiles, and each thread finds k-mips for a tile of 
+    // users at a time by the (norm-sorted) item tiles
+    int num_tiles = (m_ + USER_TILE - 1) / USER_TILE;
     
-    #pragma omp parallel num_threads(THREAD_NUM)
+    #pragma omp parallel num_threads(get_num_threads())
     {
-        #pragma omp for
-        for (int i = 0; i < m_; ++i) {
-            kmips(k_max_, n, user_norms_[i], user_set_ + (u64) i*d_, item_norms,
-                item_set, arr[i], k_bounds_ + (u64)i*k_max_);
+        Perf_Scope worker_perf(PHASE_LOWER_BOUNDS); // each thread counts itself
+        int   *active = new int[USER_TILE];
+        float *users  = new float[(u64) USER_TILE*d_];
+        float *items  = new float[(u64) ITEM_TILE*d_];
+        float *ips    = new float[(u64) USER_TILE*ITEM_TILE];
+        MaxK_Array **arr = new MaxK_Array*[USER_TILE];
+        for (int i = 0; i < USER_TILE; ++i) arr[i] = new MaxK_Array(k_max_);
+        
+        #pragma omp for schedule(dynamic)
+        for (int t = 0; t < num_tiles; ++t) {
+            int start = t * USER_TILE;
+            int m = std::min(USER_TILE, m_ - start);
+            
+            tile_kmips(m, n, user_norms_ + start, user_set_ + (u64) start*d_,
+                item_norms, item_set, active, users, items, ips, arr, 
+                k_bounds_ + (u64) start*k_max_);
         }
+        
+        // release space
+        for (int i = 0; i < USER_TILE; ++i) { delete arr[i]; arr[i] = nullptr; }
+        delete[] arr;
+        delete[] ips;
+        delete[] items;
+        delete[] users;
+        delete[] active;
     }
+}
+
+// -----------------------------------------------------------------------------
+void Scan::tile_kmips(              // k-mips for a user tile by item tiles
+    int   m,                            // number of users in this tile
+    int   n,                            // item cardinality
+    const float *user_norms,            // l2-norm of users
+    const float *user_set,              // users
+    const float *item_norms,            // l2-norm of sorted items
+    const float *item_set,              // sorted items
+    int   *active,                      // active user ids (buffer)
+    float *users,                       // packed active users (buffer)
+    float *items,                       // transposed item tile (buffer)
+    float *ips,                         // inner products (buffer)
+    MaxK_Array **arr,                   // top-k arrays (return)
+    float *k_bounds)                    // k bounds (return)
+{
+    int num = m; // number of active users
+    for (int i = 0; i < m; ++i) { active[i] = i; arr[i]->reset(); }
     
-    // release space
-    for (int i = 0; i < m_; ++i) { delete arr[i]; arr[i] = nullptr; }
-    delete[] arr; arr = nullptr;
+    for (int start = 0; start < n && num > 0; start += ITEM_TILE) {
+        int cnt = std::min(ITEM_TILE, n - start);
+        const float *norms = item_norms + start;
+        
+        // drop the users whose k-th mip cannot be updated by the rest items
+        int new_num = 0;
+        for (int i = 0; i < num; ++i) {
+            int id = active[i];
+            if (user_norms[id]*norms[0] < arr[id]->min_key()) continue;
+            
+            active[new_num++] = id;
+        }
+        num = new_num; if (num == 0) break;
+        
+        // pack the active users and transpose the item tile
+        for (int i = 0; i < num; ++i) {
+            const float *user = user_set + (u64) active[i]*d_;
+            std::copy(user, user + d_, users + (u64) i*d_);
+        }
+        for (int j = 0; j < cnt; ++j) {
+            const float *item = item_set + (u64) (start+j)*d_;
+            for (int l = 0; l < d_; ++l) items[(u64) l*cnt + j] = item[l];
+        }
+        // compute the inner products of the active users and the item tile
+        calc_inner_products(num, cnt, d_, users, items, ips);
+        
+        // update the k-mips of the active users in the order of items (the 
+        // same as kmips, so the k bounds are exactly the same)
+        for (int i = 0; i < num; ++i) {
+            int   id = active[i];
+            float user_norm = user_norms[id];
+            const float *ip = ips + (u64) i*cnt;
+            
+            MaxK_Array *list = arr[id];
+            float tau = list->min_key();
+            for (int j = 0; j < cnt; ++j) {
+                if (user_norm*norms[j] < tau) break;
+                tau = list->add(ip[j]);
+            }
+        }
+    }
+    for (int i = 0; i < m; ++i) {
+        update_k_bounds(k_max_, arr[i], k_bounds + (u64) i*k_max_);
+    }
 }
 
 // -----------------------------------------------------------------------------
@@ -140,6 +285,8 @@ void Scan::k_bounds_computation(    // compute k bounds for user_set
     const float *item_norms,            // l2-norm of items
     const float *item_set)              // item set
 {
+    Perf_Scope perf(PHASE_LOWER_BOUNDS);
+    
     MaxK_Array *arr = new MaxK_Array(k_max_);
     for (int i = 0; i < m_; ++i) {
         kmips(k_max_, n, user_norms_[i], user_set_ + (u64) i*d_, item_norms,
@@ -151,8 +298,11 @@ void Scan::k_bounds_computation(    // compute k bounds for user_set
 // -----------------------------------------------------------------------------
 Scan::~Scan()                       // destructor
 {
-    if (!user_norms_) { delete[] user_norms_; user_norms_ = nullptr; }
-    if (!k_bounds_)   { delete[] k_bounds_;   k_bounds_   = nullptr; }
+    delete[] user_norms_; user_norms_ = nullptr;
+    delete_huge(k_bounds_);
+    
+    delete[] item_norms_; item_norms_ = nullptr;
+    delete_huge(item_set_);
 }
 
 // -----------------------------------------------------------------------------
@@ -162,8 +312,8 @@ void Scan::display()                // display parameters
     printf("m             = %d\n", m_);
     printf("d             = %d\n", d_);
     printf("k_max         = %d\n", k_max_);
-    printf("indexing time = %g Seconds\n", g_pre_time);
-    printf("est. memory   = %g MB\n", g_memory / 1048576.0);
+    printf("indexing time = %g Seconds\n", pre_time_);
+    printf("est. memory   = %g MB\n", get_estimated_memory() / 1048576.0);
     printf("\n");
 }
 
@@ -173,7 +323,21 @@ void Scan::reverse_kmips(           // reverse k-mips
     const float *query,                 // query vector
     std::vector<int> &result)           // reverse k-mips result (return)
 {
-    gettimeofday(&g_start_time, nullptr);
+    filtered_reverse_kmips(k, query, nullptr, result);
+}
+
+// -----------------------------------------------------------------------------
+void Scan::filtered_reverse_kmips(  // reverse k-mips of filtered users
+    int   k,                            // top k value
+    const float *query,                 // query vector
+    const User_Filter *filter,          // filter of users (nullptr: none)
+    std::vector<int> &result)           // reverse k-mips result (return)
+{
+    Perf_Scope perf(PHASE_USER_SCAN);
+    
+    double start_time = get_time();
+    stats_.ip_count_ = 0UL;
+    stats_.prune_.reset();
     
     // clear space for result
     std::vector<int>().swap(result);
@@ -181,21 +345,106 @@ void Scan::reverse_kmips(           // reverse k-mips
     
     // compute l2-norm for query
     float query_norm = sqrt(calc_inner_product(d_, query, query));
-    ++g_ip_count;
+    ++stats_.ip_count_;
     
-    // sequential scan each user
+    // sequential scan each user (passing the filter), where the exact k-th 
+    // mip is the tight bound of both lemma 1 (No) and lemma 2 (Yes)
     for (int i = 0; i < m_; ++i) {
-        float tau = k_bounds_[i*k_max_+k-1]; // get the exact k-th mip
+        if (!pass_filter(filter, i)) continue;
+        
+        float tau = k_bounds_[(u64)i*k_max_+k-1]; // get the exact k-th mip
         float ip = calc_inner_product(d_, query, user_set_+(u64)i*d_);
-        ++g_ip_count;
+        ++stats_.ip_count_;
         
-        if (ip >= tau) result.push_back(i);
+        if (ip < tau) { ++stats_.prune_[STAGE_USER_LEMMA1]; continue; }
+        result.push_back(i); ++stats_.prune_[STAGE_USER_LEMMA2];
     }
-    gettimeofday(&g_end_time, nullptr);
+    double end_time = get_time();
     
-    double query_time = g_end_time.tv_sec - g_start_time.tv_sec + 
-        (g_end_time.tv_usec - g_start_time.tv_usec) / 1000000.0;
-    g_run_time += query_time;
+    stats_.time_ = end_time - start_time;
+}
+
+// -----------------------------------------------------------------------------
+void Scan::rank_reverse_kmips(      // reverse k-mips with ranks of users
+    int   k,                            // top k value
+    const float *query,                 // query vector
+    std::vector<int> &result,           // reverse k-mips result (return)
+    std::vector<int> &ranks)            // rank of query for result (return)
+{
+    Perf_Scope perf(PHASE_USER_SCAN);
+    
+    double start_time = get_time();
+    stats_.ip_count_ = 0UL;
+    stats_.prune_.reset();
+    
+    // clear space for result
+    std::vector<int>().swap(result);
+    std::vector<int>().swap(ranks);
+    assert(k > 0 && k <= k_max_);
+    
+    // compute l2-norm for query
+    float query_norm = sqrt(calc_inner_product(d_, query, query));
+    ++stats_.ip_count_;
+    
+    // sequential scan each user, where the rank of query is the first k' 
+    // whose exact k'-th mip is not larger than the ip
+    for (int i = 0; i < m_; ++i) {
+        const float *k_bound = k_bounds_ + (u64) i*k_max_;
+        float ip = calc_inner_product(d_, query, user_set_+(u64)i*d_);
+        ++stats_.ip_count_;
+        
+        if (ip < k_bound[k-1]) { ++stats_.prune_[STAGE_USER_LEMMA1]; continue; }
+        result.push_back(i); ++stats_.prune_[STAGE_USER_LEMMA2];
+        ranks.push_back(get_rank(ip, k, 1.0f, k_bound));
+    }
+    double end_time = get_time();
+    
+    stats_.time_ = end_time - start_time;
+}
+
+// -----------------------------------------------------------------------------
+void Scan::batch_reverse_kmips(     // reverse k-mips for a batch of queries
+    int   k,                            // top k value
+    int   qn,                           // number of queries
+    const float *query_set,             // query vectors
+    std::vector<std::vector<int> > &results, // results (return)
+    Query_Stats *stats)                 // stats of each query (return)
+{
+    Perf_Scope perf(PHASE_USER_SCAN);
+    
+    if (qn == 1) {
+        Reverse_KMIPS::batch_reverse_kmips(k, qn, query_set, results, stats);
+        return;
+    }
+    double start_time = get_time();
+    assert(k > 0 && k <= k_max_);
+    
+    results.resize(qn);
+    for (int j = 0; j < qn; ++j) std::vector<int>().swap(results[j]);
+    
+    // scan each user once for all queries, where the user vector and its k 
+    // bound stay in cache (the same kernel as reverse_kmips, so the results 
+    // are exactly the same)
+    for (int i = 0; i < m_; ++i) {
+        float tau = k_bounds_[(u64)i*k_max_+k-1]; // get the exact k-th mip
+        const float *user = user_set_ + (u64) i*d_;
+        for (int j = 0; j < qn; ++j) {
+            float ip = calc_inner_product(d_, query_set+(u64)j*d_, user);
+            if (ip >= tau) results[j].push_back(i);
+        }
+    }
+    double end_time = get_time();
+    
+    // each query shares the time of the batch
+    stats_.ip_count_ = (u64) m_;
+    stats_.time_ = (end_time - start_time) / qn;
+    stats_.prune_.reset();
+    for (int j = 0; j < qn; ++j) {
+        u64 num = results[j].size();
+        stats_.prune_[STAGE_USER_LEMMA1] = (u64) m_ - num;
+        stats_.prune_[STAGE_USER_LEMMA2] = num;
+        if (stats != nullptr) stats[j] = stats_;
+    }
 }
 
 } // end namespace ip
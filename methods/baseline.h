@@ -8,6 +8,7 @@
 #include "def.h"
 #include "pri_queue.h"
 #include "util.h"
+#include "rkmips.h"
 
 namespace ip {
 
@@ -17,20 +18,29 @@ namespace ip {
 //  Pre-processing Phase:
 //  1. compute l2-norm of all item_set and user_set
 //  2. sort item_set in descending order of their l2-norm
-//  3. determine and store k_max exact mips results for user_set
+//  3. determine and store k_max exact mips results for user_set (parallel: 
+//     by the tiled inner products of user tiles and norm-sorted item tiles)
 //  
 //  Online Query Phase:
-//  sequential check the user_set
+//  sequential check the user_set (a batch of queries checks each user once)
+//
+//  Streaming Mode (user_set larger than memory):
+//  keep the sorted item_set resident, and load the user_set chunk by chunk, 
+//  where the user ids of a chunk are local to the chunk
 // -----------------------------------------------------------------------------
-class Scan {
+class Scan : public Reverse_KMIPS {
 public:
-    int   m_;                       // user cardinality
+    int   n_;                       // item cardinality
+    int   m_;                       // user cardinality (of this chunk)
     int   d_;                       // dimensionality
     int   k_max_;                   // max k value
+    bool  parallel_;                // use openmp for parallel computing
     
     const float *user_set_;         // user set, O(1)
     float *user_norms_;             // l2-norm of user vectors, O(m)
     float *k_bounds_;               // k bounds for users, O(m*k_max)
+    float *item_norms_;             // l2-norm of sorted items (streaming), O(n)
+    float *item_set_;               // sorted items (streaming), O(n*d)
     
     // -------------------------------------------------------------------------
     Scan(                           // constructor
@@ -39,9 +49,25 @@ public:
         int   d,                        // dimensionality
         int   k_max,                    // max k value
         bool  parallel,                 // use openmp for parallel computing
+        int   huge,                     // backing of big arrays (HUGE_*)
         const float *item_set,          // item set
         const float *user_set);         // user set
     
+    // -------------------------------------------------------------------------
+    Scan(                           // constructor (streaming mode)
+        int   n,                        // item cardinality
+        int   d,                        // dimensionality
+        int   k_max,                    // max k value
+        int   chunk,                    // max # users of a chunk
+        bool  parallel,                 // use openmp for parallel computing
+        int   huge,                     // backing of big arrays (HUGE_*)
+        const float *item_set);         // item set
+    
+    // -------------------------------------------------------------------------
+    void load_users(                // load a chunk of users (streaming mode)
+        int   m,                        // # users of this chunk
+        const float *user_set);         // users of this chunk
+    
     // -------------------------------------------------------------------------
     ~Scan();                        // destructor
     
@@ -54,12 +80,35 @@ public:
         const float *query,             // query vector
         std::vector<int> &result);      // reverse k-mips result (return)
     
+    // -------------------------------------------------------------------------
+    void filtered_reverse_kmips(    // reverse k-mips of filtered users
+        int   k,                        // top k value
+        const float *query,             // query vector
+        const User_Filter *filter,      // filter of users (nullptr: none)
+        std::vector<int> &result);      // reverse k-mips result (return)
+    
+    // -------------------------------------------------------------------------
+    void rank_reverse_kmips(        // reverse k-mips with ranks of users
+        int   k,                        // top k value
+        const float *query,             // query vector
+        std::vector<int> &result,       // reverse k-mips result (return)
+        std::vector<int> &ranks);       // rank of query for result (return)
+    
+    // -------------------------------------------------------------------------
+    void batch_reverse_kmips(       // reverse k-mips for a batch of queries
+        int   k,                        // top k value
+        int   qn,                       // number of queries
+        const float *query_set,         // query vectors
+        std::vector<std::vector<int> > &results, // results (return)
+        Query_Stats *stats = nullptr);  // stats of each query (return)
+    
     // -------------------------------------------------------------------------
     u64 get_estimated_memory() {    // get estimated memory (bytes)
         uint64_t ret = 0UL;
         ret += sizeof(*this);
         ret += sizeof(float)*m_;   // user_norms_
         ret += sizeof(float)*m_*k_max_; // lower_bound_
+        if (item_set_) ret += sizeof(float)*n_*(d_+1); // item_set_ & norms
         
         return ret;
     }
@@ -77,6 +126,21 @@ public:
         const float *item_norms,        // l2-norm of sorted items
         const float *item_set);         // sorted items
     
+    // -------------------------------------------------------------------------
+    void tile_kmips(                // k-mips for a user tile by item tiles
+        int   m,                        // number of users in this tile
+        int   n,                        // item cardinality
+        const float *user_norms,        // l2-norm of users
+        const float *user_set,          // users
+        const float *item_norms,        // l2-norm of sorted items
+        const float *item_set,          // sorted items
+        int   *active,                  // active user ids (buffer)
+        float *users,                   // packed active users (buffer)
+        float *items,                   // transposed item tile (buffer)
+        float *ips,                     // inner products (buffer)
+        MaxK_Array **arr,               // top-k arrays (return)
+        float *k_bounds);               // k bounds (return)
+    
     // -------------------------------------------------------------------------
     void kmips(                     // k-mips by linear scan with pruning
         int   k,                        // top-k value
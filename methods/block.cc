@@ -28,9 +28,12 @@ User_Block::User_Block(             // constructor
     const int   *index,                 // index of users
     const float *norms,                 // l2-norms of users
     const float *users,                 // users
-    const float *lower_bounds)          // lower bounds of users
+    const float *lower_bounds,          // lower bounds of users
+    const u64   *hash_keys,             // srp-lsh hash keys of users
+    const float *hash_values)           // qalsh hash values of users
     : m_(m), k_max_(k_max), index_(index), norms_(norms), users_(users),
-    lower_bounds_(lower_bounds)
+    lower_bounds_(lower_bounds), hash_keys_(hash_keys), 
+    hash_values_(hash_values)
 {
     // init block lower bounds
     block_lower_bounds_ = new float[k_max];
@@ -59,6 +59,8 @@ public:
     const float *norms_;            // l2-norms of users
     const float *users_;            // users
     const float *lower_bounds_;     // lower bounds of users
+    const u64   *hash_keys_;        // srp-lsh hash keys of users
+    const float *hash_values_;      // qalsh hash values of users
     float *block_lower_bounds_;     // block lower bounds
     
     // -------------------------------------------------------------------------
@@ -68,7 +70,9 @@ public:
         const int   *index,             // index of users
         const float *norms,             // l2-norms of users
         const float *users,             // users
-        const float *lower_bounds);     // lower bounds of users
+        const float *lower_bounds,      // lower bounds of users
+        const u64   *hash_keys = nullptr, // srp-lsh hash keys of users
+        const float *hash_values = nullptr); // qalsh hash values of users
     
     // -------------------------------------------------------------------------
     ~User_Block();                  // destructor
@@ -12,17 +12,19 @@ Cone_Node::Cone_Node(               // constructor
     Cone_Node *lc,                      // left  child
     Cone_Node *rc,                      // right child
     int   *index,                       // data index
-    const float *data)                  // data points
+    const float *data,                  // data points
+    Arena *arena,                       // arena of nodes (for center_)
+    Arena *leaf_arena)                  // arena of leaves (for data_ etc.)
     : n_(n), d_(d), k_max_(-1), lc_(lc), rc_(rc), index_(index), 
     data_(nullptr), x_cos_(nullptr), x_sin_(nullptr), lower_bounds_(nullptr), 
-    node_lower_bounds_(nullptr)
+    node_lower_bounds_(nullptr), hash_keys_(nullptr), hash_values_(nullptr)
 {
     M_cos_  = MAXREAL;
     M_sin_  = MINREAL;
-    center_ = new float[d];
+    center_ = arena->alloc<float>(d);
     if (is_leaf) {
         // init the local data by the input index and data
-        data_ = new float[n*d];
+        data_ = leaf_arena->alloc<float>((u64) n*d);
         for (int i = 0; i < n; ++i) {
             const float *point = data + (u64) index[i]*d;
             float *new_point = data_ + (u64) i*d;
@@ -33,8 +35,8 @@ Cone_Node::Cone_Node(               // constructor
         norm_c_ = sqrt(calc_inner_product(d, center_, center_));
         
         // calc x_cos_ and x_sin_ of data points
-        x_cos_ = new float[n];
-        x_sin_ = new float[n];
+        x_cos_ = leaf_arena->alloc<float>(n);
+        x_sin_ = leaf_arena->alloc<float>(n);
         for (int i = 0; i < n; ++i) {
             const float *point = data_ + (u64) i*d;
             float x_cos = calc_inner_product(d, point, center_) / norm_c_;
@@ -67,25 +69,6 @@ Cone_Node::Cone_Node(               // constructor
     }
 }
 
-// -----------------------------------------------------------------------------
-Cone_Node::~Cone_Node()             // destructor
-{
-    if (lc_ != nullptr) { delete lc_; lc_ = nullptr; }
-    if (rc_ != nullptr) { delete rc_; rc_ = nullptr; }
-    
-    if (center_ != nullptr) { delete[] center_; center_ = nullptr; }
-    if (data_   != nullptr) { delete[] data_;   data_   = nullptr; }
-    if (x_cos_  != nullptr) { delete[] x_cos_;  x_cos_  = nullptr; }
-    if (x_sin_  != nullptr) { delete[] x_sin_;  x_sin_  = nullptr; }
-    
-    if (lower_bounds_ != nullptr) { 
-        delete[] lower_bounds_; lower_bounds_ = nullptr;
-    }
-    if (node_lower_bounds_ != nullptr) { 
-        delete[] node_lower_bounds_; node_lower_bounds_ = nullptr;
-    }
-}
-
 // -----------------------------------------------------------------------------
 void Cone_Node::kmips(              // k-mips on cone node
     float ip,                           // inner product of center and query
@@ -103,7 +86,7 @@ void Cone_Node::kmips(              // k-mips on cone node
     if (ub <= list->min_key()) return;
     
     // kmips through the cone node
-    if (data_ != nullptr) { // leaf node
+    if (lc_ == nullptr) { // leaf node
         linear_scan(q_cos, q_sin, query, cand, list);
     }
     else { // internal node
@@ -167,7 +150,7 @@ float Cone_Node::est_upper_bound(   // estimate upper bound for data point
 void Cone_Node::traversal(          // traversal cone-tree
     std::vector<Cone_Node*> &leaf)      // leaves (return)
 {
-    if (data_ != nullptr) {
+    if (lc_ == nullptr) {
         leaf.push_back(this);
     } 
     else {
@@ -183,14 +166,36 @@ Cone_Tree::Cone_Tree(               // constructor
     int   n,                            // number of data points
     int   d,                            // dimension of data points
     int   leaf_size,                    // leaf size of cone-tree
-    const float *data)                  // data points
-    : n_(n), d_(d), leaf_size_(leaf_size), data_(data)
+    const float *data,                  // data points
+    const Huge_Alloc &alloc,            // backing & account of leaf arena
+    u64   point_bytes,                  // bytes of method payload per point
+    u64   node_bytes,                   // bytes of method payload per node
+    Leaf_Sink *sink)                    // consumer of leaves (optional)
+    : n_(n), d_(d), leaf_size_(leaf_size), data_(data), sink_(sink)
 {
+    Perf_Scope perf(PHASE_TREE_BUILD);
+    
+    // size the arenas up front: a leaf keeps data_, x_cos_, x_sin_ and the 
+    // payload of a method (each padded to ARENA_ALIGN), and the leaves have 
+    // leaf_size/2 points on average (so there are about 4n/leaf_size nodes);
+    // with a sink, leaf_arena_ holds the payload of one leaf only
+    u64 num_nodes = 4UL*n/std::max(leaf_size, 1) + 1;
+    u64 node_size = sizeof(Cone_Node) + sizeof(float)*d + node_bytes + 
+        3*ARENA_ALIGN;
+    u64 leaf_n = sink != nullptr ? (u64) std::min(leaf_size, n) : (u64) n;
+    u64 leaf_bytes = leaf_n*(sizeof(float)*(d+2) + point_bytes) + 
+        (sink != nullptr ? 8 : num_nodes*4)*ARENA_ALIGN;
+    // (the nodes are on base pages, and the leaves on huge pages if asked)
+    Huge_Alloc node_alloc = { HUGE_OFF, alloc.account_ };
+    arena_      = new Arena(num_nodes*node_size, node_alloc);
+    leaf_arena_ = new Arena(leaf_bytes, alloc);
+    
     index_ = new int[n];
     int i = 0;
     std::iota(index_, index_+n, i++);
     
     root_ = build(n, index_);
+    if (sink_ != nullptr) { leaf_arena_->release(); sink_ = nullptr; }
 }
 
 // -----------------------------------------------------------------------------
@@ -200,8 +205,19 @@ Cone_Node* Cone_Tree::build(        // build a cone node
 {
     Cone_Node* cur = nullptr;
     if (n <= leaf_size_) {
-        // build leaf node
-        cur = new Cone_Node(n, d_, true, nullptr, nullptr, index, data_);
+        // build leaf node (the leaves are built in traversal order, and so
+        // are their payloads in leaf_arena_)
+        cur = new (arena_->alloc<Cone_Node>(1)) Cone_Node(n, d_, true, 
+            nullptr, nullptr, index, data_, arena_, leaf_arena_);
+        if (sink_ != nullptr) {
+            // stream the leaf to the sink, and reuse leaf_arena_ for the 
+            // payload of the next leaf
+            sink_->add_leaf(this, cur);
+            cur->data_ = nullptr; cur->x_cos_ = nullptr; 
+            cur->x_sin_ = nullptr; cur->lower_bounds_ = nullptr; 
+            cur->hash_keys_ = nullptr; cur->hash_values_ = nullptr;
+            leaf_arena_->reset();
+        }
     }
     else {
         // build internal node
@@ -232,7 +248,8 @@ Cone_Node* Cone_Tree::build(        // build a cone node
         
         Cone_Node* lc = build(left,   index);
         Cone_Node* rc = build(n-left, index+left);
-        cur = new Cone_Node(n, d_, false, lc, rc, index, data_);
+        cur = new (arena_->alloc<Cone_Node>(1)) Cone_Node(n, d_, false, 
+            lc, rc, index, data_, arena_, leaf_arena_);
     }
     return cur;
 }
@@ -261,8 +278,11 @@ int Cone_Tree::find_max_angle_id(   // find max angle id
 // -----------------------------------------------------------------------------
 Cone_Tree::~Cone_Tree()             // destructor
 {
+    // the nodes and their arrays are released with the arenas
     if (index_ != nullptr) { delete[] index_; index_ = nullptr; }
-    if (root_  != nullptr) { delete   root_;  root_  = nullptr; }
+    delete arena_;      arena_      = nullptr;
+    delete leaf_arena_; leaf_arena_ = nullptr;
+    root_ = nullptr;
 }
 
 // -----------------------------------------------------------------------------
@@ -3,16 +3,23 @@
 #include <iostream>
 #include <algorithm>
 #include <cassert>
+#include <new>
 #include <vector>
 
 #include "def.h"
 #include "util.h"
 #include "pri_queue.h"
+#include "arena.h"
 
 namespace ip {
 
 // -----------------------------------------------------------------------------
 //  Cone_Node: leaf and internal node structure of Cone_Tree
+//
+//  A node and its arrays are placed in the arenas of its Cone_Tree and are
+//  released with them, so a node has no destructor; the arrays set by a 
+//  method (e.g., lower_bounds_ & hash_keys_) come from the same arenas, or 
+//  else are deleted by the method itself (e.g., for a shared cone-tree)
 // -----------------------------------------------------------------------------
 class Cone_Node {
 public:
@@ -34,6 +41,8 @@ public:
     float *x_sin_;                  // x sin(angle) of center and data (only for leaf)
     float *lower_bounds_;           // lower bounds of data points
     float *node_lower_bounds_;      // lower bounds for this node
+    u64   *hash_keys_;              // srp-lsh hash keys of data points
+    float *hash_values_;            // qalsh hash values of data points
     
     // -------------------------------------------------------------------------
     Cone_Node(                      // constructor
@@ -43,10 +52,9 @@ public:
         Cone_Node* lc,              // left  child
         Cone_Node* rc,              // right child
         int   *index,               // data index
-        const float *data);         // data points
-    
-    // -------------------------------------------------------------------------
-    ~Cone_Node();                   // destructor 
+        const float *data,          // data points
+        Arena *arena,               // arena of nodes (for center_)
+        Arena *leaf_arena);         // arena of leaves (for data_ etc.)
     
     // -------------------------------------------------------------------------
     void kmips(                     // k-mips on cone node
@@ -66,13 +74,20 @@ public:
         ret += sizeof(*this);
         ret += sizeof(float)*d_; // center_
         
-        if (data_ == nullptr) { // internal node
+        if (lc_ != nullptr) { // internal node
             ret += lc_->get_estimated_memory();
             ret += rc_->get_estimated_memory();
         } else { // leaf node
-            ret += sizeof(float)*n_*3;      // norms_, x_cos_, & x_sin_
-            ret += sizeof(float)*n_*k_max_; // lower_bounds_
-            ret += sizeof(float)*k_max_;    // node_lower_bounds_
+            if (node_lower_bounds_ != nullptr) { // node_lower_bounds_
+                ret += sizeof(float)*k_max_;
+            }
+            if (data_ == nullptr) return ret; // payload is on disk
+            
+            ret += sizeof(float)*n_*d_;     // data_
+            ret += sizeof(float)*n_*2;      // x_cos_ & x_sin_
+            if (lower_bounds_ != nullptr) { // lower_bounds_
+                ret += sizeof(float)*n_*k_max_;
+            }
         }
         return ret;
     }
@@ -97,8 +112,29 @@ public:
         float q_sin);                   // |q| sin(\phi)
 };
 
+class Cone_Tree;
+
+// -----------------------------------------------------------------------------
+//  Leaf_Sink: a consumer of the leaves of a Cone_Tree, which are passed to it
+//  one by one as soon as they are built (in traversal order), so that it can
+//  move their payloads away (e.g., to disk) before the next leaf is built
+// -----------------------------------------------------------------------------
+class Leaf_Sink {
+public:
+    virtual ~Leaf_Sink() {}
+    
+    // -------------------------------------------------------------------------
+    virtual void add_leaf(          // consume a leaf just built
+        Cone_Tree *tree,                // cone-tree (arena_ & leaf_arena_)
+        Cone_Node *leaf) = 0;           // leaf (with its payload)
+};
+
 // -----------------------------------------------------------------------------
 //  Cone_Tree is a tree structure for k-Maximum Inner Product Search 
+//
+//  If a Leaf_Sink is given, the payload of each leaf is released right after
+//  the sink consumes it, so leaf_arena_ only holds one leaf at a time and 
+//  the tree keeps its skeleton (nodes, centers & node payloads) only
 // -----------------------------------------------------------------------------
 class Cone_Tree {
 public:
@@ -109,13 +145,19 @@ public:
     
     int   *index_;                  // data index
     Cone_Node *root_;               // the root node of cone-tree
+    Arena *arena_;                  // nodes, centers & node lower bounds
+    Arena *leaf_arena_;             // payloads of leaves (in traversal order)
     
     // -------------------------------------------------------------------------
     Cone_Tree(                      // constructor
         int   n,                        // number of data points
         int   d,                        // dimension of data points
         int   leaf_size,                // leaf size of cone-tree
-        const float *data);             // data points
+        const float *data,              // data points
+        const Huge_Alloc &alloc,        // backing & account of leaf arena
+        u64   point_bytes = 0,          // bytes of method payload per point
+        u64   node_bytes = 0,           // bytes of method payload per node
+        Leaf_Sink *sink = nullptr);     // consumer of leaves (optional)
     
     // -------------------------------------------------------------------------
     ~Cone_Tree();                   // destructor
@@ -150,6 +192,8 @@ public:
     }
     
 protected:
+    Leaf_Sink *sink_;               // consumer of leaves (nullptr: none)
+    
     // -------------------------------------------------------------------------
     Cone_Node* build(               // build a cone node
         int n,                          // numebr of data points
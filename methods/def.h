@@ -43,7 +43,8 @@ const int MININT           = -MAXINT;
 const int RANDOM_SEED      = 41; // 41 52 63 77 81
 const std::vector<int> Ks  = { 1,5,10,20,30,40,50 };
 const int K_MAX            = 50;
-const int THREAD_NUM       = 48;
+const int USER_TILE        = 64;   // Scan (tiled k bounds computation)
+const int ITEM_TILE        = 256;  // Scan (tiled k bounds computation)
 
 const int COEFF            = 4;    // H2_ALSH, SA_ALSH, SA_ALSH+
 const int BLOCK_MAX_NUM    = 10000;// H2_ALSH, SA_ALSH, SA_ALSH+
@@ -51,6 +52,20 @@ const int N_PTS_INDEX      = 1000; // H2_ALSH, SA_ALSH, SA_ALSH+
 
 const int CANDIDATES       = 100;  // SRP_LSH, QALSH
 const int SCAN_SIZE        = 64;   // QALSH
+const f32 CONE_SLACK       = 1e-3F;// Dual_Cone (slack of cone angles)
+const int LEAF_ALIGN       = 4096; // SA_CONE (alignment of leaves on disk)
+const int LEAF_BATCH       = 16;   // SA_CONE (# leaves of a batch read)
+const int USER_CHUNK       = 65536;// SA_CONE (# users of a chunk streamed)
+const int IO_THREAD_NUM    = 8;    // SA_CONE (# threads of batch reads)
+const u32 TRUTH_MAGIC      = 0x52544B52; // Truth_Set (binary truth format)
+const u32 TRUTH_IDS        = 0;    // Truth_Set (result as sorted u32 ids)
+const u32 TRUTH_BITMAP     = 1;    // Truth_Set (result as a bitmap of m bits)
+const u32 LB_MAGIC         = 0x424C4B52; // Lower_Bounds (binary lower bounds)
+const u32 INDEX_MAGIC      = 0x58444E49; // Reverse_KMIPS (index parameters)
+const u32 SERVER_MAGIC     = 0x51524B52; // Server (request & response)
+const int HIST_SUB_BITS    = 7;    // Histogram (log2 # buckets per power of 2)
+const int HIST_SUB         = 1 << HIST_SUB_BITS; // Histogram
+const std::vector<double> PCTs = { 50.0,90.0,99.0,99.9,100.0 }; // percentiles
 const f32 APPRX_RATIO_MIPS = 1.0f; // Approximation Ratio for MIPS (0,1]
 const f32 APPRX_RATIO_NNS  = 2.0f; // Approximation Ratio for NNS  [1,+\infty)
 
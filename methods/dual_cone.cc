@@ -0,0 +1,356 @@
+
+#include "dual_cone.h"
+
+namespace ip {
+
+// -----------------------------------------------------------------------------
+Dual_Cone::Dual_Cone(               // constructor
+    int   n,                            // item cardinality
+    int   m,                            // user cardinality
+    int   d,                            // dimensionality
+    int   k_max,                        // max k value
+    int   leaf,                         // leaf size of cone-trees
+    int   huge,                         // backing of big arrays (HUGE_*)
+    const float *item_set,              // item set
+    const float *user_set)              // user set (normalized)
+    : Reverse_KMIPS(ALG_DUAL_CONE, n, m, d, k_max, -1, leaf, -1.0f, huge), 
+    n_(n), m_(m), d_(d), k_max_(k_max), leaf_(leaf)
+{
+    timeval start_time, end_time;
+    gettimeofday(&start_time, nullptr);
+
+    // 1. compute l2-norms & sort item_set in descending order of l2-norms
+    item_index_ = new int[n];
+    item_norms_ = new float[n];
+    item_set_   = new_huge<float>((u64) n*d, alloc_);
+    sort_by_norm(n, d, item_set, item_index_, item_norms_, item_set_);
+
+    // 2. build a cone-tree for normalized item_set (which is only used to
+    //    build the cone-tree), and flatten the cone-tree
+    float *norm_item_set = new float[(u64) n*d];
+    normalize_data(n, d, item_set_, nullptr, norm_item_set);
+    item_tree_ = new Cone_Tree(n, d, leaf, norm_item_set, alloc_);
+    delete[] norm_item_set;
+
+    item_nodes_.clear();
+    build_item_nodes(item_tree_->root_);
+
+    // 3. build a cone-tree for (normalized) user_set, and compute the lower
+    //    bounds for the users and the user nodes
+    n0_ = k_max*COEFF; // only consider the first n0 elements in item_set
+    if (n0_ > n) n0_ = n; // keep at most n
+
+    user_tree_ = new Cone_Tree(m, d, leaf, user_set, alloc_, 
+        sizeof(float)*k_max, sizeof(float)*k_max);
+
+    float *lower_bounds = new float[(u64) m*k_max];
+    calc_lower_bounds(m, n0_, d, k_max, item_norms_, item_set_, nullptr,
+        user_set, lower_bounds);
+    num_inner_ = 0;
+    node_lower_bounds_computation(lower_bounds, user_tree_->root_);
+    delete[] lower_bounds;
+
+    // get the pre-processing time
+    gettimeofday(&end_time, nullptr);
+    pre_time_ = end_time.tv_sec - start_time.tv_sec +
+        (end_time.tv_usec - start_time.tv_usec) / 1000000.0;
+}
+
+// -----------------------------------------------------------------------------
+void Dual_Cone::node_lower_bounds_computation(// lower bounds for a node
+    const float *lower_bounds,          // lower bounds of users (input order)
+    Cone_Node *node)                    // user cone-node
+{
+    node->k_max_ = k_max_;
+    node->node_lower_bounds_ = user_tree_->arena_->alloc<float>(k_max_);
+    float *node_lower_bounds = node->node_lower_bounds_;
+
+    if (node->data_ != nullptr) { // leaf node
+        // copy the lower bounds of users (by the data index) to this leaf
+        int m = node->n_;
+        node->lower_bounds_ = user_tree_->leaf_arena_->alloc<float>(
+            (u64) m*k_max_);
+        for (int i = 0; i < k_max_; ++i) node_lower_bounds[i] = MAXREAL;
+
+        for (int i = 0; i < m; ++i) {
+            const float *lb = lower_bounds + (u64) node->index_[i]*k_max_;
+            std::copy(lb, lb+k_max_, node->lower_bounds_ + (u64) i*k_max_);
+            for (int j = 0; j < k_max_; ++j) {
+                if (node_lower_bounds[j] > lb[j]) node_lower_bounds[j] = lb[j];
+            }
+        }
+    }
+    else { // internal node
+        node_lower_bounds_computation(lower_bounds, node->lc_);
+        node_lower_bounds_computation(lower_bounds, node->rc_);
+        ++num_inner_;
+
+        const float *lc_lb = node->lc_->node_lower_bounds_;
+        const float *rc_lb = node->rc_->node_lower_bounds_;
+        for (int j = 0; j < k_max_; ++j) {
+            node_lower_bounds[j] = std::min(lc_lb[j], rc_lb[j]);
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+int Dual_Cone::build_item_nodes(    // flatten the item cone-tree
+    Cone_Node *node)                    // item cone-node
+{
+    // add this node (in pre-order)
+    int id = (int) item_nodes_.size();
+    item_nodes_.push_back(Item_Node());
+
+    float max_norm = MINREAL, min_norm = MAXREAL;
+    for (int i = 0; i < node->n_; ++i) {
+        float norm = item_norms_[node->index_[i]];
+        if (norm > max_norm) max_norm = norm;
+        if (norm < min_norm) min_norm = norm;
+    }
+    // add its children
+    int lc = -1, rc = -1;
+    if (node->data_ == nullptr) {
+        lc = build_item_nodes(node->lc_);
+        rc = build_item_nodes(node->rc_);
+    }
+    // NOTE: item_nodes_ may be re-allocated, so fill this node at last
+    Item_Node &item = item_nodes_[id];
+    item.node_     = node;
+    item.lc_       = lc;
+    item.rc_       = rc;
+    item.omega_    = calc_omega(node);
+    item.max_norm_ = max_norm;
+    item.min_norm_ = min_norm;
+
+    return id;
+}
+
+// -----------------------------------------------------------------------------
+float Dual_Cone::calc_omega(        // calc angle of a cone-node
+    const Cone_Node *node)              // cone-node
+{
+    // add a slack to the angle to tolerate the rounding errors
+    float cos_omega = std::max(-1.0f, std::min(1.0f, node->M_cos_));
+    return std::min(PI, (float) acos(cos_omega) + CONE_SLACK);
+}
+
+// -----------------------------------------------------------------------------
+void Dual_Cone::calc_ip_bounds(     // calc ip bounds of users and items
+    float theta,                        // angle between cone centers
+    float omega,                        // angle of both cones
+    const Item_Node &item,              // item node
+    float &lb,                          // lower bound (return)
+    float &ub)                          // upper bound (return)
+{
+    // the angle between (unit) users and items is in [theta-omega,theta+omega]
+    float max_cos = cos(std::max(0.0f, theta - omega));
+    float min_cos = cos(std::min(PI, theta + omega));
+
+    ub = max_cos >= 0.0f ? item.max_norm_*max_cos : item.min_norm_*max_cos;
+    lb = min_cos >= 0.0f ? item.min_norm_*min_cos : item.max_norm_*min_cos;
+}
+
+// -----------------------------------------------------------------------------
+Dual_Cone::~Dual_Cone()             // destructor
+{
+    std::vector<Item_Node>().swap(item_nodes_);
+
+    if (item_tree_  != nullptr) { delete item_tree_;   item_tree_  = nullptr; }
+    if (user_tree_  != nullptr) { delete user_tree_;   user_tree_  = nullptr; }
+    delete_huge(item_set_);
+    if (item_norms_ != nullptr) { delete[] item_norms_; item_norms_ = nullptr; }
+    if (item_index_ != nullptr) { delete[] item_index_; item_index_ = nullptr; }
+}
+
+// -------------------------------------------------------------------------
+void Dual_Cone::display()           // display parameters
+{
+    std::vector<Cone_Node*> leaves;
+    user_tree_->traversal(leaves);
+    int num_user_leaves = (int) leaves.size();
+
+    leaves.clear();
+    item_tree_->traversal(leaves);
+    int num_item_leaves = (int) leaves.size();
+
+    printf("Parameters of Dual_Cone:\n");
+    printf("n             = %d\n",   n_);
+    printf("m             = %d\n",   m_);
+    printf("d             = %d\n",   d_);
+    printf("k_max         = %d\n",   k_max_);
+    printf("leaf          = %d\n",   leaf_);
+    printf("# user leaves = %d\n",   num_user_leaves);
+    printf("# item leaves = %d\n",   num_item_leaves);
+    printf("# item nodes  = %d\n\n", (int) item_nodes_.size());
+}
+
+// -----------------------------------------------------------------------------
+void Dual_Cone::reverse_kmips(      // reverse k-mips
+    int   k,                            // top k value
+    const float *query,                 // query vector
+    std::vector<int> &result)           // reverse k-mips result (return)
+{
+    double start_time = get_time();
+    stats_.ip_count_ = 0UL;
+    stats_.prune_.reset();
+    std::vector<int>().swap(result);// clear space for result
+    assert(k > 0 && k <= k_max_);   // validate the range of k
+
+    // compute l2-norm for query
+    float query_norm = sqrt(calc_inner_product(d_, query, query));
+    ++stats_.ip_count_;
+
+    // traverse the user cone-tree with the root of item cone-tree
+    const Cone_Node *root = user_tree_->root_;
+    float ip = calc_inner_product(d_, root->center_, query); ++stats_.ip_count_;
+
+    std::vector<int> cand(1, 0);
+    traversal(k, 0, ip, query_norm, query, root, cand, result);
+    double end_time = get_time();
+
+    stats_.time_ = end_time - start_time;
+}
+
+// -----------------------------------------------------------------------------
+void Dual_Cone::traversal(          // dual-tree traversal for reverse k-mips
+    int   k,                            // top k value
+    int   sure,                         // # items beating query for all users
+    float ip,                           // inner product of center and query
+    float query_norm,                   // l2-norm of query
+    const float *query,                 // query vector
+    const Cone_Node *user_node,         // user cone-node
+    const std::vector<int> &cand,       // candidate item nodes
+    std::vector<int> &result)           // reverse k-mips result (return)
+{
+    // bound the ips of the (unit) users in this node with the query
+    float omega_u = calc_omega(user_node);
+    float cos_phi = ip / (user_node->norm_c_ * query_norm);
+    float phi = acos(std::max(-1.0f, std::min(1.0f, cos_phi)));
+
+    float uq_lb = query_norm * cos(std::min(PI, phi + omega_u));
+    float uq_ub = query_norm * cos(std::max(0.0f, phi - omega_u));
+
+    // use the node lower bound for pruning
+    if (uq_ub < user_node->node_lower_bounds_[k-1]) { // No
+        ++stats_.prune_[STAGE_BLOCK_CONE]; return;
+    }
+
+    // classify the candidate item nodes with this user node
+    std::vector<int> stack(cand), next;
+    int rest = 0; // # items in the item nodes kept for the children
+    while (!stack.empty()) {
+        int id = stack.back(); stack.pop_back();
+        const Item_Node &item = item_nodes_[id];
+        int n = item.node_->n_;
+
+        // the bounds are the loosest at the angles 0 (lb) and PI (ub): if
+        // neither can count or drop the item node, keep it without the angle
+        float lb, ub;
+        float omega = omega_u + item.omega_;
+        calc_ip_bounds(0.0f, omega, item, lb, ub); float max_lb = lb;
+        calc_ip_bounds(PI,   omega, item, lb, ub); float min_ub = ub;
+        if (max_lb > uq_ub || min_ub <= uq_lb) {
+            float theta = acos(std::max(-1.0f, std::min(1.0f,
+                calc_inner_product(d_, user_node->center_, item.node_->center_)
+                / (user_node->norm_c_ * item.node_->norm_c_))));
+            ++stats_.ip_count_; ++stats_.prune_[STAGE_ITEM_VISIT];
+
+            calc_ip_bounds(theta, omega, item, lb, ub);
+        }
+        if (lb > uq_ub) {
+            // all items beat the query for all users in this node
+            ++stats_.prune_[STAGE_ITEM_EARLY];
+            sure += n;
+            if (sure >= k) { // No for all users
+                ++stats_.prune_[STAGE_BLOCK_CONE]; return;
+            }
+        }
+        else if (ub <= uq_lb) { // no item beats the query for any user
+            ++stats_.prune_[STAGE_ITEM_EARLY];
+        }
+        else {
+            // split the larger cone first
+            if (item.lc_ >= 0 && item.omega_ >= omega_u) {
+                stack.push_back(item.lc_);
+                stack.push_back(item.rc_);
+            }
+            else {
+                next.push_back(id); rest += n;
+            }
+        }
+    }
+    // fewer than k items can beat the query: Yes for all users
+    if (sure + rest < k) {
+        const int *index = user_node->index_;
+        for (int i = 0; i < user_node->n_; ++i) result.push_back(index[i]);
+        stats_.prune_[STAGE_USER_LEMMA2] += user_node->n_;
+        return;
+    }
+
+    if (user_node->data_ != nullptr) { // leaf node
+        float q_cos = ip / user_node->norm_c_;
+        float q_sin = sqrt(std::max(0.0f, SQR(query_norm) - SQR(q_cos)));
+        linear_scan(k, q_cos, q_sin, query, user_node, result);
+    }
+    else { // internal node
+        const Cone_Node *lc = user_node->lc_;
+        const Cone_Node *rc = user_node->rc_;
+
+        float lc_ip = calc_inner_product(d_, lc->center_, query);
+        float rc_ip = (ip*user_node->n_ - lc_ip*lc->n_) / rc->n_;
+        ++stats_.ip_count_;
+
+        traversal(k, sure, lc_ip, query_norm, query, lc, next, result);
+        traversal(k, sure, rc_ip, query_norm, query, rc, next, result);
+    }
+}
+
+// -----------------------------------------------------------------------------
+void Dual_Cone::linear_scan(        // check each user in a user leaf
+    int   k,                            // top k value
+    float q_cos,                        // |q| cos(phi) of leaf center
+    float q_sin,                        // |q| sin(phi) of leaf center
+    const float *query,                 // query vector
+    const Cone_Node *user_node,         // user cone-node (leaf)
+    std::vector<int> &result)           // reverse k-mips result (return)
+{
+    float item_k_norm = item_norms_[k-1]; // k-th largest item norm
+    for (int i = 0; i < user_node->n_; ++i) {
+        const float *lower_bound = user_node->lower_bounds_ + (u64) i*k_max_;
+        float user_k_lb = lower_bound[k-1];
+
+        // use the point upper bound and the lower bound for pruning
+        float ub = q_cos * user_node->x_cos_[i] + q_sin * user_node->x_sin_[i];
+        if (ub < user_k_lb) { ++stats_.prune_[STAGE_USER_CONE]; continue; }
+
+        const float *user = user_node->data_ + (u64) i*d_;
+        float uq_ip = calc_inner_product(d_, user, query); ++stats_.ip_count_;
+        if (uq_ip < user_k_lb) { ++stats_.prune_[STAGE_USER_LEMMA1]; continue; }
+
+        // user_norm = 1.0, so fewer than k items beat the query if its ip 
+        // is not below the k-th largest item norm
+        if (uq_ip >= item_k_norm) {
+            result.push_back(user_node->index_[i]); // Yes
+            ++stats_.prune_[STAGE_USER_LEMMA2]; continue;
+        }
+
+        // count the items beating the query: the lower bounds are the top-k
+        // ips of the first n0 items, so scan the rest from n0 in descending
+        // order of l2-norms (an upper bound of ip) until k items are found
+        ++stats_.prune_[STAGE_USER_KMIPS];
+        int cnt = 0;
+        for (int j = 0; j < k; ++j) if (lower_bound[j] > uq_ip) ++cnt;
+        for (int j = n0_; j < n_ && cnt < k; ++j) {
+            if (item_norms_[j] <= uq_ip) break;
+
+            const float *item = item_set_ + (u64) j*d_;
+            float ip = calc_inner_product(d_, item, user);
+            ++stats_.ip_count_; ++stats_.prune_[STAGE_CANDIDATE];
+
+            if (ip > uq_ip) ++cnt;
+        }
+        if (cnt < k) result.push_back(user_node->index_[i]); // Yes
+    }
+}
+
+} // end namespace ip
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <iostream>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <vector>
+
+#include "def.h"
+#include "util.h"
+#include "rkmips.h"
+#include "pri_queue.h"
+#include "cone_tree.h"
+#include "lower_bounds.h"
+
+namespace ip {
+
+// -----------------------------------------------------------------------------
+//  Item_Node: an item cone-node with the l2-norm range of its items
+// -----------------------------------------------------------------------------
+struct Item_Node {
+    Cone_Node *node_;               // cone-node of normalized items
+    int   lc_;                      // id of left  child (-1 for leaf)
+    int   rc_;                      // id of right child (-1 for leaf)
+    float omega_;                   // angle of cone
+    float max_norm_;                // max l2-norm of items
+    float min_norm_;                // min l2-norm of items
+};
+
+// -----------------------------------------------------------------------------
+//  Dual_Cone: a data structure designed for performing exact reverse k-mips
+//  by traversing a user cone-tree and an item cone-tree together, which in 
+//  effect is the pruning of SA_CONE (by the bounds of user cone-nodes and 
+//  users) plus an exact fallback (the k-mips over the norm-sorted items)
+//
+//  Pre-processing Phase:
+//  1. compute l2-norms & sort item_set in descending order of l2-norms
+//  2. build a cone-tree for normalized item_set, and flatten the cone-tree
+//     with the l2-norm range of each node
+//  3. build a cone-tree for (normalized) user_set, and compute the lower
+//     bounds for the users and the user nodes
+//
+//  Online Query Phase:
+//  1. traverse the user cone-tree from the root with the item root node
+//  2. for each user node, prune it by its lower bound, and then bound the
+//     ips of its users with the query and with the candidate item nodes: an
+//     item node is counted if all its items beat the query for all users, 
+//     dropped if none of them can, and kept (or split into its children) 
+//     otherwise, where the angle between the cones is only computed if some
+//     angle could count or drop the item node
+//  3. prune the user node if >= k items are counted, and add all its users
+//     if < k items are counted or kept
+//  4. for each user in a leaf, prune it by its point upper bound and lower
+//     bound, add it if its ip beats the k-th largest item norm, or else 
+//     count the items beating the query by the k-mips over the sorted items
+//     (from the top-k ips of the first n0 items kept as its lower bounds)
+//
+//  NOTE: the item cone-tree only decides whole user nodes (steps 2 & 3), and
+//  the k-mips in step 4 does not walk the kept item nodes: it is over the 
+//  norm-sorted items (with early stop), as the cones of high-dimensional 
+//  data are wide (e.g., the leaves of d = 100 have angles of about 1.4), so 
+//  the item nodes are seldom counted or dropped
+// -----------------------------------------------------------------------------
+class Dual_Cone : public Reverse_KMIPS {
+public:
+    Dual_Cone(                      // constructor
+        int   n,                        // item cardinality
+        int   m,                        // user cardinality
+        int   d,                        // dimensionality
+        int   k_max,                    // max k value
+        int   leaf,                     // leaf size of cone-trees
+        int   huge,                     // backing of big arrays (HUGE_*)
+        const float *item_set,          // item set
+        const float *user_set);         // user set (normalized)
+
+    // -------------------------------------------------------------------------
+    ~Dual_Cone();                   // destructor
+
+    // -------------------------------------------------------------------------
+    void display();                 // display parameters
+
+    // -------------------------------------------------------------------------
+    void reverse_kmips(             // reverse k-mips
+        int   k,                        // top k value
+        const float *query,             // query vector
+        std::vector<int> &result);      // reverse k-mips result (return)
+
+    // -------------------------------------------------------------------------
+    u64 get_estimated_memory() {    // get memory usage
+        u64 ret = 0;
+        ret += sizeof(*this);
+        ret += (sizeof(int)+sizeof(float))*n_; // item_index_ & item_norms_
+        ret += sizeof(float)*n_*d_; // item_set_
+        ret += sizeof(Item_Node)*item_nodes_.size(); // item_nodes_
+        ret += item_tree_->get_estimated_memory();
+        ret += user_tree_->get_estimated_memory();
+        ret += sizeof(float)*k_max_*num_inner_; // node_lower_bounds_
+
+        return ret;
+    }
+
+protected:
+    int   n_;                       // item cardinality
+    int   m_;                       // user cardinality
+    int   d_;                       // dimensionality
+    int   k_max_;                   // max k value
+    int   leaf_;                    // leaf size of cone-trees
+    int   n0_;                      // first n0 items for lower bounds
+
+    float *item_set_;               // sorted item vectors
+    float *item_norms_;             // sorted item l2-norms
+    int   *item_index_;             // sorted item index
+    Cone_Tree *item_tree_;          // cone-tree for items
+    std::vector<Item_Node> item_nodes_;// flattened item cone-nodes
+
+    Cone_Tree *user_tree_;          // cone-tree for users
+    int   num_inner_;               // number of inner user nodes
+
+    // -------------------------------------------------------------------------
+    void node_lower_bounds_computation(// lower bounds for a user node
+        const float *lower_bounds,      // lower bounds of users (input order)
+        Cone_Node *node);               // user cone-node
+
+    // -------------------------------------------------------------------------
+    int build_item_nodes(           // flatten the item cone-tree
+        Cone_Node *node);               // item cone-node
+
+    // -------------------------------------------------------------------------
+    float calc_omega(               // calc angle of a cone-node
+        const Cone_Node *node);         // cone-node
+
+    // -------------------------------------------------------------------------
+    void calc_ip_bounds(            // calc ip bounds of users and items
+        float theta,                    // angle between cone centers
+        float omega,                    // angle of both cones
+        const Item_Node &item,          // item node
+        float &lb,                      // lower bound (return)
+        float &ub);                     // upper bound (return)
+
+    // -------------------------------------------------------------------------
+    void traversal(                 // dual-tree traversal for reverse k-mips
+        int   k,                        // top k value
+        int   sure,                     // # items beating query for all users
+        float ip,                       // inner product of center and query
+        float query_norm,               // l2-norm of query
+        const float *query,             // query vector
+        const Cone_Node *user_node,     // user cone-node
+        const std::vector<int> &cand,   // candidate item nodes
+        std::vector<int> &result);      // reverse k-mips result (return)
+
+    // -------------------------------------------------------------------------
+    void linear_scan(               // check each user in a user leaf
+        int   k,                        // top k value
+        float q_cos,                    // |q| cos(phi) of leaf center
+        float q_sin,                    // |q| sin(phi) of leaf center
+        const float *query,             // query vector
+        const Cone_Node *user_node,     // user cone-node (leaf)
+        std::vector<int> &result);      // reverse k-mips result (return)
+};
+
+} // end namespace ip
@@ -9,16 +9,19 @@ H2_ALSH::H2_ALSH(                   // constructor
     int   m,                            // user cardinality
     int   d,                            // dimensionality
     float b,                            // interval ratio for blocking items
+    int   huge,                         // backing of big arrays (HUGE_*)
     const float *item_set,              // item set
     const float *user_set)              // user set
-    : n_(n), m_(m), d_(d), b_(b), user_set_(user_set)
+    : Reverse_KMIPS(ALG_H2_ALSH, n, m, d, -1, -1, -1, b, huge), n_(n), m_(m), 
+    d_(d), b_(b), user_set_(user_set)
 {
-    gettimeofday(&g_start_time, nullptr);
+    timeval start_time, end_time;
+    gettimeofday(&start_time, nullptr);
     
     // 1. compute l2-norms & sort item_set in descending order of l2-norms
     item_index_ = new int[n];
     item_norms_ = new float[n];
-    item_set_   = new float[(u64) n*d];
+    item_set_   = new_huge<float>((u64) n*d, alloc_);
     compute_norm_and_sort(n, item_set, item_index_, item_norms_, item_set_);
     
     // 2. compute l2-norms for user_set
@@ -31,11 +34,10 @@ H2_ALSH::H2_ALSH(                   // constructor
     // 3. build blocks for the rest item_set (with h2-trans) for batch pruning
     blocking_item_set(n, item_norms_, item_set_);
     
-    // get the pre-processing time and estimated memory
-    gettimeofday(&g_end_time, nullptr);
-    g_pre_time = g_end_time.tv_sec - g_start_time.tv_sec + 
-        (g_end_time.tv_usec - g_start_time.tv_usec) / 1000000.0;
-    g_memory = get_estimated_memory();
+    // get the pre-processing time
+    gettimeofday(&end_time, nullptr);
+    pre_time_ = end_time.tv_sec - start_time.tv_sec + 
+        (end_time.tv_usec - start_time.tv_usec) / 1000000.0;
 }
 
 // -----------------------------------------------------------------------------
@@ -46,6 +48,8 @@ void H2_ALSH::compute_norm_and_sort(// compute l2-norm and sort (descending)
     float *data_norms,                  // l2-norm of sorted data (return)
     float *data_set)                    // sorted data (return)
 {
+    Perf_Scope perf(PHASE_NORM_SORT);
+    
     // compute l2-norms for item_set
     Result *ret = new Result[n];
     for (int i = 0; i < n; ++i) {
@@ -73,6 +77,8 @@ void H2_ALSH::blocking_item_set(    // split the rest item_set into blocks
     const float *item_norms,            // item l2-norms
     const float *item_set)              // item set
 {
+    Perf_Scope perf(PHASE_HASHING);
+    
     hashs_.clear();
     
     // split item_set into blocks and build qalsh for each block
@@ -111,7 +117,7 @@ void H2_ALSH::add_block_by_items(   // add one block by items
         float *h2_item = new float[d_+1];
         
         // build hash tables for qalsh
-        block->lsh_ = new QALSH(n, d_+1, APPRX_RATIO_NNS);
+        block->lsh_ = new QALSH(n, d_+1, APPRX_RATIO_NNS, alloc_);
         
         QALSH *lsh = block->lsh_;
         int m = lsh->m_;
@@ -145,11 +151,11 @@ H2_ALSH::~H2_ALSH()                 // destructor
     for (auto hash : hashs_) { delete hash; hash = nullptr; }
     std::vector<Item_Block*>().swap(hashs_);
     
-    if (!item_set_)     { delete[] item_set_;     item_set_     = nullptr; }
-    if (!item_norms_)   { delete[] item_norms_;   item_norms_   = nullptr; }
-    if (!item_index_)   { delete[] item_index_;   item_index_   = nullptr; }
+    delete_huge(item_set_);
+    if (item_norms_ != nullptr) { delete[] item_norms_; item_norms_ = nullptr; }
+    if (item_index_ != nullptr) { delete[] item_index_; item_index_ = nullptr; }
     
-    if (!user_norms_)   { delete[] user_norms_;   user_norms_   = nullptr; }
+    if (user_norms_ != nullptr) { delete[] user_norms_; user_norms_ = nullptr; }
 }
 
 // -----------------------------------------------------------------------------
@@ -174,42 +180,54 @@ void H2_ALSH::reverse_kmips(        // reverse k-mips
     const float *query,                 // query vector
     std::vector<int> &result)           // reverse k-mips result (return)
 {
-    gettimeofday(&g_start_time, nullptr);
+    Perf_Scope perf(PHASE_USER_SCAN);
+    
+    double start_time = get_time();
+    stats_.ip_count_ = 0UL;
+    stats_.prune_.reset();
     std::vector<int>().swap(result);// clear space for result
     
     // compute l2-norm for query
     float query_norm = sqrt(calc_inner_product(d_, query, query)); 
-    ++g_ip_count;
+    ++stats_.ip_count_;
     
     // check each user in user_set
     float item_k_norm = item_norms_[k-1]; // k-th largest item norm
     MaxK_Array *arr = new MaxK_Array(k);
+    std::vector<int>   pend;        // users left to k-mips
+    std::vector<float> pend_ip;     // inner products of users of pend
     
     for (int i = 0; i < m_; ++i) {
         // get user vector and its l2-norm
         const float *user = user_set_ + (u64) i*d_;
         float user_norm = user_norms_[i];
         
-        float ip = calc_inner_product(d_, query, user); ++g_ip_count;
+        float ip = calc_inner_product(d_, query, user); ++stats_.ip_count_;
         float ub = user_norm * item_k_norm;
         if (ip >= ub) { 
             // add user id into the result of this query
             result.push_back(i); // Yes
+            ++stats_.prune_[STAGE_USER_LEMMA2];
         }
-        else {
-            // perform mips by h2-alsh
-            arr->reset();
-            if (kmips(k, ip, user_norm, user, arr) == 1) {
-                result.push_back(i); // Yes
-            }
+        else { pend.push_back(i); pend_ip.push_back(ip); }
+    }
+    
+    // perform mips by h2-alsh for the users left as a batch, so that the 
+    // phase of k-mips is switched once per query
+    Perf_Scope kmips_perf(PHASE_KMIPS);
+    for (int x = 0; x < (int) pend.size(); ++x) {
+        int i = pend[x];
+        ++stats_.prune_[STAGE_USER_KMIPS];
+        arr->reset();
+        if (kmips(k, pend_ip[x], user_norms_[i], user_set_ + (u64) i*d_, 
+            arr) == 1) {
+            result.push_back(i); // Yes
         }
     }
     delete arr;
-    gettimeofday(&g_end_time, nullptr);
+    double end_time = get_time();
     
-    double query_time = g_end_time.tv_sec - g_start_time.tv_sec + 
-        (g_end_time.tv_usec - g_start_time.tv_usec) / 1000000.0;
-    g_run_time += query_time;
+    stats_.time_ = end_time - start_time;
 }
 
 // -----------------------------------------------------------------------------
@@ -228,9 +246,12 @@ int H2_ALSH::kmips(                 // k-mips
     // check item_set with blocks for batch pruning
     for (auto hash : hashs_) {
         // early pruning (NOTE: as kip may NOT be true, 1 is not promising)
+        ++stats_.prune_[STAGE_ITEM_VISIT];
         float M = hash->M_;
         float ub = M * user_norm;
-        if (ub <= uq_ip || ub <= kip) return 1; // Yes 
+        if (ub <= uq_ip || ub <= kip) {
+            ++stats_.prune_[STAGE_ITEM_EARLY]; return 1; // Yes
+        }
         
         // k-mips
         int   n = hash->n_;
@@ -247,6 +268,9 @@ int H2_ALSH::kmips(                 // k-mips
             QALSH *lsh = hash->lsh_;
             float range  = sqrt(2.0f * (M*M - lambda*kip));
             lsh->knns(k, range, h2_user.data(), cand);
+            stats_.ip_count_ += lsh->m_; // hash values of h2-user
+            
+            ++stats_.prune_[STAGE_ITEM_LSH];
             
             // verify the candidates
             for (int id : cand) {
@@ -254,7 +278,7 @@ int H2_ALSH::kmips(                 // k-mips
                 if (norms[id] * user_norm >= kip) {
                     const float *item = items + (u64) id*d_;
                     float ip = calc_inner_product(d_, item, user);
-                    ++g_ip_count;
+                    ++stats_.ip_count_; ++stats_.prune_[STAGE_CANDIDATE];
                     
                     kip = arr->add(ip);
                     if (kip > uq_ip) return 0; // return No
@@ -263,6 +287,7 @@ int H2_ALSH::kmips(                 // k-mips
         }
         else {
             // linear scan
+            ++stats_.prune_[STAGE_ITEM_LINEAR];
             for (int j = 0; j < n; ++j) {
                 // NOTE: since kip may NOT be the true, 1 is not promising
                 ub = norms[j] * user_norm;
@@ -270,7 +295,7 @@ int H2_ALSH::kmips(                 // k-mips
                 
                 const float *item = items + (u64) j*d_;
                 float ip = calc_inner_product(d_, item, user);
-                ++g_ip_count;
+                ++stats_.ip_count_; ++stats_.prune_[STAGE_CANDIDATE];
                 
                 kip = arr->add(ip);
                 if (kip > uq_ip) return 0; // return No
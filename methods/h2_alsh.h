@@ -8,6 +8,7 @@
 
 #include "def.h"
 #include "util.h"
+#include "rkmips.h"
 #include "pri_queue.h"
 #include "block.h"
 
@@ -24,13 +25,14 @@ namespace ip {
 //  Online Query Phase:
 //  for each block in item_set, use qalsh (with h2-trans) for speedup
 // -----------------------------------------------------------------------------
-class H2_ALSH {
+class H2_ALSH : public Reverse_KMIPS {
 public:
     H2_ALSH(                        // constructor
         int   n,                        // item cardinality
         int   m,                        // user cardinality
         int   d,                        // dimensionality
         float b,                        // interval ratio for blocking items
+        int   huge,                     // backing of big arrays (HUGE_*)
         const float *item_set,          // item set
         const float *user_set);         // user set
     
@@ -51,6 +53,7 @@ public:
         u64 ret = 0;
         ret += sizeof(*this);
         ret += (sizeof(int)+sizeof(float))*n_; // item_index_ & item_norms_
+        ret += sizeof(float)*n_*d_; // item_set_
         ret += sizeof(float)*m_;    // user_norms_
         for (auto hash : hashs_) {  // hashs_
             ret += hash->get_estimated_memory();
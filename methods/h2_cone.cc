@@ -11,38 +11,91 @@ H2_CONE::H2_CONE(                   // constructor
     int   k_max,                        // max k value
     int   leaf,                         // leaf size of cone-tree
     float b,                            // interval ratio for blocking items
+    int   huge,                         // backing of big arrays (HUGE_*)
     const float *item_set,              // item set
-    const float *user_set)              // user set
-    : n_(n), m_(m), d_(d), k_max_(k_max), leaf_(leaf), b_(b)
+    const float *user_set,              // user set
+    const Lower_Bounds *lb)             // precomputed lower bounds
+    : Reverse_KMIPS(ALG_H2_CONE, n, m, d, k_max, -1, leaf, b, huge), n_(n), 
+    m_(m), d_(d), k_max_(k_max), leaf_(leaf), b_(b), shared_(nullptr)
 {
-    gettimeofday(&g_start_time, nullptr);
+    timeval start_time, end_time;
+    gettimeofday(&start_time, nullptr);
     
     // 1. compute l2-norms & sort item_set in descending order of l2-norms
     item_index_ = new int[n];
     item_norms_ = new float[n];
-    item_set_   = new float[(u64) n*d];
+    item_set_   = new_huge<float>((u64) n*d, alloc_);
     compute_norm_and_sort(item_set);
     
-    // 2. build blocks (with cone-tree) for user_set for batch pruning
+    // 2. build blocks (with cone-tree) for user_set for batch pruning, and 
+    //    compute the lower bounds & qalsh hash values for the users (with 
+    //    the qalsh functions shared by all item blocks)
     int n0 = k_max*COEFF; // only consider the first n0 elements in item_set
     if (n0 > n) n0 = n;   // keep at most n
+    if (lb != nullptr) {  // use the n0 of the precomputed lower bounds
+        assert(lb->m_ == m && lb->d_ == d && lb->k_max_ == k_max);
+        n0 = lb->n0_;
+    }
     
-    blocking_user_set(n0, user_set);
+    lsh_ = new QALSH(0, d+1, APPRX_RATIO_NNS, alloc_);
+    blocking_user_set(n0, user_set, lb);
     
     // 3. build blocks for the rest item_set (with sa-trans) for batch pruning
     blocking_item_set(n-n0, item_norms_+n0, item_set_+(u64)n0*d);
     
-    // get the pre-processing time and estimated memory
-    gettimeofday(&g_end_time, nullptr);
-    g_pre_time = g_end_time.tv_sec - g_start_time.tv_sec + 
-        (g_end_time.tv_usec - g_start_time.tv_usec) / 1000000.0;
-    g_memory = get_estimated_memory();
+    // get the pre-processing time
+    gettimeofday(&end_time, nullptr);
+    pre_time_ = end_time.tv_sec - start_time.tv_sec + 
+        (end_time.tv_usec - start_time.tv_usec) / 1000000.0;
+}
+
+// -----------------------------------------------------------------------------
+H2_CONE::H2_CONE(                   // constructor (with shared artifacts)
+    int   leaf,                         // leaf size of cone-tree
+    float b,                            // interval ratio for blocking items
+    Shared_Index *shared)               // sorted items & cone-tree of users
+    : Reverse_KMIPS(ALG_H2_CONE, shared->n_, shared->m_, shared->d_, 
+    shared->k_max_, -1, leaf, b, shared->alloc_.mode_), n_(shared->n_), 
+    m_(shared->m_), d_(shared->d_), k_max_(shared->k_max_), leaf_(leaf), 
+    b_(b), shared_(shared)
+{
+    timeval start_time, end_time;
+    gettimeofday(&start_time, nullptr);
+    
+    // 1. use the sorted item_set from the shared artifacts
+    item_index_ = shared->item_index_;
+    item_norms_ = shared->item_norms_;
+    item_set_   = shared->item_set_;
+    
+    // 2. use the shared cone-tree (with the lower bounds of users) as blocks 
+    //    for user_set, and compute the qalsh hash values for the users
+    lsh_ = new QALSH(0, d_+1, APPRX_RATIO_NNS, alloc_);
+    tree_ = shared->get_cone_tree(leaf);
+    blocks_.clear();
+    tree_->traversal(blocks_);
+    for (auto block : blocks_) {
+        int m = block->n_; // number of users
+        assert(block->hash_values_ == nullptr); // the cone-tree is not in use
+        block->hash_values_ = new_huge<float>((u64) m*lsh_->m_, alloc_);
+        lsh_->calc_hash_values(m, block->data_, block->hash_values_);
+    }
+    
+    // 3. build blocks for the rest item_set for batch pruning
+    int n0 = shared->n0_;
+    blocking_item_set(n_-n0, item_norms_+n0, item_set_+(u64)n0*d_);
+    
+    // get the pre-processing time (excluding the shared artifacts)
+    gettimeofday(&end_time, nullptr);
+    pre_time_ = end_time.tv_sec - start_time.tv_sec + 
+        (end_time.tv_usec - start_time.tv_usec) / 1000000.0;
 }
 
 // -----------------------------------------------------------------------------
 void H2_CONE::compute_norm_and_sort(// compute l2-norm and sort (descending)
     const float *item_set)              // item_set
 {
+    Perf_Scope perf(PHASE_NORM_SORT);
+    
     // compute l2-norms for item_set
     Result *ret = new Result[n_];
     for (int i = 0; i < n_; ++i) {
@@ -68,10 +121,13 @@ void H2_CONE::compute_norm_and_sort(// compute l2-norm and sort (descending)
 // -----------------------------------------------------------------------------
 void H2_CONE::blocking_user_set(    // split the user_set into blocks
     int   n0,                           // the first n0 elements in item_set
-    const float *user_set)              // user_set
+    const float *user_set,              // user_set
+    const Lower_Bounds *lb)             // precomputed lower bounds
 {
-    // build a cone-tree for user_set
-    tree_ = new Cone_Tree(m_, d_, leaf_, user_set);
+    // build a cone-tree for user_set, with the lower bounds & hash values 
+    // of users in its arenas
+    tree_ = new Cone_Tree(m_, d_, leaf_, user_set, alloc_,
+        sizeof(float)*(k_max_ + lsh_->m_), sizeof(float)*k_max_);
     
     // traversal the cone-tree to get the blocks (cone-nodes) of user_set 
     blocks_.clear();
@@ -83,16 +139,24 @@ void H2_CONE::blocking_user_set(    // split the user_set into blocks
         const float *user_set = block->data_;
         
         block->k_max_ = k_max_;
-        block->lower_bounds_ = new float[m*k_max_];
-        block->node_lower_bounds_ = new float[k_max_];
+        block->lower_bounds_ = tree_->leaf_arena_->alloc<float>(
+            (u64) m*k_max_);
+        block->node_lower_bounds_ = tree_->arena_->alloc<float>(k_max_);
+        block->hash_values_ = tree_->leaf_arena_->alloc<float>(
+            (u64) m*lsh_->m_);
         
-        // compute lower bounds for the users
-        lower_bounds_computation(m, n0, user_set, block->lower_bounds_);
+        // compute lower bounds & qalsh hash values for the users
+        if (lb != nullptr) { // load the precomputed lower bounds
+            lb->copy(true, m, block->index_, block->lower_bounds_);
+        }
+        else lower_bounds_computation(m, n0, user_set, block->lower_bounds_);
+        lsh_->calc_hash_values(m, user_set, block->hash_values_);
         
         // compute lower bounds for this cone-node
         node_lower_bounds_computation(m, block->lower_bounds_,
             block->node_lower_bounds_);
     }
+    tree_->data_ = nullptr; // user_set is not kept (the leaves have copies)
 }
 
 // -----------------------------------------------------------------------------
@@ -102,6 +166,8 @@ void H2_CONE::lower_bounds_computation(// compute lower bounds for users
     const float *user_set,              // users
     float *lower_bounds)                // lower bounds (return)
 {
+    Perf_Scope perf(PHASE_LOWER_BOUNDS);
+    
     MaxK_Array *arr = new MaxK_Array(k_max_);
     for (int i = 0; i < m; ++i) {
         // get user vector and its l2-norm
@@ -157,6 +223,8 @@ void H2_CONE::blocking_item_set(    // split the rest item_set into blocks
     const float *item_norms,            // item l2-norms
     const float *item_set)              // item set
 {
+    Perf_Scope perf(PHASE_HASHING);
+    
     hashs_.clear();
     
     // split item_set into blocks and build qalsh for each block
@@ -194,8 +262,8 @@ void H2_CONE::add_block_by_items(   // add one block by items
         float M_sqr = M * M;
         float *h2_item = new float[d_+1];
         
-        // build hash tables for qalsh
-        block->lsh_ = new QALSH(n, d_+1, APPRX_RATIO_NNS);
+        // build hash tables for qalsh (with shared lsh functions)
+        block->lsh_ = new QALSH(n, lsh_, alloc_);
         
         QALSH *lsh = block->lsh_;
         int m = lsh->m_;
@@ -228,14 +296,20 @@ H2_CONE::~H2_CONE()                 // destructor
 {
     for (auto hash : hashs_) { delete hash; hash = nullptr; }
     std::vector<Item_Block*>().swap(hashs_);
+    if (lsh_ != nullptr) { delete lsh_; lsh_ = nullptr; }
     
-    if (!item_set_)   { delete[] item_set_;   item_set_   = nullptr; }
-    if (!item_norms_) { delete[] item_norms_; item_norms_ = nullptr; }
-    if (!item_index_) { delete[] item_index_; item_index_ = nullptr; }
-    
+    if (shared_ == nullptr) { // the sorted items & cone-tree are owned
+        delete_huge(item_set_); delete[] item_norms_; delete[] item_index_;
+        if (tree_ != nullptr) delete tree_;
+    }
+    else { // release the qalsh hash values of users from the shared cone-tree
+        for (auto block : blocks_) {
+            delete_huge(block->hash_values_);
+        }
+    }
+    item_set_ = nullptr; item_norms_ = nullptr; item_index_ = nullptr;
+    tree_ = nullptr; shared_ = nullptr;
     std::vector<Cone_Node*>().swap(blocks_);
-    
-    if (tree_ != nullptr) { delete tree_; tree_ = nullptr; }
 }
 
 // -------------------------------------------------------------------------
@@ -263,36 +337,45 @@ void H2_CONE::reverse_kmips(        // reverse k-mips
     const float *query,                 // query vector
     std::vector<int> &result)           // reverse k-mips result (return)
 {
-    gettimeofday(&g_start_time, nullptr);
+    Perf_Scope perf(PHASE_USER_SCAN);
+    
+    double start_time = get_time();
+    stats_.ip_count_ = 0UL;
+    stats_.prune_.reset();
     std::vector<int>().swap(result);// clear space for result
     assert(k > 0 && k <= k_max_);   // validate the range of k
     
     // compute l2-norm for query
     float query_norm = sqrt(calc_inner_product(d_, query, query)); 
-    ++g_ip_count;
+    ++stats_.ip_count_;
     
     // check user_set
     float item_k_norm = item_norms_[k-1]; // k-th largest item norm
     MaxK_Array *arr = new MaxK_Array(k);
+    std::vector<int>   pend;        // users of a block left to k-mips
+    std::vector<float> pend_ip;     // inner products of users of pend
     
     for (auto block : blocks_) {
         // lemma 3
         float block_k_lb = block->node_lower_bounds_[k-1];
-        if (query_norm < block_k_lb) continue;
+        if (query_norm < block_k_lb) {
+            ++stats_.prune_[STAGE_BLOCK_LEMMA3]; continue;
+        }
         
         // New Lemma: use node upper bound for batch pruning
-        float ip = calc_inner_product(d_, query, block->center_); ++g_ip_count;
+        float ip = calc_inner_product(d_, query, block->center_); ++stats_.ip_count_;
         float q_cos = ip / block->norm_c_;
         float q_sin = sqrt(SQR(query_norm) - SQR(q_cos));
         
         float ub = block->est_upper_bound(q_cos, q_sin);
-        if (ub < block_k_lb) continue;
+        if (ub < block_k_lb) { ++stats_.prune_[STAGE_BLOCK_CONE]; continue; }
         
         // get user statistics from this block
         int   m = block->n_;
         const int   *user_index   = block->index_;
         const float *user_set     = block->data_;
         const float *lower_bounds = block->lower_bounds_;
+        const float *user_vals    = block->hash_values_;
         
         for (int i = 0; i < m; ++i) {
             // get the lower bound for this user
@@ -301,34 +384,50 @@ void H2_CONE::reverse_kmips(        // reverse k-mips
             
             // 1.1 New Lemma: use point (user) upper bound for pruning
             ub = block->est_upper_bound(i, q_cos, q_sin);
-            if (ub < user_k_lb) continue; // No
+            if (ub < user_k_lb) {
+                ++stats_.prune_[STAGE_USER_CONE]; continue; // No
+            }
             
             // 1.2 use lower_bound for pruning  (lemma 1)
             const float *user = user_set + (u64) i*d_;
-            ip = calc_inner_product(d_, query, user); ++g_ip_count;
-            if (ip < user_k_lb) continue; // No
+            ip = calc_inner_product(d_, query, user); ++stats_.ip_count_;
+            if (ip < user_k_lb) {
+                ++stats_.prune_[STAGE_USER_LEMMA1]; continue; // No
+            }
             
             // 2. use item upper bound for pruning (lemma 2)
             if (ip >= item_k_norm) { 
                 // add user id into the result of this query
                 result.push_back(user_index[i]); // Yes
+                ++stats_.prune_[STAGE_USER_LEMMA2];
             }
-            else {
-                // init the top-k array from the lower bound of this user
-                arr->init(k, lower_bound);
-                arr->add(ip);
-                if (kmips(k, ip, user, arr) == 1) {
-                    result.push_back(user_index[i]); // Yes
-                }
+            else { pend.push_back(i); pend_ip.push_back(ip); }
+        }
+        if (pend.empty()) continue;
+        
+        // 3. verify the users left by k-mips as a batch, so that the phase 
+        //    of k-mips is switched once per block
+        Perf_Scope kmips_perf(PHASE_KMIPS);
+        for (int x = 0; x < (int) pend.size(); ++x) {
+            int i = pend[x];
+            ip = pend_ip[x];
+            
+            // init the top-k array from the lower bound of this user
+            ++stats_.prune_[STAGE_USER_KMIPS];
+            arr->init(k, lower_bounds + (u64) i*k_max_);
+            arr->add(ip);
+            const float *user     = user_set + (u64) i*d_;
+            const float *user_val = user_vals + (u64) i*lsh_->m_;
+            if (kmips(k, ip, user, user_val, arr) == 1) {
+                result.push_back(user_index[i]); // Yes
             }
         }
+        pend.clear(); pend_ip.clear();
     }
     delete arr;
-    gettimeofday(&g_end_time, nullptr);
+    double end_time = get_time();
     
-    double query_time = g_end_time.tv_sec - g_start_time.tv_sec + 
-        (g_end_time.tv_usec - g_start_time.tv_usec) / 1000000.0;
-    g_run_time += query_time;
+    stats_.time_ = end_time - start_time;
 }
 
 // -----------------------------------------------------------------------------
@@ -336,19 +435,22 @@ int H2_CONE::kmips(                 // k-mips
     int   k,                            // top-k value
     float uq_ip,                        // inner product of user and query
     const float *user,                  // input user
+    const float *user_val,              // qalsh hash values of input user
     MaxK_Array  *arr)                   // top-k mips array (return)
 {
     // initialize parameters
-    std::vector<float> h2_user(d_+1, 0.0f);
     std::vector<int> cand;
     float kip = arr->min_key();
     
     // check item_set with blocks for batch pruning
     for (auto hash : hashs_) {
         // early pruning (NOTE: as kip may NOT be true, 1 is not promising)
+        ++stats_.prune_[STAGE_ITEM_VISIT];
         float M = hash->M_;
         float ub = M; // user_norm = 1.0
-        if (ub <= uq_ip || ub <= kip) return 1; // Yes 
+        if (ub <= uq_ip || ub <= kip) {
+            ++stats_.prune_[STAGE_ITEM_EARLY]; return 1; // Yes
+        }
         
         // k-mips
         int   n = hash->n_;
@@ -356,15 +458,14 @@ int H2_CONE::kmips(                 // k-mips
         const float *items = hash->items_;
         
         if (n > N_PTS_INDEX) {
-            // get h2-user
+            // perform knns by qalsh (the hash values of h2-user are the 
+            // pre-computed hash values of user scaled by lambda)
             float lambda = M; // user_norm = 1.0
-            for (int j = 0; j < d_; ++j) h2_user[j] = lambda*user[j];
-            h2_user[d_] = 0.0f;
-            
-            // perform knns by qalsh
             QALSH *lsh = hash->lsh_;
             float range = sqrt(2.0f * (M*M - lambda*kip));
-            lsh->knns(k, range, h2_user.data(), cand);
+            lsh->knns(k, range, lambda, user_val, cand);
+            
+            ++stats_.prune_[STAGE_ITEM_LSH];
             
             // verify the candidates
             for (int id : cand) {
@@ -372,7 +473,7 @@ int H2_CONE::kmips(                 // k-mips
                 if (norms[id] >= kip) { // user_norm = 1.0
                     const float *item = items + (u64) id*d_;
                     float ip = calc_inner_product(d_, item, user);
-                    ++g_ip_count;
+                    ++stats_.ip_count_; ++stats_.prune_[STAGE_CANDIDATE];
                     
                     kip = arr->add(ip);
                     if (kip > uq_ip) return 0; // return No
@@ -381,6 +482,7 @@ int H2_CONE::kmips(                 // k-mips
         }
         else {
             // linear scan
+            ++stats_.prune_[STAGE_ITEM_LINEAR];
             for (int j = 0; j < n; ++j) {
                 // NOTE: since kip may NOT be the true, 1 is not promising
                 ub = norms[j]; // user_norm = 1.0
@@ -388,7 +490,7 @@ int H2_CONE::kmips(                 // k-mips
                 
                 const float *item = items + (u64) j*d_;
                 float ip = calc_inner_product(d_, item, user);
-                ++g_ip_count;
+                ++stats_.ip_count_; ++stats_.prune_[STAGE_CANDIDATE];
                 
                 kip = arr->add(ip);
                 if (kip > uq_ip) return 0; // return No
@@ -8,9 +8,11 @@
 
 #include "def.h"
 #include "util.h"
+#include "rkmips.h"
 #include "pri_queue.h"
 #include "block.h"
 #include "cone_tree.h"
+#include "shared_index.h"
 
 namespace ip {
 
@@ -19,7 +21,8 @@ namespace ip {
 //  
 //  Pre-processing Phase:
 //  1. compute l2-norms & sort item_set in descending order of l2-norms
-//  2. build blocks (with cone-tree) for user_set for batch pruning
+//  2. build blocks (with cone-tree) for user_set for batch pruning, and 
+//     compute qalsh hash values for users (with shared lsh functions)
 //  3. build blocks for the rest item_set (with sa-trans) for batch pruning
 //  
 //  Online Query Phase:
@@ -27,7 +30,7 @@ namespace ip {
 //  2. for each user, check item_set with blocks for batch pruning
 //  3. for each block in item_set, use srp-lsh (with sa-trans) for speedup
 // -----------------------------------------------------------------------------
-class H2_CONE {
+class H2_CONE : public Reverse_KMIPS {
 public:
     H2_CONE(                        // constructor
         int   n,                        // item cardinality
@@ -36,8 +39,16 @@ public:
         int   k_max,                    // max k value
         int   leaf,                     // leaf size of cone-tree
         float b,                        // interval ratio for blocking items
+        int   huge,                     // backing of big arrays (HUGE_*)
         const float *item_set,          // item set
-        const float *user_set);         // user set
+        const float *user_set,          // user set
+        const Lower_Bounds *lb = nullptr); // precomputed lower bounds
+    
+    // -------------------------------------------------------------------------
+    H2_CONE(                        // constructor (with shared artifacts)
+        int   leaf,                     // leaf size of cone-tree
+        float b,                        // interval ratio for blocking items
+        Shared_Index *shared);          // sorted items & cone-tree of users
     
     // -------------------------------------------------------------------------
     ~H2_CONE();                     // destructor
@@ -56,10 +67,13 @@ public:
         u64 ret = 0;
         ret += sizeof(*this);
         ret += (sizeof(int)+sizeof(float))*n_; // item_index_ & item_norms_
+        if (shared_ == nullptr) ret += sizeof(float)*n_*d_; // item_set_
         for (auto hash : hashs_) {  // hashs_
             ret += hash->get_estimated_memory();
         }
         ret += tree_->get_estimated_memory();
+        ret += sizeof(float)*m_*lsh_->m_; // hash_values_ of users in leaves
+        ret += lsh_->get_estimated_memory(); // shared lsh_
         
         return ret;
     }
@@ -77,9 +91,11 @@ protected:
     float *item_norms_;             // sorted item l2-norms
     int   *item_index_;             // sorted item index
     std::vector<Item_Block*> hashs_;// lsh index for item blocks
+    QALSH *lsh_;                    // qalsh functions shared by item blocks
     
     Cone_Tree *tree_;               // cone-tree
     std::vector<Cone_Node*> blocks_;// user blocks
+    Shared_Index *shared_;          // shared artifacts (nullptr: owned)
     
     // -------------------------------------------------------------------------
     void compute_norm_and_sort(     // compute norm and sort data (descending)
@@ -88,7 +104,8 @@ protected:
     // -------------------------------------------------------------------------
     void blocking_user_set(         // build blocks (with cone-tree) for user_set
         int   n0,                       // the first n0 elements in item_set
-        const float *user_set);         // user_set
+        const float *user_set,          // user_set
+        const Lower_Bounds *lb);        // precomputed lower bounds (optional)
         
     // -------------------------------------------------------------------------
     void lower_bounds_computation(  // compute lower bounds for users
@@ -127,6 +144,7 @@ protected:
         int   k,                        // top-k value
         float uq_ip,                    // inner product of user and query
         const float *user,              // input user
+        const float *user_val,          // qalsh hash values of input user
         MaxK_Array  *arr);              // top-k mips array (return)
 };
 
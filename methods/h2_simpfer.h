@@ -8,8 +8,10 @@
 
 #include "def.h"
 #include "util.h"
+#include "rkmips.h"
 #include "pri_queue.h"
 #include "block.h"
+#include "shared_index.h"
 
 namespace ip {
 
@@ -20,15 +22,16 @@ namespace ip {
 //  1. compute l2-norms & sort item_set in descending order of l2-norms
 //  2. compute l2-norms & sort user_set in descending order of l2-norms
 //  3. determine k_max approximate mips results as lower bounds for user_set
-//  4. build blocks for user_set for batch pruning
-//  5. build blocks for the rest item_set (with h2-trans) for batch pruning
+//  4. compute qalsh hash values for user_set (with shared lsh functions)
+//  5. build blocks for user_set for batch pruning
+//  6. build blocks for the rest item_set (with h2-trans) for batch pruning
 //  
 //  Online Query Phase:
 //  1. check user_set with blocks for batch pruning
 //  2. for each user, check item_set with blocks for batch pruning
 //  3. for each block in item_set, use qalsh (with h2-trans) for speedup
 // -----------------------------------------------------------------------------
-class H2_Simpfer {
+class H2_Simpfer : public Reverse_KMIPS {
 public:
     H2_Simpfer(                     // constructor
         int   n,                        // item cardinality
@@ -36,8 +39,15 @@ public:
         int   d,                        // dimensionality
         int   k_max,                    // max k value
         float b,                        // interval ratio for blocking items
+        int   huge,                     // backing of big arrays (HUGE_*)
         const float *item_set,          // item set
-        const float *user_set);         // user set
+        const float *user_set,          // user set
+        const Lower_Bounds *lb = nullptr); // precomputed lower bounds
+    
+    // -------------------------------------------------------------------------
+    H2_Simpfer(                     // constructor (with shared artifacts)
+        float b,                        // interval ratio for blocking items
+        Shared_Index *shared);          // sorted items, users & lower bounds
     
     // -------------------------------------------------------------------------
     ~H2_Simpfer();                  // destructor
@@ -57,7 +67,12 @@ public:
         ret += sizeof(*this);
         ret += (sizeof(int)+sizeof(float))*n_; // item_index_ & item_norms_
         ret += (sizeof(int)+sizeof(float))*m_; // user_index_ & user_norms_
+        if (shared_ == nullptr) {       // item_set_ & user_set_
+            ret += sizeof(float)*(n_+m_)*d_;
+        }
         ret += sizeof(float)*m_*k_max_; // lower_bounds_
+        ret += sizeof(float)*m_*lsh_->m_; // user_vals_
+        ret += lsh_->get_estimated_memory(); // shared lsh_
         for (auto hash : hashs_) {      // hashs_
             ret += hash->get_estimated_memory();
         }
@@ -78,14 +93,21 @@ protected:
     float *item_norms_;             // sorted item l2-norms
     int   *item_index_;             // sorted item index
     std::vector<Item_Block*> hashs_;// lsh index for item blocks
+    QALSH *lsh_;                    // qalsh functions shared by item blocks
     
     float *user_set_;               // sorted user vectors
     float *user_norms_;             // sorted user l2-norms
     int   *user_index_;             // sorted user index
     float *lower_bounds_;           // lower bounds for sorted user vectors
+    float *user_vals_;              // qalsh hash values for sorted user vectors
     
     int   block_size_;              // block size of users
     std::vector<User_Block*> blocks_;// user blocks
+    Shared_Index *shared_;          // shared artifacts (nullptr: owned)
+    
+    // -------------------------------------------------------------------------
+    void build_blocks(              // build user blocks & item blocks
+        int n0);                        // the first n0 elements in item_set
     
     // -------------------------------------------------------------------------
     void compute_norm_and_sort(     // compute norm and sort data (descending)
@@ -127,6 +149,7 @@ protected:
         float uq_ip,                    // inner product of user and query
         float user_norm,                // l2-norm of input user
         const float *user,              // input user
+        const float *user_val,          // qalsh hash values of input user
         MaxK_Array  *arr);              // top-k mips array (return)
 };
 
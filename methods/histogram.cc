@@ -0,0 +1,70 @@
+#include "histogram.h"
+
+namespace ip {
+
+// -----------------------------------------------------------------------------
+Histogram::Histogram()              // constructor
+    : counts_((64 - HIST_SUB_BITS + 1) * HIST_SUB, 0UL), count_(0UL),
+    max_(0UL)
+{
+}
+
+// -----------------------------------------------------------------------------
+void Histogram::reset()             // remove all values
+{
+    std::fill(counts_.begin(), counts_.end(), 0UL);
+    count_ = 0UL; max_ = 0UL;
+}
+
+// -----------------------------------------------------------------------------
+int Histogram::get_bucket(          // get the bucket of a value
+    u64   value)                        // value
+{
+    if (value < (u64) HIST_SUB) return (int) value;
+    
+    // value in [2^(b+shift), 2^(b+shift+1)) (b = HIST_SUB_BITS) has the
+    // sub-bucket (value >> shift) in [HIST_SUB, 2*HIST_SUB)
+    int shift = 63 - __builtin_clzll(value) - HIST_SUB_BITS;
+    return shift * HIST_SUB + (int) (value >> shift);
+}
+
+// -----------------------------------------------------------------------------
+u64 Histogram::get_upper(           // get the largest value of a bucket
+    int   bucket)                       // bucket
+{
+    if (bucket < 2 * HIST_SUB) return (u64) bucket;
+    
+    int shift = bucket / HIST_SUB - 1;
+    u64 lower = (u64) (bucket - shift * HIST_SUB) << shift;
+    return lower + ((1UL << shift) - 1);
+}
+
+// -----------------------------------------------------------------------------
+void Histogram::add(                // add a value
+    u64   value)                        // value
+{
+    ++counts_[get_bucket(value)];
+    ++count_;
+    if (value > max_) max_ = value;
+}
+
+// -----------------------------------------------------------------------------
+u64 Histogram::percentile(          // get a percentile (0: empty)
+    double p) const                     // percentile in [0, 100] (100: max)
+{
+    if (count_ == 0UL) return 0UL;
+    if (p >= 100.0) return max_;
+    
+    // the smallest value such that p% of the values are not larger than it
+    u64 rank = (u64) ceil(p / 100.0 * count_);
+    if (rank < 1UL) rank = 1UL;
+    
+    u64 cnt = 0UL;
+    for (int i = 0; i < (int) counts_.size(); ++i) {
+        cnt += counts_[i];
+        if (cnt >= rank) return std::min(get_upper(i), max_);
+    }
+    return max_;
+}
+
+} // end namespace ip
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "def.h"
+
+namespace ip {
+
+// -----------------------------------------------------------------------------
+//  Histogram: an HDR-style histogram of u64 values (e.g., the latency in ns
+//  and the # ip computations of queries)
+//
+//  The values below 2*HIST_SUB are recorded exactly, and the larger values
+//  fall into HIST_SUB (linear) buckets for each power of two, so a percentile
+//  is within a relative error of 1/HIST_SUB from the recorded value, using a
+//  fixed space of (64-HIST_SUB_BITS+1)*HIST_SUB counters
+// -----------------------------------------------------------------------------
+class Histogram {
+public:
+    // -------------------------------------------------------------------------
+    Histogram();                    // constructor
+    
+    // -------------------------------------------------------------------------
+    void reset();                   // remove all values
+    
+    // -------------------------------------------------------------------------
+    void add(                       // add a value
+        u64   value);                   // value
+    
+    // -------------------------------------------------------------------------
+    u64 percentile(                 // get a percentile (0: empty)
+        double p) const;                // percentile in [0, 100] (100: max)
+    
+    // -------------------------------------------------------------------------
+    u64 count() const { return count_; } // # values
+    
+    // -------------------------------------------------------------------------
+    u64 max() const { return max_; } // max value
+
+protected:
+    std::vector<u64> counts_;       // # values of each bucket
+    u64   count_;                   // # values
+    u64   max_;                     // max value
+    
+    // -------------------------------------------------------------------------
+    static int get_bucket(          // get the bucket of a value
+        u64   value);                   // value
+    
+    // -------------------------------------------------------------------------
+    static u64 get_upper(           // get the largest value of a bucket
+        int   bucket);                  // bucket
+};
+
+} // end namespace ip
@@ -0,0 +1,160 @@
+#include "huge_page.h"
+
+#include <mutex>
+#include <sys/mman.h>
+
+namespace ip {
+
+const char *HUGE_MODE_NAMES[NUM_HUGE_MODES] = { "off", "thp", "hugetlb" };
+
+// -----------------------------------------------------------------------------
+//  Huge_Map: the header before an array of huge_alloc(), which is also kept
+//  in g_huge_maps (for the mappings) to report their huge pages
+// -----------------------------------------------------------------------------
+struct Huge_Map {
+    char  *base_;                   // base of mapping (nullptr: by new[])
+    u64   size_;                    // bytes of mapping
+    int   mode_;                    // backing obtained (HUGE_*)
+    std::atomic<u64> *account_;     // account of bytes (nullptr: none)
+};
+
+static std::mutex g_huge_mutex;     // mutex of g_huge_maps
+static std::vector<Huge_Map> g_huge_maps; // live mappings
+
+// -----------------------------------------------------------------------------
+static char* map_aligned(           // map bytes aligned to huge pages
+    u64   size)                         // number of bytes (multiple of pages)
+{
+    // map a huge page more and unmap the head and tail around the aligned
+    // range, so that every huge page of the range can be backed by the thp
+    u64 len = size + HUGE_PAGE_SIZE;
+    void *ptr = mmap(nullptr, len, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED) return nullptr;
+    
+    u64 raw   = (u64) ptr;
+    u64 start = (raw + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+    if (start > raw) munmap(ptr, start - raw);
+    if (raw + len > start + size) {
+        munmap((void*) (start + size), raw + len - start - size);
+    }
+    return (char*) start;
+}
+
+// -----------------------------------------------------------------------------
+void* huge_alloc(                   // allocate an array (uninitialized)
+    u64   size,                         // number of bytes
+    const Huge_Alloc &alloc)            // backing & account of array
+{
+    int mode  = alloc.mode_;
+    u64 total = size + HUGE_HEADER;
+    Huge_Map map = { nullptr, 0UL, HUGE_OFF, alloc.account_ };
+    
+    if (mode != HUGE_OFF && total >= HUGE_PAGE_SIZE) {
+        map.size_ = (total + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+        if (mode == HUGE_TLB) {
+            void *ptr = mmap(nullptr, map.size_, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (ptr != MAP_FAILED) {
+                map.base_ = (char*) ptr; map.mode_ = HUGE_TLB;
+            }
+        }
+        if (map.base_ == nullptr) {
+            // the advice fails if the thp is disabled, where the mapping is
+            // still usable (by base pages), as reported by get_huge_memory()
+            map.base_ = map_aligned(map.size_);
+            if (map.base_ != nullptr) {
+                madvise(map.base_, map.size_, MADV_HUGEPAGE);
+                map.mode_ = HUGE_THP;
+            }
+        }
+    }
+    if (map.base_ == nullptr) { // base pages
+        map.size_ = total;
+        map.mode_ = HUGE_OFF;
+    }
+    g_heap_bytes.fetch_add(map.size_, std::memory_order_relaxed);
+    g_thread_heap += (int64_t) map.size_;
+    if (map.account_ != nullptr) map.account_->fetch_add(map.size_);
+    
+    if (map.base_ == nullptr) {
+        char *ptr = new char[total];
+        memcpy(ptr, &map, sizeof(map));
+        return (void*) (ptr + HUGE_HEADER);
+    }
+    {
+        std::lock_guard<std::mutex> lock(g_huge_mutex);
+        g_huge_maps.push_back(map);
+    }
+    memcpy(map.base_, &map, sizeof(map));
+    return (void*) (map.base_ + HUGE_HEADER);
+}
+
+// -----------------------------------------------------------------------------
+void huge_free(                     // free an array of huge_alloc()
+    void  *ptr)                         // array (nullptr: none)
+{
+    if (ptr == nullptr) return;
+    
+    Huge_Map map;
+    char *header = (char*) ptr - HUGE_HEADER;
+    memcpy(&map, header, sizeof(map));
+    g_heap_bytes.fetch_sub(map.size_, std::memory_order_relaxed);
+    g_thread_heap -= (int64_t) map.size_;
+    if (map.account_ != nullptr) map.account_->fetch_sub(map.size_);
+    if (map.base_ == nullptr) { delete[] header; return; }
+    
+    {
+        std::lock_guard<std::mutex> lock(g_huge_mutex);
+        for (size_t i = 0; i < g_huge_maps.size(); ++i) {
+            if (g_huge_maps[i].base_ != map.base_) continue;
+            g_huge_maps[i] = g_huge_maps.back();
+            g_huge_maps.pop_back();
+            break;
+        }
+    }
+    munmap(map.base_, map.size_);
+}
+
+// -----------------------------------------------------------------------------
+void get_huge_memory(               // get the huge pages of live arrays
+    u64   &mapped,                      // bytes mapped for huge pages (return)
+    u64   &backed)                      // bytes backed by huge pages (return)
+{
+    std::vector<Huge_Map> maps;
+    {
+        std::lock_guard<std::mutex> lock(g_huge_mutex);
+        maps = g_huge_maps;
+    }
+    mapped = 0UL; backed = 0UL;
+    for (auto &map : maps) {
+        mapped += map.size_;
+        if (map.mode_ == HUGE_TLB) backed += map.size_; // reserved by mmap
+    }
+    if (maps.empty()) return;
+    
+    // the thp backing of a mapping is the AnonHugePages of the vmas over it
+    // (a vma may merge adjacent mappings of the same advice)
+    FILE *fp = fopen("/proc/self/smaps", "r");
+    if (!fp) return;
+    
+    char line[512];
+    bool over = false;
+    while (fgets(line, sizeof(line), fp)) {
+        unsigned long start = 0UL, end = 0UL, kb = 0UL;
+        if (sscanf(line, "%lx-%lx ", &start, &end) == 2) {
+            over = false;
+            for (auto &map : maps) {
+                u64 base = (u64) map.base_;
+                if (map.mode_ == HUGE_THP && base < end &&
+                    base + map.size_ > start) { over = true; break; }
+            }
+        }
+        else if (over && sscanf(line, "AnonHugePages: %lu kB", &kb) == 1) {
+            backed += (u64) kb * 1024UL;
+        }
+    }
+    fclose(fp);
+}
+
+} // end namespace ip
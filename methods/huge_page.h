@@ -0,0 +1,89 @@
+#pragma once
+
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#include "def.h"
+#include "perf.h"
+
+namespace ip {
+
+// -----------------------------------------------------------------------------
+//  the backing of big arrays (-hp of rmips)
+// -----------------------------------------------------------------------------
+enum Huge_Mode {
+    HUGE_OFF = 0,                   // base pages (by new[])
+    HUGE_THP,                       // transparent huge pages (by madvise)
+    HUGE_TLB,                       // hugetlbfs pages (else as HUGE_THP)
+    NUM_HUGE_MODES                  // # modes
+};
+
+const u64 HUGE_PAGE_SIZE = 2097152UL; // size of a huge page (2 MB)
+const u64 HUGE_HEADER    = 64UL;      // bytes of the header of an array
+
+extern const char *HUGE_MODE_NAMES[NUM_HUGE_MODES]; // names of modes
+
+// -----------------------------------------------------------------------------
+//  Huge_Alloc: the backing and the account of the big arrays of an index, 
+//  which the index passes to its parts (lsh tables, cone-trees, and arenas)
+// -----------------------------------------------------------------------------
+struct Huge_Alloc {
+    int   mode_;                    // backing of arrays (HUGE_*)
+    std::atomic<u64> *account_;     // account of bytes (nullptr: none)
+};
+
+// -----------------------------------------------------------------------------
+//  huge_alloc() allocates a big array (item_set_, user_set_, lower_bounds_,
+//  k_bounds_, hash_keys_, tables_, the hash values of users, and the chunks
+//  of leaf arenas) backed by huge pages if asked.
+//  An array of HUGE_TLB is mapped from the hugetlbfs pool; if the pool is
+//  short, it falls back to HUGE_THP, i.e., a mapping aligned to huge pages
+//  and advised by MADV_HUGEPAGE, which the kernel backs by huge pages on
+//  first touch if it can. An array smaller than a huge page (or of HUGE_OFF,
+//  or if mmap fails) is allocated by new[], so huge_alloc() never fails for
+//  the lack of huge pages
+//
+//  An array is released by huge_free() (never by delete[]), which finds its
+//  backing from the header before the array
+//
+//  The bytes taken by an array (its mapping, or its new[] with the header)
+//  are added to the account of its Huge_Alloc when it is allocated, and 
+//  subtracted from the same account when it is freed, so that an index 
+//  (whose allocator has its own account) measures the bytes of its own 
+//  arrays and arenas, whatever else the process allocates or frees meanwhile.
+//  They are also added to g_heap_bytes and g_thread_heap, which give the 
+//  heap of each build phase (see Perf_Counters)
+// -----------------------------------------------------------------------------
+void* huge_alloc(                   // allocate an array (uninitialized)
+    u64   size,                         // number of bytes
+    const Huge_Alloc &alloc);           // backing & account of array
+
+// -----------------------------------------------------------------------------
+void huge_free(                     // free an array of huge_alloc()
+    void  *ptr);                        // array (nullptr: none)
+
+// -----------------------------------------------------------------------------
+template<class T>
+T* new_huge(                        // allocate an array of elements
+    u64   n,                            // number of elements
+    const Huge_Alloc &alloc)            // backing & account of array
+{
+    return (T*) huge_alloc(sizeof(T)*n, alloc);
+}
+
+// -----------------------------------------------------------------------------
+template<class T>
+void delete_huge(                   // free an array of new_huge()
+    T     *&ptr)                        // array (return nullptr)
+{
+    huge_free((void*) ptr); ptr = nullptr;
+}
+
+// -----------------------------------------------------------------------------
+void get_huge_memory(               // get the huge pages of live arrays
+    u64   &mapped,                      // bytes mapped for huge pages (return)
+    u64   &backed);                     // bytes backed by huge pages (return)
+
+} // end namespace ip
@@ -0,0 +1,128 @@
+#include "leaf_file.h"
+
+namespace ip {
+
+// -----------------------------------------------------------------------------
+Leaf_File::Leaf_File(               // constructor
+    const char *fname)                  // address of leaf file
+    : file_size_(0UL), read_bytes_(0UL), max_size_(0UL), error_(0), 
+    stop_(false), num_(0), next_(0), left_(0), failed_(0), ids_(nullptr), 
+    buffer_(nullptr), leaves_(nullptr)
+{
+    strncpy(fname_, fname, sizeof(fname_)-1); fname_[sizeof(fname_)-1] = '\0';
+    
+    fd_ = open(fname_, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd_ < 0) { printf("Could not create %s\n", fname_); error_ = 1; }
+    
+    for (int i = 0; i < IO_THREAD_NUM; ++i) {
+        workers_.emplace_back(&Leaf_File::worker, this);
+    }
+}
+
+// -----------------------------------------------------------------------------
+Leaf_File::~Leaf_File()             // destructor
+{
+    wait();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    work_cv_.notify_all();
+    for (auto &worker : workers_) worker.join();
+    std::vector<std::thread>().swap(workers_);
+    
+    if (fd_ >= 0) { close(fd_); fd_ = -1; unlink(fname_); }
+    
+    std::vector<u64>().swap(offsets_);
+    std::vector<u64>().swap(sizes_);
+}
+
+// -----------------------------------------------------------------------------
+int Leaf_File::write(               // write a leaf to the end (-1: fail)
+    int   num,                          // number of segments
+    const void **segments,              // segments of this leaf
+    const u64   *sizes)                 // size of segments (bytes)
+{
+    // each leaf starts at a LEAF_ALIGN-aligned offset
+    u64 start = (file_size_ + LEAF_ALIGN - 1) / LEAF_ALIGN * LEAF_ALIGN;
+    u64 offset = start;
+    for (int i = 0; i < num; ++i) {
+        const char *data = (const char*) segments[i];
+        u64 size = sizes[i], done = 0UL;
+        while (error_ == 0 && done < size) {
+            ssize_t ret = pwrite(fd_, data+done, size-done, offset+done);
+            if (ret <= 0) {
+                printf("Could not write %s\n", fname_); error_ = 1; break;
+            }
+            done += ret;
+        }
+        offset += size;
+    }
+    offsets_.push_back(start);
+    sizes_.push_back(offset - start);
+    
+    // keep the leaves in a batch buffer 64-byte aligned
+    file_size_ = offset;
+    max_size_  = std::max(max_size_, (offset - start + 63) / 64 * 64);
+    
+    return error_ != 0 ? -1 : (int) offsets_.size() - 1;
+}
+
+// -----------------------------------------------------------------------------
+void Leaf_File::read_async(         // start a batch read (kept till wait())
+    int   num,                          // number of leaves
+    const int *ids,                     // leaf ids
+    char  *buffer,                      // buffer (num*max_size_ bytes)
+    char  **leaves)                     // start address of leaves (return)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        assert(left_ == 0); // one batch at a time
+        failed_ = error_;   // a broken file fails the batch without reads
+        if (failed_ != 0) return;
+        
+        num_ = num; next_ = 0; left_ = num;
+        ids_ = ids; buffer_ = buffer; leaves_ = leaves;
+    }
+    work_cv_.notify_all();
+}
+
+// -----------------------------------------------------------------------------
+int Leaf_File::wait()               // wait for the batch read (0: success)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_cv_.wait(lock, [this]() { return left_ == 0; });
+    return failed_;
+}
+
+// -----------------------------------------------------------------------------
+void Leaf_File::worker()            // read the leaves of batches (by a thread)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        work_cv_.wait(lock, [this]() { return stop_ || next_ < num_; });
+        if (stop_) return;
+        
+        // take the next leaf of the batch, and read it without the lock
+        int  i    = next_++;
+        int  id   = ids_[i];
+        u64  size = sizes_[id], done = 0UL;
+        char *leaf = buffer_ + (u64) i*max_size_;
+        lock.unlock();
+        
+        bool failed = false;
+        while (done < size) {
+            ssize_t ret = pread(fd_, leaf+done, size-done, offsets_[id]+done);
+            if (ret <= 0) { failed = true; break; }
+            done += ret;
+        }
+        
+        lock.lock();
+        if (failed) failed_ = 1; // the rest of the batch is still read
+        leaves_[i] = leaf;
+        read_bytes_ += size;
+        if (--left_ == 0) done_cv_.notify_all();
+    }
+}
+
+} // end namespace ip
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <iostream>
+#include <algorithm>
+#include <cassert>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "def.h"
+#include "util.h"
+
+namespace ip {
+
+// -----------------------------------------------------------------------------
+//  Leaf_File: a leaf-aligned file to keep the payloads of cone-tree leaves on
+//  disk, where each leaf is stored as a set of contiguous segments starting
+//  at a LEAF_ALIGN-aligned offset, and a batch of leaves is loaded by a pool
+//  of threads with pread
+//
+//  The pool (IO_THREAD_NUM threads) lives as long as the file and sleeps
+//  between batches, so a batch read only wakes it up rather than creating 
+//  threads; one batch is read at a time, which may run in the background 
+//  (read_async() & wait()) while the caller checks the previous batch
+//
+//  A failure of i/o does not stop the process: a failure to create or write
+//  the file is kept in error_ and fails every batch read, and a failure of 
+//  pread fails its batch, which wait() (or read()) returns, so that the 
+//  caller fails the query of the batch only
+// -----------------------------------------------------------------------------
+class Leaf_File {
+public:
+    u64   file_size_;               // file size (bytes)
+    u64   read_bytes_;              // # bytes loaded by batch reads
+    u64   max_size_;                // max leaf size (bytes, 64-byte aligned)
+    int   error_;                   // failed to create or write (0: no)
+    
+    // -------------------------------------------------------------------------
+    Leaf_File(                      // constructor
+        const char *fname);             // address of leaf file
+    
+    // -------------------------------------------------------------------------
+    ~Leaf_File();                   // destructor (remove the leaf file)
+    
+    // -------------------------------------------------------------------------
+    int write(                      // write a leaf to the end (-1: fail)
+        int   num,                      // number of segments
+        const void **segments,          // segments of this leaf
+        const u64   *sizes);            // size of segments (bytes)
+    
+    // -------------------------------------------------------------------------
+    int read(                       // batch read leaves from disk (0: success)
+        int   num,                      // number of leaves
+        const int *ids,                 // leaf ids
+        char  *buffer,                  // buffer (num*max_size_ bytes)
+        char  **leaves) {               // start address of leaves (return)
+        read_async(num, ids, buffer, leaves); return wait();
+    }
+    
+    // -------------------------------------------------------------------------
+    void read_async(                // start a batch read (kept till wait())
+        int   num,                      // number of leaves
+        const int *ids,                 // leaf ids
+        char  *buffer,                  // buffer (num*max_size_ bytes)
+        char  **leaves);                // start address of leaves (return)
+    
+    // -------------------------------------------------------------------------
+    int wait();                     // wait for the batch read (0: success)
+    
+    // -------------------------------------------------------------------------
+    u64 get_estimated_memory() {    // get memory usage
+        u64 ret = 0UL;
+        ret += sizeof(*this);
+        ret += sizeof(u64)*offsets_.capacity()*2; // offsets_ & sizes_
+        
+        return ret;
+    }
+
+protected:
+    int   fd_;                      // file descriptor
+    char  fname_[200];              // address of leaf file
+    std::vector<u64> offsets_;      // start offset of leaves
+    std::vector<u64> sizes_;        // size of leaves (bytes)
+    
+    std::vector<std::thread> workers_; // pool of threads of batch reads
+    std::mutex mutex_;              // mutex of the batch & stop_
+    std::condition_variable work_cv_; // signal of a batch (or stop_)
+    std::condition_variable done_cv_; // signal of the end of a batch
+    bool  stop_;                    // stop the pool
+    int   num_;                     // number of leaves of the batch
+    int   next_;                    // next leaf of the batch to read
+    int   left_;                    // number of leaves of the batch unread
+    int   failed_;                  // the batch failed to read (0: no)
+    const int *ids_;                // leaf ids of the batch
+    char  *buffer_;                 // buffer of the batch
+    char  **leaves_;                // start address of leaves of the batch
+    
+    // -------------------------------------------------------------------------
+    void worker();                  // read the leaves of batches (by a thread)
+};
+
+} // end namespace ip
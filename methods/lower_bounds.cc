@@ -0,0 +1,195 @@
+#include "lower_bounds.h"
+
+namespace ip {
+
+// -----------------------------------------------------------------------------
+void calc_lower_bounds(             // compute lower bounds for users (parallel)
+    int   m,                            // number of users
+    int   n0,                           // the first n0 elements in item_set
+    int   d,                            // dimensionality
+    int   k_max,                        // max k value
+    const float *item_norms,            // sorted item l2-norms
+    const float *item_set,              // sorted item vectors
+    const float *user_norms,            // l2-norms of users (nullptr: unit)
+    const float *user_set,              // users
+    float *lower_bounds)                // lower bounds (return)
+{
+    // the users are independent, so each thread keeps its own top-k array
+    #pragma omp parallel num_threads(get_num_threads())
+    {
+        Perf_Scope perf(PHASE_LOWER_BOUNDS); // each thread counts itself
+        MaxK_Array *arr = new MaxK_Array(k_max);
+        
+        #pragma omp for schedule(dynamic, 64)
+        for (int i = 0; i < m; ++i) {
+            // get user vector and its l2-norm
+            const float *user = user_set + (u64) i*d;
+            float user_norm = user_norms != nullptr ? user_norms[i] : 1.0f;
+            
+            // find k-mips for this user over the first n0 items
+            float tau = MINREAL; // k-th maximum ip value
+            arr->reset();
+            for (int j = 0; j < n0; ++j) {
+                // leverage the descending order of item norms for pruning
+                float upper_bound = user_norm*item_norms[j];
+                if (tau > upper_bound) break;
+                
+                const float *item = item_set + (u64) j*d;
+                float ip = calc_inner_product(d, user, item);
+                tau = arr->add(ip);
+            }
+            float *lower_bound = lower_bounds + (u64) i*k_max;
+            std::copy(arr->keys_, arr->keys_+k_max, lower_bound);
+        }
+        delete arr;
+    }
+}
+
+// -----------------------------------------------------------------------------
+Lower_Bounds::Lower_Bounds()        // constructor
+    : m_(0), d_(0), k_max_(0), n0_(0), coeff_(0), hash_(0UL), raw_(nullptr),
+    norm_(nullptr)
+{
+}
+
+// -----------------------------------------------------------------------------
+Lower_Bounds::~Lower_Bounds()       // destructor
+{
+    delete[] raw_;  raw_  = nullptr;
+    delete[] norm_; norm_ = nullptr;
+}
+
+// -----------------------------------------------------------------------------
+void Lower_Bounds::build(           // compute the lower bounds (parallel)
+    int   n,                            // item cardinality
+    int   m,                            // user cardinality
+    int   d,                            // dimensionality
+    int   k_max,                        // max k value
+    int   coeff,                        // n0 = min(k_max*coeff, n)
+    u64   hash,                         // hash of item_set and user_set
+    const float *item_set,              // item set
+    const float *user_set)              // user set
+{
+    Perf_Scope perf(PHASE_LOWER_BOUNDS);
+    
+    m_ = m; d_ = d; k_max_ = k_max; coeff_ = coeff; hash_ = hash;
+    n0_ = k_max*coeff; if (n0_ > n) n0_ = n;
+    
+    // sort the first n0 items in descending order of l2-norms
+    Result *ret = new Result[n];
+    for (int i = 0; i < n; ++i) {
+        const float *item = item_set + (u64) i*d;
+        ret[i].id_  = i;
+        ret[i].key_ = sqrt(calc_inner_product(d, item, item));
+    }
+    qsort(ret, n, sizeof(Result), ResultCompDesc);
+    
+    float *item_norms = new float[n0_];
+    float *items = new float[(u64) n0_*d];
+    for (int i = 0; i < n0_; ++i) {
+        const float *item = item_set + (u64) ret[i].id_*d;
+        item_norms[i] = ret[i].key_;
+        std::copy(item, item+d, items + (u64) i*d);
+    }
+    delete[] ret;
+    
+    // compute the l2-norms and the normalized vectors of users
+    float *user_norms = new float[m];
+    float *norm_users = new float[(u64) m*d];
+    normalize_data(m, d, user_set, user_norms, norm_users);
+    
+    // compute the lower bounds of users and normalized users
+    delete[] raw_;  raw_  = new float[(u64) m*k_max];
+    delete[] norm_; norm_ = new float[(u64) m*k_max];
+    calc_lower_bounds(m, n0_, d, k_max, item_norms, items, user_norms, 
+        user_set, raw_);
+    calc_lower_bounds(m, n0_, d, k_max, item_norms, items, nullptr, 
+        norm_users, norm_);
+    
+    delete[] item_norms;
+    delete[] items;
+    delete[] user_norms;
+    delete[] norm_users;
+}
+
+// -----------------------------------------------------------------------------
+int Lower_Bounds::save(             // save the lower bounds to disk
+    const char *fname)                  // address of lower bounds
+{
+    FILE *fp = fopen(fname, "wb");
+    if (!fp) { printf("Could not create %s\n", fname); return 1; }
+    
+    u32 header[6] = { LB_MAGIC, (u32) m_, (u32) d_, (u32) k_max_, (u32) n0_, 
+        (u32) coeff_ };
+    u64 size = (u64) m_*k_max_;
+    fwrite(header, sizeof(u32), 6, fp);
+    fwrite(&hash_, sizeof(u64), 1, fp);
+    fwrite(raw_,  sizeof(float), size, fp);
+    fwrite(norm_, sizeof(float), size, fp);
+    fclose(fp);
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+int Lower_Bounds::load(             // load the lower bounds from disk
+    int   m,                            // user cardinality
+    int   d,                            // dimensionality
+    int   k_max,                        // max k value
+    u64   hash,                         // hash of item_set and user_set
+    const char *fname)                  // address of lower bounds
+{
+    FILE *fp = fopen(fname, "rb");
+    if (!fp) { printf("Could not open %s\n", fname); return 1; }
+    
+    // check the header for the key of (dataset, k_max)
+    u32 header[6]; u64 key = 0UL;
+    if (fread(header, sizeof(u32), 6, fp) != 6 || 
+        fread(&key, sizeof(u64), 1, fp) != 1 || header[0] != LB_MAGIC || 
+        (int) header[1] != m || (int) header[2] != d || 
+        (int) header[3] != k_max || key != hash) {
+        printf("Lower bounds %s do not match the dataset\n", fname);
+        fclose(fp); return 1;
+    }
+    m_ = m; d_ = d; k_max_ = k_max; n0_ = header[4]; coeff_ = header[5]; 
+    hash_ = hash;
+    
+    // read the lower bounds of users and normalized users
+    u64 size = (u64) m*k_max;
+    delete[] raw_;  raw_  = new float[size];
+    delete[] norm_; norm_ = new float[size];
+    if (fread(raw_, sizeof(float), size, fp) != size || 
+        fread(norm_, sizeof(float), size, fp) != size) {
+        printf("Could not read %s\n", fname);
+        fclose(fp); return 1;
+    }
+    fclose(fp);
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+void Lower_Bounds::copy(            // copy the lower bounds of users
+    bool  normalized,                   // normalized users?
+    int   m,                            // number of users
+    const int *index,                   // user index
+    float *lower_bounds) const          // lower bounds (return)
+{
+    const float *src = normalized ? norm_ : raw_;
+    for (int i = 0; i < m; ++i) {
+        const float *lb = src + (u64) index[i]*k_max_;
+        std::copy(lb, lb+k_max_, lower_bounds + (u64) i*k_max_);
+    }
+}
+
+// -----------------------------------------------------------------------------
+void Lower_Bounds::display()        // display parameters
+{
+    printf("Parameters of Lower_Bounds:\n");
+    printf("m             = %d\n",   m_);
+    printf("d             = %d\n",   d_);
+    printf("k_max         = %d\n",   k_max_);
+    printf("n0            = %d\n",   n0_);
+    printf("coeff         = %d\n",   coeff_);
+    printf("hash          = %016lx\n\n", hash_);
+}
+
+} // end namespace ip
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <iostream>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <vector>
+
+#include <omp.h>
+
+#include "def.h"
+#include "util.h"
+#include "pri_queue.h"
+
+namespace ip {
+
+// -----------------------------------------------------------------------------
+void calc_lower_bounds(             // compute lower bounds for users (parallel)
+    int   m,                            // number of users
+    int   n0,                           // the first n0 elements in item_set
+    int   d,                            // dimensionality
+    int   k_max,                        // max k value
+    const float *item_norms,            // sorted item l2-norms
+    const float *item_set,              // sorted item vectors
+    const float *user_norms,            // l2-norms of users (nullptr: unit)
+    const float *user_set,              // users
+    float *lower_bounds);               // lower bounds (return)
+
+// -----------------------------------------------------------------------------
+//  Lower_Bounds: the k_max approximate mips results of users over the first 
+//  n0 = k_max*coeff items (sorted in descending order of l2-norms), which are 
+//  the lower bounds used by SA_Simpfer, SA_CONE, H2_Simpfer, and H2_CONE
+//
+//  The lower bounds are computed once, stored in a binary file, and loaded by 
+//  the indexes instead of recomputing them. As the indexes check the items 
+//  after the first n0 items only, they use the n0 of the lower bounds, so the 
+//  lower bounds can be tightened offline by a larger coeff
+//
+//  Binary Format:
+//  1. header: LB_MAGIC, m, d, k_max, n0, coeff (six u32), and the hash of the
+//     item_set and user_set (u64)
+//  2. raw:  the lower bounds of users (m*k_max floats, in the input order)
+//  3. norm: the lower bounds of normalized users (m*k_max floats, in the 
+//     input order) for Cone-Tree Blocking
+// -----------------------------------------------------------------------------
+class Lower_Bounds {
+public:
+    int   m_;                       // user cardinality
+    int   d_;                       // dimensionality
+    int   k_max_;                   // max k value
+    int   n0_;                      // the first n0 items for lower bounds
+    int   coeff_;                   // n0 = min(k_max*coeff, n)
+    u64   hash_;                    // hash of item_set and user_set
+    float *raw_;                    // lower bounds of users
+    float *norm_;                   // lower bounds of normalized users
+    
+    // -------------------------------------------------------------------------
+    Lower_Bounds();                 // constructor
+    
+    // -------------------------------------------------------------------------
+    ~Lower_Bounds();                // destructor
+    
+    // -------------------------------------------------------------------------
+    void build(                     // compute the lower bounds (parallel)
+        int   n,                        // item cardinality
+        int   m,                        // user cardinality
+        int   d,                        // dimensionality
+        int   k_max,                    // max k value
+        int   coeff,                    // n0 = min(k_max*coeff, n)
+        u64   hash,                     // hash of item_set and user_set
+        const float *item_set,          // item set
+        const float *user_set);         // user set
+    
+    // -------------------------------------------------------------------------
+    int save(                       // save the lower bounds to disk
+        const char *fname);             // address of lower bounds
+    
+    // -------------------------------------------------------------------------
+    int load(                       // load the lower bounds from disk
+        int   m,                        // user cardinality
+        int   d,                        // dimensionality
+        int   k_max,                    // max k value
+        u64   hash,                     // hash of item_set and user_set
+        const char *fname);             // address of lower bounds
+    
+    // -------------------------------------------------------------------------
+    void copy(                      // copy the lower bounds of users
+        bool  normalized,               // normalized users?
+        int   m,                        // number of users
+        const int *index,               // user index
+        float *lower_bounds) const;     // lower bounds (return)
+    
+    // -------------------------------------------------------------------------
+    void display();                 // display parameters
+};
+
+} // end namespace ip
@@ -29,9 +29,25 @@ void usage()                        // display the usage
         " -K     {integer}  # hash tables for SRP-LSH\n"
         " -l     {integer}  leaf size for Cone-Tree/Ball-Tree\n"
         " -b     {real}     interval ratio for H2-ALSH & SA-ALSH\n"
+        " -c     {integer}  # users of a chunk (stream users from disk)\n"
         " -is    {string}   address of item  set\n"
         " -us    {string}   address of user  set\n"
         " -qs    {string}   address of query set\n"
+        " -lf    {string}   address of user leaf file (disk-resident leaves)\n"
+        " -sf    {string}   address of sweep config (methods & parameters)\n"
+        " -lb    {string}   address of precomputed user lower bounds\n"
+        " -cf    {integer}  n0 = k_max*cf items for lower bounds (alg 10)\n"
+        " -sa    {integer}  method of served index (alg 1-6 & 8)\n"
+        " -ix    {string}   address of index params (rebuild or build & save)\n"
+        " -so    {string}   address of unix socket (-: stdin & stdout)\n"
+        " -mb    {integer}  max # queries of a batch (1: no batch)\n"
+        " -md    {real}     max queueing delay of a batch (ms)\n"
+        " -ns    {integer}  # user shards (worker processes)\n"
+        " -ua    {string}   address of user attributes (u64 per user)\n"
+        " -pc    {integer}  capture hardware counters of phases (1: on)\n"
+        " -nt    {integer}  # threads of parallel build (0: # cpus)\n"
+        " -hp    {integer}  huge pages of big arrays (0: off, 1: thp, 2: tlb)\n"
+        " -numa  {integer}  bind shard workers to numa nodes (1: on)\n"
         " -ts    {string}   address of truth set\n"
         " -of    {string}   output folder\n"
         "\n"
@@ -39,29 +55,47 @@ void usage()                        // display the usage
         " Primary Options of Algorithms                                     \n"
         "-------------------------------------------------------------------\n"
         " 0  - Ground Truth & Histogram & Heatmap\n"
-        "      Param: -alg 0 -n -m -qn -d -is -us -qs -ts -of\n"
+        "      Param: -alg 0 -n -m -qn -d [-c] -is -us -qs -ts -of\n"
         "\n"
         " 1  - Exhaustive_Scan\n"
-        "      Param: -alg 1 -n -m -qn -d -is -us -qs -ts -of\n"
+        "      Param: -alg 1 -n -m -qn -d [-c] -is -us -qs -ts -of\n"
         "\n"
         " 2  - SA_Simpfer (SA-ALSH + Simpfer)\n"
-        "      Param: -alg 2 -n -m -qn -d -K -b -is -us -qs -ts -of\n"
+        "      Param: -alg 2 -n -m -qn -d -K -b [-lb] -is -us -qs -ts -of\n"
         "\n"
         " 3  - SA_Cone (SA-ALSH + Cone-Tree Blocking)\n"
-        "      Param: -alg 3 -n -m -qn -d -K -l -b -is -us -qs -ts -of\n"
+        "      Param: -alg 3 -n -m -qn -d -K -l -b [-lb | -lf [-c]] -is -us\n"
+        "             -qs -ts -of\n"
         "\n"
         " 4  - H2_ALSH\n"
         "      Param: -alg 4 -n -m -qn -d -b -is -us -qs -ts -of\n"
         "\n"
         " 5  - H2_Simpfer (H2-ALSH + Simpfer)\n"
-        "      Param: -alg 5 -n -m -qn -d -b -is -us -qs -ts -of\n"
+        "      Param: -alg 5 -n -m -qn -d -b [-lb] -is -us -qs -ts -of\n"
         "\n"
         " 6  - H2_Cone (H2-ALSH + Cone-Tree Blocking)\n"
-        "      Param: -alg 6 -n -m -qn -d -l -b -is -us -qs -ts -of\n"
+        "      Param: -alg 6 -n -m -qn -d -l -b [-lb] -is -us -qs -ts -of\n"
         "\n"
         " 7  - Linear Scan User Set\n"
         "      Param: -alg 7 -n -m -qn -d -is -us -qs -ts -of\n"
         "\n"
+        " 8  - Dual_Cone (User & Item Cone-Trees)\n"
+        "      Param: -alg 8 -n -m -qn -d -l -is -us -qs -ts -of\n"
+        "\n"
+        " 9  - Sweep (Methods & Parameters with Shared Artifacts)\n"
+        "      Param: -alg 9 -n -m -qn -d -sf [-lb] -is -us -qs -ts -of\n"
+        "\n"
+        " 10 - Lower Bounds (Precompute User Lower Bounds)\n"
+        "      Param: -alg 10 -n -m -d [-cf] -is -us -lb\n"
+        "\n"
+        " 12 - Server (Serve Reverse k-MIPS Requests by an Index in Memory)\n"
+        "      Param: -alg 12 -n -m -d -sa [-K] [-l] [-b] [-ix] [-lb]\n"
+        "             [-mb] [-md] [-ua] -is -us -so\n"
+        "\n"
+        " 13 - Shard (Server by Workers of User Shards & a Coordinator)\n"
+        "      Param: -alg 13 -n -m -d -sa -ns [-K] [-l] [-b] [-mb] [-md]\n"
+        "             [-ua] [-numa] -is -us -so\n"
+        "\n"
         "-------------------------------------------------------------------\n"
         " Author: Qiang Huang (huangq@comp.nus.edu.sg)                      \n"
         "-------------------------------------------------------------------\n"
@@ -87,7 +121,7 @@ void unit_test(                     // unit test Scan and Cone_Tree
         printf("World (%d)\n\n", id );
     }
     
-    Scan *scan1 = new Scan(n, m, d, k_max, true, item_set, user_set);
+    Scan *scan1 = new Scan(n, m, d, k_max, true, HUGE_OFF, item_set, user_set);
     for (int i = 0; i < num_q; ++i) {
         float *k_bound = scan1->k_bounds_ + (u64) i*k_max;
         
@@ -96,7 +130,7 @@ void unit_test(                     // unit test Scan and Cone_Tree
     }
     printf("\n");
     
-    Scan *scan2 = new Scan(n, m, d, k_max, false, item_set, user_set);
+    Scan *scan2 = new Scan(n, m, d, k_max, false, HUGE_OFF, item_set, user_set);
     for (int i = 0; i < num_q; ++i) {
         float *k_bound = scan2->k_bounds_ + (u64) i*k_max;
         
@@ -123,11 +157,36 @@ int main(int nargs, char **args)
     int   K    = -1;                // # hash tables for SRP-LSH
     int   leaf = -1;                // leaf size for Cone-Tree
     float b    = -1.0f;             // interval ratio for H2-ALSH & SA-ALSH
+    int   c    = -1;                // # users of a chunk (-1: load all)
+    int   cf   = COEFF;             // n0 = k_max*cf items for lower bounds
     char  items_addr[200];          // address of item  set
     char  users_addr[200];          // address of user  set
     char  query_addr[200];          // address of query set
     char  truth_addr[200];          // address of truth set
     char  out_folder[200];          // output folder
+    char  leaf_addr[200] = "";      // address of user leaf file (optional)
+    char  sweep_addr[200];          // address of sweep config
+    char  lb_addr[200] = "";        // address of lower bounds (optional)
+    int   sa   = -1;                // method of served index
+    char  index_addr[200] = "";     // address of index params (optional)
+    char  socket_addr[200] = "-";   // address of unix socket (-: stdio)
+    int   mb   = 1;                 // max # queries of a batch (1: none)
+    float md   = 1.0f;              // max queueing delay of a batch (ms)
+    int   ns   = 1;                 // # user shards (worker processes)
+    char  ua_addr[200] = "";        // address of user attributes (optional)
+    int   pc   = 0;                 // capture hardware counters (1: on)
+    int   numa = 0;                 // bind shard workers to numa nodes (1: on)
+    int   hp   = HUGE_OFF;          // backing of big arrays (HUGE_*)
+    
+    // the server of stdin & stdout keeps stdout for its responses, so the 
+    // logs are redirected to stderr
+    int   out_fd = STDOUT_FILENO;   // file descriptor of stdio responses
+    for (int i = 1; i+1 < nargs; ++i) {
+        if (strcmp(args[i], "-so") == 0 && strcmp(args[i+1], "-") == 0) {
+            out_fd = dup(STDOUT_FILENO); dup2(STDERR_FILENO, STDOUT_FILENO);
+            break;
+        }
+    }
 
     printf("-------------------------------------------------------------\n");
     while (cnt < nargs) {
@@ -163,6 +222,14 @@ int main(int nargs, char **args)
             b = atof(args[++cnt]); assert(b > 0.0f && b < 1.0f);
             printf("b    = %g\n", b);
         }
+        else if (strcmp(args[cnt], "-c") == 0) {
+            c = atoi(args[++cnt]); assert(c > 0);
+            printf("c    = %d\n", c);
+        }
+        else if (strcmp(args[cnt], "-cf") == 0) {
+            cf = atoi(args[++cnt]); assert(cf > 0);
+            printf("cf   = %d\n", cf);
+        }
         else if (strcmp(args[cnt], "-is") == 0) {
             strncpy(items_addr, args[++cnt], sizeof(items_addr));
             printf("is   = %s\n", items_addr);
@@ -175,6 +242,65 @@ int main(int nargs, char **args)
             strncpy(query_addr, args[++cnt], sizeof(query_addr));
             printf("qs   = %s\n", query_addr);
         }
+        else if (strcmp(args[cnt], "-lf") == 0) {
+            strncpy(leaf_addr, args[++cnt], sizeof(leaf_addr));
+            create_dir(leaf_addr);
+            printf("lf   = %s\n", leaf_addr);
+        }
+        else if (strcmp(args[cnt], "-sf") == 0) {
+            strncpy(sweep_addr, args[++cnt], sizeof(sweep_addr));
+            printf("sf   = %s\n", sweep_addr);
+        }
+        else if (strcmp(args[cnt], "-lb") == 0) {
+            strncpy(lb_addr, args[++cnt], sizeof(lb_addr));
+            create_dir(lb_addr);
+            printf("lb   = %s\n", lb_addr);
+        }
+        else if (strcmp(args[cnt], "-sa") == 0) {
+            sa = atoi(args[++cnt]); assert(sa > 0);
+            printf("sa   = %d\n", sa);
+        }
+        else if (strcmp(args[cnt], "-ix") == 0) {
+            strncpy(index_addr, args[++cnt], sizeof(index_addr));
+            printf("ix   = %s\n", index_addr);
+        }
+        else if (strcmp(args[cnt], "-so") == 0) {
+            strncpy(socket_addr, args[++cnt], sizeof(socket_addr));
+            printf("so   = %s\n", socket_addr);
+        }
+        else if (strcmp(args[cnt], "-mb") == 0) {
+            mb = atoi(args[++cnt]); assert(mb > 0);
+            printf("mb   = %d\n", mb);
+        }
+        else if (strcmp(args[cnt], "-md") == 0) {
+            md = atof(args[++cnt]); assert(md >= 0.0f);
+            printf("md   = %g\n", md);
+        }
+        else if (strcmp(args[cnt], "-ns") == 0) {
+            ns = atoi(args[++cnt]); assert(ns > 0);
+            printf("ns   = %d\n", ns);
+        }
+        else if (strcmp(args[cnt], "-ua") == 0) {
+            strncpy(ua_addr, args[++cnt], sizeof(ua_addr));
+            printf("ua   = %s\n", ua_addr);
+        }
+        else if (strcmp(args[cnt], "-pc") == 0) {
+            pc = atoi(args[++cnt]); assert(pc >= 0);
+            printf("pc   = %d\n", pc);
+        }
+        else if (strcmp(args[cnt], "-hp") == 0) {
+            hp = atoi(args[++cnt]);
+            assert(hp >= HUGE_OFF && hp < NUM_HUGE_MODES);
+            printf("hp   = %s\n", HUGE_MODE_NAMES[hp]);
+        }
+        else if (strcmp(args[cnt], "-nt") == 0) {
+            g_num_threads = atoi(args[++cnt]); assert(g_num_threads >= 0);
+            printf("nt   = %d\n", g_num_threads);
+        }
+        else if (strcmp(args[cnt], "-numa") == 0) {
+            numa = atoi(args[++cnt]); assert(numa >= 0);
+            printf("numa = %d\n", numa);
+        }
         else if (strcmp(args[cnt], "-ts") == 0) {
             strncpy(truth_addr, args[++cnt], sizeof(truth_addr));
             create_dir(truth_addr);
@@ -192,23 +318,57 @@ int main(int nargs, char **args)
     }
     printf("-------------------------------------------------------------\n\n");
     
+    // enable the hardware counters, where each thread (of openmp, or of the 
+    // server) opens its own counters when it first enters a phase
+    if (pc > 0 && g_perf.open()) {
+        printf("Could not open hardware counters (perf_event_open)\n\n");
+    }
+    
     // -------------------------------------------------------------------------
-    //  read item set, user set, and query set
+    //  read item set, user set, and query set (user set is streamed by 
+    //  chunks from disk for alg 0 & 1 if c > 0, and for alg 3 with a leaf 
+    //  file, whose build never holds the user set)
     // -------------------------------------------------------------------------
+    bool disk   = alg == 3 && leaf_addr[0] != '\0';
+    bool stream = (c > 0 && (alg == 0 || alg == 1)) || disk;
+    bool query  = alg != 10 && alg < 12; // no query files for alg 10, 12, 13
+    
     gettimeofday(&g_start_time, nullptr);
     float *item_set  = new float[(u64) n*d];
-    float *user_set  = new float[(u64) m*d];
-    float *query_set = new float[(u64) qn*d];
+    float *user_set  = stream ? nullptr : new float[(u64) m*d];
+    float *query_set = query ? new float[(u64) qn*d] : nullptr;
     
     if (read_bin_data(n,  d, items_addr, item_set))  exit(1);
-    if (read_bin_data(m,  d, users_addr, user_set))  exit(1);
-    if (read_bin_data(qn, d, query_addr, query_set)) exit(1);
+    if (!stream && read_bin_data(m, d, users_addr, user_set)) exit(1);
+    if (query && read_bin_data(qn, d, query_addr, query_set)) exit(1);
     
     gettimeofday(&g_end_time, nullptr);
     double input_time = g_end_time.tv_sec - g_start_time.tv_sec + 
         (g_end_time.tv_usec - g_start_time.tv_usec) / 1000000.0;
     printf("Read items, users, & queries: %g Seconds\n\n", input_time);
     
+    // -------------------------------------------------------------------------
+    //  load the precomputed lower bounds of users (if any), which must match 
+    //  the dataset and K_MAX; otherwise, the methods compute them by their own
+    // -------------------------------------------------------------------------
+    Lower_Bounds *lb = nullptr;
+    if (lb_addr[0] != '\0' && alg != 10 && !stream) {
+        u64 hash = calc_dataset_hash(n, m, d, item_set, user_set);
+        lb = new Lower_Bounds();
+        if (lb->load(m, d, K_MAX, hash, lb_addr)) { delete lb; lb = nullptr; }
+        else lb->display();
+    }
+    
+    // -------------------------------------------------------------------------
+    //  read the attributes of users (if any) for the filtered requests of the
+    //  servers (alg 12 & 13)
+    // -------------------------------------------------------------------------
+    u64 *user_attrs = nullptr;
+    if (ua_addr[0] != '\0' && (alg == 12 || alg == 13)) {
+        user_attrs = new u64[m];
+        if (read_user_attrs(m, ua_addr, user_attrs)) exit(1);
+    }
+    
     // unit_test(n, m, d, item_set, user_set);
     
     // -------------------------------------------------------------------------
@@ -216,43 +376,84 @@ int main(int nargs, char **args)
     // -------------------------------------------------------------------------
     switch (alg) {
     case 0:
-        ground_truth(n, m, qn, d, truth_addr, (const float*) item_set, 
+        if (stream) {
+            ground_truth_stream(n, m, qn, d, c, hp, truth_addr, users_addr, 
+                (const float*) item_set, (const float*) query_set);
+            break;
+        }
+        ground_truth(n, m, qn, d, hp, truth_addr, (const float*) item_set, 
             (const float*) user_set, (const float*) query_set);
         break;
     case 1:
-        exhaustive_scan(n, m, qn, d, "exhaustive_scan", truth_addr, out_folder, 
-            (const float*) item_set, (const float*) user_set, 
+        if (stream) {
+            exhaustive_scan_stream(n, m, qn, d, c, hp, "exhaustive_scan", 
+                truth_addr, out_folder, users_addr, (const float*) item_set, 
+                (const float*) query_set);
+            break;
+        }
+        exhaustive_scan(n, m, qn, d, hp, "exhaustive_scan", truth_addr, 
+            out_folder, (const float*) item_set, (const float*) user_set, 
             (const float*) query_set);
         break;
     case 2:
-        sa_simpfer(n, m, qn, d, K, b, "sa_simpfer", truth_addr, out_folder, 
+        sa_simpfer(n, m, qn, d, K, b, hp, "sa_simpfer", truth_addr, out_folder, 
             (const float*) item_set, (const float*) user_set, 
-            (const float*) query_set);
+            (const float*) query_set, lb);
         break;
     case 3:
-        sa_cone(n, m, qn, d, K, leaf, b, "sa_cone", truth_addr, out_folder, 
+        if (disk) {
+            sa_cone_stream(n, m, qn, d, K, leaf, b, c > 0 ? c : USER_CHUNK, hp,
+                "sa_cone", truth_addr, out_folder, users_addr, leaf_addr, 
+                (const float*) item_set, (const float*) query_set);
+            break;
+        }
+        sa_cone(n, m, qn, d, K, leaf, b, hp, "sa_cone", truth_addr, out_folder, 
             (const float*) item_set, (const float*) user_set, 
-            (const float*) query_set);
+            (const float*) query_set, lb);
         break;
     case 4:
-        h2_alsh(n, m, qn, d, b, "h2_alsh", truth_addr, out_folder, 
+        h2_alsh(n, m, qn, d, b, hp, "h2_alsh", truth_addr, out_folder, 
             (const float*) item_set, (const float*) user_set, 
             (const float*) query_set);
         break;
     case 5:
-        h2_simpfer(n, m, qn, d, b, "h2_simpfer", truth_addr, out_folder, 
+        h2_simpfer(n, m, qn, d, b, hp, "h2_simpfer", truth_addr, out_folder, 
             (const float*) item_set, (const float*) user_set, 
-            (const float*) query_set);
+            (const float*) query_set, lb);
         break;
     case 6:
-        h2_cone(n, m, qn, d, leaf, b, "h2_cone", truth_addr, out_folder, 
+        h2_cone(n, m, qn, d, leaf, b, hp, "h2_cone", truth_addr, out_folder, 
             (const float*) item_set, (const float*) user_set, 
-            (const float*) query_set);
+            (const float*) query_set, lb);
         break;
     case 7:
         linear(m, qn, d, "linear", truth_addr, out_folder, 
             (const float*) user_set, (const float*) query_set);
         break;
+    case 8:
+        dual_cone(n, m, qn, d, leaf, hp, "dual_cone", truth_addr, out_folder, 
+            (const float*) item_set, (const float*) user_set, 
+            (const float*) query_set);
+        break;
+    case 9:
+        sweep(n, m, qn, d, hp, sweep_addr, truth_addr, out_folder, 
+            (const float*) item_set, (const float*) user_set, 
+            (const float*) query_set, lb);
+        break;
+    case 10:
+        lower_bounds(n, m, d, cf, lb_addr, (const float*) item_set, 
+            (const float*) user_set);
+        break;
+    case 12:
+        server(n, m, d, K, leaf, b, sa, hp, index_addr, socket_addr, out_fd, 
+            mb, md, (const float*) item_set, (const float*) user_set, 
+            (const u64*) user_attrs, lb);
+        break;
+    case 13:
+        shard(n, m, d, K, leaf, b, sa, ns, numa, hp, socket_addr, out_fd, mb, 
+            md, (const float*) item_set, (const float*) user_set, 
+            (const u64*) user_attrs);
+        break;
     default:
         printf("Parameters error!\n"); usage();
         break;
@@ -264,6 +465,8 @@ int main(int nargs, char **args)
     if (!item_set)  { delete[] item_set;  item_set  = nullptr; }
     if (!user_set)  { delete[] user_set;  user_set  = nullptr; }
     if (!query_set) { delete[] query_set; query_set = nullptr; }
+    if (lb != nullptr) { delete lb; lb = nullptr; }
+    if (user_attrs != nullptr) { delete[] user_attrs; user_attrs = nullptr; }
     
     return 0;
 }
@@ -0,0 +1,239 @@
+#include "perf.h"
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace ip {
+
+const char *PHASE_NAMES[NUM_PHASES] = { "other", "norm_sort", "lower_bounds",
+    "tree_build", "hashing", "user_scan", "kmips" };
+const char *EVENT_NAMES[NUM_EVENTS] = { "cycles", "instructions",
+    "llc_misses", "branch_misses", "dtlb_misses" };
+
+std::atomic<u64> g_heap_bytes(0UL); // global param: live huge_alloc() bytes
+thread_local int64_t g_thread_heap = 0; // huge_alloc() bytes of this thread
+Perf_Profile g_perf;                // global param: counters of phases
+
+// -----------------------------------------------------------------------------
+//  Perf_Thread: the counters of a thread, which are retired when the thread 
+//  exits
+// -----------------------------------------------------------------------------
+struct Perf_Thread {
+    Perf_Counters *counters_ = nullptr; // counters (nullptr: none yet)
+    
+    ~Perf_Thread() { if (counters_ != nullptr) g_perf.retire(counters_); }
+};
+
+static thread_local Perf_Thread t_perf; // counters of this thread
+
+// -----------------------------------------------------------------------------
+Perf_Counters::Perf_Counters()      // constructor
+    : num_open_(0), phase_(PHASE_OTHER), heap_last_(g_thread_heap)
+{
+    std::fill(fds_, fds_ + NUM_EVENTS, -1);
+    memset(last_, 0, sizeof(last_));
+    memset(counts_, 0, sizeof(counts_));
+    memset(heap_, 0, sizeof(heap_));
+}
+
+// -----------------------------------------------------------------------------
+Perf_Counters::~Perf_Counters()     // destructor
+{
+    close();
+}
+
+// -----------------------------------------------------------------------------
+int Perf_Counters::open()           // open the counters (0: any event opened)
+{
+    const u32 types[NUM_EVENTS] = { PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE,
+        PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE };
+    const u64 configs[NUM_EVENTS] = { PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_HW_CACHE_DTLB |
+        (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+        (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) };
+    
+    // count the user space of the calling thread only (the counters of a
+    // thread are read by itself), where an event is scaled by its running 
+    // time if the events are multiplexed on the pmu
+    close();
+    for (int i = 0; i < NUM_EVENTS; ++i) {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size           = sizeof(attr);
+        attr.type           = types[i];
+        attr.config         = configs[i];
+        attr.exclude_kernel = 1;
+        attr.exclude_hv     = 1;
+        attr.read_format    = PERF_FORMAT_TOTAL_TIME_ENABLED |
+            PERF_FORMAT_TOTAL_TIME_RUNNING;
+        
+        fds_[i] = (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        if (fds_[i] >= 0) ++num_open_;
+    }
+    phase_ = PHASE_OTHER;
+    read_all(last_);
+    memset(counts_, 0, sizeof(counts_));
+    
+    return num_open_ > 0 ? 0 : 1;
+}
+
+// -----------------------------------------------------------------------------
+void Perf_Counters::close()         // close the counters
+{
+    for (int i = 0; i < NUM_EVENTS; ++i) {
+        if (fds_[i] >= 0) { ::close(fds_[i]); fds_[i] = -1; }
+    }
+    num_open_ = 0;
+}
+
+// -----------------------------------------------------------------------------
+void Perf_Counters::reset(          // reset the counters of phases
+    int   first,                        // first phase
+    int   last)                         // last phase (inclusive)
+{
+    for (int i = first; i <= last; ++i) {
+        std::fill(counts_[i], counts_[i] + NUM_EVENTS, 0UL);
+        heap_[i] = 0;
+    }
+}
+
+// -----------------------------------------------------------------------------
+void Perf_Counters::merge(          // add the counters of phases of another
+    const Perf_Counters &other)         // counters
+{
+    for (int i = 0; i < NUM_PHASES; ++i) {
+        for (int j = 0; j < NUM_EVENTS; ++j) {
+            counts_[i][j] += other.counts_[i][j];
+        }
+        heap_[i] += other.heap_[i];
+    }
+}
+
+// -----------------------------------------------------------------------------
+void Perf_Counters::switch_phase(   // switch to a phase
+    int   phase)                        // phase (PHASE_*)
+{
+    int64_t heap = g_thread_heap;
+    heap_[phase_] += heap - heap_last_;
+    heap_last_ = heap;
+    
+    if (num_open_ > 0) {
+        u64 now[NUM_EVENTS];
+        read_all(now);
+        for (int i = 0; i < NUM_EVENTS; ++i) {
+            // a scaled counter may go back a little (when multiplexed)
+            if (now[i] > last_[i]) counts_[phase_][i] += now[i] - last_[i];
+            last_[i] = now[i];
+        }
+    }
+    phase_ = phase;
+}
+
+// -----------------------------------------------------------------------------
+void Perf_Counters::read_all(       // read the (scaled) counters of events
+    u64   *values)                      // counters (return)
+{
+    u64 buf[3]; // value, time enabled, time running
+    for (int i = 0; i < NUM_EVENTS; ++i) {
+        values[i] = 0UL;
+        if (fds_[i] < 0 || read(fds_[i], buf, sizeof(buf)) != sizeof(buf)) {
+            continue;
+        }
+        if (buf[2] > 0UL && buf[2] < buf[1]) {
+            values[i] = (u64) ((double) buf[0] * buf[1] / buf[2]);
+        }
+        else values[i] = buf[0];
+    }
+}
+
+// -----------------------------------------------------------------------------
+Perf_Profile::Perf_Profile()        // constructor
+    : enabled_(false)
+{
+    std::fill(events_, events_ + NUM_EVENTS, false);
+}
+
+// -----------------------------------------------------------------------------
+Perf_Profile::~Perf_Profile()       // destructor
+{
+    for (auto counters : threads_) delete counters;
+    threads_.clear();
+}
+
+// -----------------------------------------------------------------------------
+int Perf_Profile::open()            // enable the hardware counters of threads
+{
+    // the calling thread opens its counters now, and the other threads open 
+    // theirs when they first enter a phase
+    Perf_Counters *counters = local();
+    std::lock_guard<std::mutex> lock(mutex_);
+    
+    enabled_ = true;
+    int ret = counters->open();
+    for (int i = 0; i < NUM_EVENTS; ++i) events_[i] = counters->is_open(i);
+    return ret;
+}
+
+// -----------------------------------------------------------------------------
+Perf_Counters* Perf_Profile::local()// get the counters of the calling thread
+{
+    if (t_perf.counters_ != nullptr) return t_perf.counters_;
+    
+    Perf_Counters *counters = new Perf_Counters();
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (enabled_) counters->open();
+    threads_.push_back(counters);
+    t_perf.counters_ = counters;
+    return counters;
+}
+
+// -----------------------------------------------------------------------------
+void Perf_Profile::retire(          // retire the counters of an exiting thread
+    Perf_Counters *counters)            // counters of the thread
+{
+    // count the phase running till now (by the exiting thread itself)
+    counters->enter(PHASE_OTHER);
+    counters->close();
+    
+    std::lock_guard<std::mutex> lock(mutex_);
+    retired_.merge(*counters);
+    threads_.erase(std::find(threads_.begin(), threads_.end(), counters));
+    delete counters;
+}
+
+// -----------------------------------------------------------------------------
+void Perf_Profile::reset(           // reset the counters of phases
+    int   first,                        // first phase
+    int   last)                         // last phase (inclusive)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto counters : threads_) counters->reset(first, last);
+    retired_.reset(first, last);
+}
+
+// -----------------------------------------------------------------------------
+double Perf_Profile::get(           // get a counter (-1: not available)
+    int   phase,                        // phase (PHASE_*)
+    int   event)                        // event (EVENT_*)
+{
+    if (!events_[event]) return -1.0;
+    
+    std::lock_guard<std::mutex> lock(mutex_);
+    u64 sum = retired_.get(phase, event);
+    for (auto counters : threads_) sum += counters->get(phase, event);
+    return (double) sum;
+}
+
+// -----------------------------------------------------------------------------
+int64_t Perf_Profile::get_heap(     // get the heap bytes allocated (net)
+    int   phase)                        // phase (PHASE_*)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    int64_t sum = retired_.get_heap(phase);
+    for (auto counters : threads_) sum += counters->get_heap(phase);
+    return sum;
+}
+
+} // end namespace ip
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+#include "def.h"
+
+namespace ip {
+
+// -----------------------------------------------------------------------------
+//  the phases of index build & query, where the hardware counters are
+//  accumulated to the innermost phase running (PHASE_OTHER: none)
+// -----------------------------------------------------------------------------
+enum Perf_Phase {
+    PHASE_OTHER = 0,                // not in any phase
+    PHASE_NORM_SORT,                // build: l2-norms & sorting
+    PHASE_LOWER_BOUNDS,             // build: lower bounds of users
+    PHASE_TREE_BUILD,               // build: cone-tree (or blocks) of users
+    PHASE_HASHING,                  // build: hashing of users & item blocks
+    PHASE_USER_SCAN,                // query: scan of user blocks & users
+    PHASE_KMIPS,                    // query: k-mips fallback of users
+    NUM_PHASES                      // # phases
+};
+
+// -----------------------------------------------------------------------------
+//  the hardware events counted for each phase
+// -----------------------------------------------------------------------------
+enum Perf_Event {
+    EVENT_CYCLES = 0,               // cpu cycles
+    EVENT_INSTRUCTIONS,             // instructions
+    EVENT_LLC_MISSES,               // last level cache misses
+    EVENT_BRANCH_MISSES,            // branch misses
+    EVENT_DTLB_MISSES,              // data tlb (read) misses
+    NUM_EVENTS                      // # events
+};
+
+extern const char *PHASE_NAMES[NUM_PHASES]; // names of phases
+extern const char *EVENT_NAMES[NUM_EVENTS]; // names of events
+
+// -----------------------------------------------------------------------------
+//  Perf_Counters: the hardware counters (by perf_event_open) of a thread and
+//  the bytes it took by huge_alloc() (net of frees) for each phase, where 
+//  they are read when the thread switches the phase, so that a phase 
+//  excludes the phases nested in it. The counters are only used by their 
+//  thread (see Perf_Profile), so a thread counts its own work without any 
+//  lock
+//
+//  The hardware counters are closed by default, and then switching a phase
+//  reads only g_thread_heap
+// -----------------------------------------------------------------------------
+class Perf_Counters {
+public:
+    // -------------------------------------------------------------------------
+    Perf_Counters();                // constructor
+    
+    // -------------------------------------------------------------------------
+    ~Perf_Counters();               // destructor
+    
+    // -------------------------------------------------------------------------
+    int open();                     // open the counters of the calling thread
+                                    // (0: any event opened)
+    
+    // -------------------------------------------------------------------------
+    void close();                   // close the counters
+    
+    // -------------------------------------------------------------------------
+    bool is_open(                   // is an event opened?
+        int   event) const {            // event (EVENT_*)
+        return fds_[event] >= 0;
+    }
+    
+    // -------------------------------------------------------------------------
+    int enter(                      // enter a phase (return the previous one)
+        int   phase) {                  // phase (PHASE_*)
+        int prev = phase_;
+        if (phase != phase_) switch_phase(phase);
+        return prev;
+    }
+    
+    // -------------------------------------------------------------------------
+    void reset(                     // reset the counters of phases
+        int   first,                    // first phase
+        int   last);                    // last phase (inclusive)
+    
+    // -------------------------------------------------------------------------
+    void merge(                     // add the counters of phases of another
+        const Perf_Counters &other);    // counters
+    
+    // -------------------------------------------------------------------------
+    u64 get(                        // get a counter
+        int   phase,                    // phase (PHASE_*)
+        int   event) const {            // event (EVENT_*)
+        return counts_[phase][event];
+    }
+    
+    // -------------------------------------------------------------------------
+    int64_t get_heap(               // get the heap bytes allocated (net)
+        int   phase) const {            // phase (PHASE_*)
+        return heap_[phase];
+    }
+
+protected:
+    int   fds_[NUM_EVENTS];         // file descriptors of events (-1: none)
+    int   num_open_;                // # events opened
+    int   phase_;                   // current phase
+    u64   last_[NUM_EVENTS];        // counters read at the last switch
+    u64   counts_[NUM_PHASES][NUM_EVENTS]; // counters of phases
+    int64_t heap_last_;             // heap bytes read at the last switch
+    int64_t heap_[NUM_PHASES];      // heap bytes allocated (net) of phases
+    
+    // -------------------------------------------------------------------------
+    void switch_phase(              // switch to a phase
+        int   phase);                   // phase (PHASE_*)
+    
+    // -------------------------------------------------------------------------
+    void read_all(                  // read the (scaled) counters of events
+        u64   *values);                 // counters (return)
+};
+
+extern std::atomic<u64> g_heap_bytes; // global param: live bytes of the 
+                                    // arrays of huge_alloc()
+extern thread_local int64_t g_thread_heap; // bytes (net) of huge_alloc() by 
+                                    // this thread
+
+// -----------------------------------------------------------------------------
+//  Perf_Profile: the counters of phases of all threads, where each thread 
+//  has its own Perf_Counters (created when it first enters a phase, and 
+//  opened if the profile is enabled), and the counters of a thread are 
+//  merged into the retired ones when it exits. So the threads of openmp, 
+//  the server & the scheduler count their own work, and a worker of a 
+//  parallel region enters the phase of the region itself
+//
+//  The counters are summed over the threads when they are read, i.e., when 
+//  the threads of the phases read are idle; an event which cannot be opened 
+//  (e.g., in a virtual machine without a pmu) is reported as -1
+// -----------------------------------------------------------------------------
+class Perf_Profile {
+public:
+    // -------------------------------------------------------------------------
+    Perf_Profile();                 // constructor
+    
+    // -------------------------------------------------------------------------
+    ~Perf_Profile();                // destructor
+    
+    // -------------------------------------------------------------------------
+    int open();                     // enable the hardware counters of threads
+                                    // (0: any event opened)
+    
+    // -------------------------------------------------------------------------
+    bool enabled() const { return enabled_; } // hardware counters enabled
+    
+    // -------------------------------------------------------------------------
+    Perf_Counters* local();         // get the counters of the calling thread
+    
+    // -------------------------------------------------------------------------
+    void retire(                    // retire the counters of an exiting thread
+        Perf_Counters *counters);       // counters of the thread
+    
+    // -------------------------------------------------------------------------
+    void reset(                     // reset the counters of phases
+        int   first,                    // first phase
+        int   last);                    // last phase (inclusive)
+    
+    // -------------------------------------------------------------------------
+    double get(                     // get a counter (-1: not available)
+        int   phase,                    // phase (PHASE_*)
+        int   event);                   // event (EVENT_*)
+    
+    // -------------------------------------------------------------------------
+    int64_t get_heap(               // get the heap bytes allocated (net)
+        int   phase);                   // phase (PHASE_*)
+
+protected:
+    std::mutex mutex_;              // mutex of threads_ & retired_
+    bool  enabled_;                 // hardware counters enabled
+    bool  events_[NUM_EVENTS];      // events opened
+    std::vector<Perf_Counters*> threads_; // counters of live threads
+    Perf_Counters retired_;         // counters of exited threads
+};
+
+extern Perf_Profile g_perf;         // global param: counters of phases
+
+// -----------------------------------------------------------------------------
+//  Perf_Scope: enter a phase in a scope (on the calling thread), and back to 
+//  the previous phase when leaving the scope
+// -----------------------------------------------------------------------------
+class Perf_Scope {
+public:
+    explicit Perf_Scope(int phase) : counters_(g_perf.local()), 
+        prev_(counters_->enter(phase)) {}
+    ~Perf_Scope() { counters_->enter(prev_); }
+
+protected:
+    Perf_Counters *counters_;       // counters of the calling thread
+    int   prev_;                    // previous phase
+};
+
+} // end namespace ip
@@ -6,10 +6,42 @@ namespace ip {
 QALSH::QALSH(                       // constructor
     int   n,                            // number of data objects
     int   d,                            // dimension of data objects
-    float c0)                           // approximation ratio
-    : n_(n), d_(d), c0_(c0)
+    float c0,                           // approximation ratio
+    const Huge_Alloc &alloc)            // backing & account of tables_
+    : n_(n), d_(d), c0_(c0), shared_(false)
 {
-    // init parameters
+    // init parameters (n = 0: only generate the lsh functions, which can be 
+    // shared by blocks with at most BLOCK_MAX_NUM data points)
+    init_params(n > 0 ? n : BLOCK_MAX_NUM);
+
+    // generate hash functions, chosen from N(0.0, 1.0)
+    a_ = new float[m_*d_];
+    for (int i = 0; i < m_*d_; ++i) a_[i] = gaussian(0.0F, 1.0F);
+
+    // allocate space for hash tables
+    tables_ = new_huge<Result>((u64) m_*n_, alloc);
+}
+
+// -----------------------------------------------------------------------------
+QALSH::QALSH(                       // constructor (share lsh functions)
+    int   n,                            // number of data objects
+    const QALSH *lsh,                   // qalsh with shared lsh functions
+    const Huge_Alloc &alloc)            // backing & account of tables_
+    : n_(n), d_(lsh->d_), c0_(lsh->c0_), shared_(true), a_(lsh->a_)
+{
+    // init parameters and use the first m_ lsh functions of lsh
+    init_params(n);
+    assert(m_ <= lsh->m_);
+    
+    // allocate space for hash tables
+    tables_ = new_huge<Result>((u64) m_*n_, alloc);
+}
+
+// -----------------------------------------------------------------------------
+void QALSH::init_params(            // init parameters w_, m_, and l_
+    int   n)                            // number of data objects
+{
+    float c0 = c0_;
     w_ = sqrt((8.0f*c0*c0*log(c0)) / (c0*c0-1.0f));
     
     float p1    = calc_p(w_ / 2.0f);
@@ -25,20 +57,13 @@ QALSH::QALSH(                       // constructor
     
     m_ = (int) ceil((para1 + para2) * (para1 + para2) / para3);
     l_ = (int) ceil(alpha * m_);
-
-    // generate hash functions, chosen from N(0.0, 1.0)
-    a_ = new float[m_*d_];
-    for (int i = 0; i < m_*d_; ++i) a_[i] = gaussian(0.0F, 1.0F);
-
-    // allocate space for hash tables
-    tables_ = new Result[(u64) m_*n_];
 }
 
 // -----------------------------------------------------------------------------
 QALSH::~QALSH()                     // destructor
 {
-    if (a_      != nullptr) { delete[] a_;      a_      = nullptr; }
-    if (tables_ != nullptr) { delete[] tables_; tables_ = nullptr; }
+    if (!shared_ && a_ != nullptr) { delete[] a_; a_ = nullptr; }
+    delete_huge(tables_);
 }
 
 // -----------------------------------------------------------------------------
@@ -49,6 +74,30 @@ float QALSH::calc_hash_value(       // calc hash value
     return calc_inner_product(d_, a_+tid*d_, data);
 }
 
+// -----------------------------------------------------------------------------
+void QALSH::calc_hash_values(       // calc hash values of data with 0 appended
+    int   n,                            // number of data
+    const float *data,                  // input data ((d_-1)-dim)
+    float *hash_values)                 // hash values (return)
+{
+    Perf_Scope perf(PHASE_HASHING);
+    
+    // the hash value of a user scaled by lambda (e.g., M/|u| of h2-trans) 
+    // with a zero appended is lambda times that of (u,0), which is computed 
+    // once for all item blocks
+    int d = d_ - 1;
+    std::vector<float> point(d_, 0.0f);
+    for (int i = 0; i < n; ++i) {
+        const float *x = data + (u64) i*d;
+        std::copy(x, x+d, point.begin());
+        
+        float *hash_value = hash_values + (u64) i*m_;
+        for (int j = 0; j < m_; ++j) {
+            hash_value[j] = calc_hash_value(j, point.data());
+        }
+    }
+}
+
 // -----------------------------------------------------------------------------
 void QALSH::display()               // display parameters
 {
@@ -80,6 +129,25 @@ int QALSH::knns(                    // approximate k-nns
     return cand_cnt;
 }
 
+// -----------------------------------------------------------------------------
+int QALSH::knns(                    // approximate k-nns
+    int   k,                            // top-k value
+    float R,                            // limited search range
+    float lambda,                       // scale of query
+    const float *proj,                  // hash values of unscaled query
+    std::vector<int> &cand)             // candidates (return)
+{
+    cand.clear();
+    
+    // dynamic collsion counting
+    alloc();
+    init_position(lambda, proj);
+    int cand_cnt = dynamic_collsion_counting(k, R, cand);
+    free();
+
+    return cand_cnt;
+}
+
 // -----------------------------------------------------------------------------
 int QALSH::knns(                    // approximate k-nns
     int   k,                            // top-k value
@@ -117,10 +185,28 @@ void QALSH::alloc()                 // alloc space for assistant parameters
 // -----------------------------------------------------------------------------
 void QALSH::init_position(          // init left/right positions
     const float *query)                 // input query
+{
+    for (int i = 0; i < m_; ++i) {
+        q_val_[i] = calc_hash_value(i, query);
+    }
+    init_position();
+}
+
+// -----------------------------------------------------------------------------
+void QALSH::init_position(          // init left/right positions
+    float lambda,                       // scale of query
+    const float *proj)                  // hash values of unscaled query
+{
+    // the hash value of lambda*query is lambda times that of query
+    for (int i = 0; i < m_; ++i) q_val_[i] = lambda * proj[i];
+    init_position();
+}
+
+// -----------------------------------------------------------------------------
+void QALSH::init_position()         // init left/right positions by q_val_
 {
     Result tmp;
     for (int i = 0; i < m_; ++i) {
-        q_val_[i] = calc_hash_value(i, query); ++g_ip_count;
         tmp.key_ = q_val_[i];
         
         Result *table = tables_ + (u64) i*n_;
@@ -30,6 +30,7 @@ public:
     float  w_;                      // bucket width
     int    m_;                      // number of hash tables
     int    l_;                      // collision threshold
+    bool   shared_;                 // share lsh functions or not
     float  *a_;                     // lsh functions
     Result *tables_;                // hash tables
     
@@ -37,7 +38,14 @@ public:
     QALSH(                          // constructor
         int   n,                        // number of data points
         int   d,                        // dimensionality
-        float c0);                      // approximation ratio
+        float c0,                       // approximation ratio
+        const Huge_Alloc &alloc);       // backing & account of tables_
+    
+    // -------------------------------------------------------------------------
+    QALSH(                          // constructor (share lsh functions)
+        int   n,                        // number of data points
+        const QALSH *lsh,               // qalsh with shared lsh functions
+        const Huge_Alloc &alloc);       // backing & account of tables_
     
     // -------------------------------------------------------------------------
     ~QALSH();                       // destructor
@@ -47,6 +55,12 @@ public:
         int   tid,                      // table id
         const float *data);             // input data
     
+    // -------------------------------------------------------------------------
+    void calc_hash_values(          // calc hash values of data with 0 appended
+        int   n,                        // number of data
+        const float *data,              // input data ((d_-1)-dim)
+        float *hash_values);            // hash values (return)
+    
     // -------------------------------------------------------------------------
     void display();                 // display parameters
     
@@ -57,6 +71,14 @@ public:
         const float *query,             // input query
         std::vector<int> &cand);        // candidates (return)
     
+    // -------------------------------------------------------------------------
+    int knns(                       // approximate k-nns
+        int   k,                        // top-k value
+        float R,                        // limited search range
+        float lambda,                   // scale of query
+        const float *proj,              // hash values of unscaled query
+        std::vector<int> &cand);        // candidates (return)
+    
     // -------------------------------------------------------------------------
     int knns(                       // approximate k-nns
         int   k,                        // top-k value
@@ -67,7 +89,7 @@ public:
     u64 get_estimated_memory() {    // get estimated memory usage
         u64 ret = 0UL;
         ret += sizeof(*this);
-        ret += sizeof(float)*m_*d_; // a_
+        if (!shared_) ret += sizeof(float)*m_*d_; // a_
         ret += sizeof(Result)*m_*n_;// tables_
         return ret;
     }
@@ -86,6 +108,10 @@ protected:
     float calc_p(float x) {         // calc collision probability, x = w/(2*r)
         return new_cdf(x, 0.001f);      // cdf of [-x, x]
     }
+    // -------------------------------------------------------------------------
+    void init_params(               // init parameters w_, m_, and l_
+        int   n);                       // number of data points
+    
     // -------------------------------------------------------------------------
     void alloc();                   // alloc space for assistant parameters
     
@@ -93,6 +119,14 @@ protected:
     void init_position(             // init left/right positions
         const float *query);            // input query
     
+    // -------------------------------------------------------------------------
+    void init_position(             // init left/right positions
+        float lambda,                   // scale of query
+        const float *proj);             // hash values of unscaled query
+    
+    // -------------------------------------------------------------------------
+    void init_position();           // init left/right positions by q_val_
+    
     // -------------------------------------------------------------------------
     int dynamic_collsion_counting(  // dynamic collision counting
         int   k,                        // top-k value
@@ -0,0 +1,210 @@
+#include "rkmips.h"
+#include "baseline.h"
+#include "sa_simpfer.h"
+#include "sa_cone.h"
+#include "h2_alsh.h"
+#include "h2_simpfer.h"
+#include "h2_cone.h"
+#include "dual_cone.h"
+
+namespace ip {
+
+// -----------------------------------------------------------------------------
+Reverse_KMIPS::Reverse_KMIPS(       // constructor
+    int   alg,                          // method (ALG_*)
+    int   n,                            // item cardinality
+    int   m,                            // user cardinality
+    int   d,                            // dimensionality
+    int   k_max,                        // max k value
+    int   K,                            // # hash tables (-1: not used)
+    int   leaf,                         // leaf size (-1: not used)
+    float b,                            // interval ratio (-1: not used)
+    int   huge)                         // backing of big arrays (HUGE_*)
+    : pre_time_(0.0), heap_bytes_(0UL), alloc_({ huge, &heap_bytes_ }),
+    user_attrs_(nullptr)
+{
+    // the big arrays and arenas of this index are allocated by alloc_, so 
+    // they are measured as its memory (see huge_alloc())
+    param_.alg_ = alg; param_.n_ = n; param_.m_ = m; param_.d_ = d;
+    param_.k_max_ = k_max; param_.K_ = K; param_.leaf_ = leaf; param_.b_ = b;
+    param_.huge_ = huge; param_.seed_ = RANDOM_SEED; param_.hash_ = 0UL;
+    stats_.reset();
+}
+
+// -----------------------------------------------------------------------------
+void Reverse_KMIPS::filtered_reverse_kmips(// reverse k-mips of filtered users
+    int   k,                            // top k value
+    const float *query,                 // query vector
+    const User_Filter *filter,          // filter of users (nullptr: none)
+    std::vector<int> &result)           // reverse k-mips result (return)
+{
+    // filter the result of reverse k-mips (by the methods without pushdown)
+    reverse_kmips(k, query, result);
+    if (filter == nullptr) return;
+    
+    int cnt = 0;
+    for (int id : result) if (pass_filter(filter, id)) result[cnt++] = id;
+    result.resize(cnt);
+}
+
+// -----------------------------------------------------------------------------
+void Reverse_KMIPS::rank_reverse_kmips(// reverse k-mips with ranks of users
+    int   k,                            // top k value
+    const float *query,                 // query vector
+    std::vector<int> &result,           // reverse k-mips result (return)
+    std::vector<int> &ranks)            // rank of query for result (return)
+{
+    // answer k' = 1, ..., k one by one (by the methods without one pass), 
+    // where the rank of a user is the first k' whose result contains it
+    std::vector<int> rank(param_.m_, 0);
+    Query_Stats total; total.reset();
+    for (int kk = 1; kk <= k; ++kk) {
+        reverse_kmips(kk, query, result);
+        total.add(stats_);
+        for (int id : result) if (rank[id] == 0) rank[id] = kk;
+    }
+    ranks.resize(result.size());
+    for (int i = 0; i < (int) result.size(); ++i) ranks[i] = rank[result[i]];
+    stats_ = total;
+}
+
+// -----------------------------------------------------------------------------
+void Reverse_KMIPS::batch_reverse_kmips(// reverse k-mips for a batch of queries
+    int   k,                            // top k value
+    int   qn,                           // number of queries
+    const float *query_set,             // query vectors
+    std::vector<std::vector<int> > &results, // results (return)
+    Query_Stats *stats)                 // stats of each query (return)
+{
+    results.resize(qn);
+    for (int i = 0; i < qn; ++i) {
+        const float *query = query_set + (u64) i*param_.d_;
+        reverse_kmips(k, query, results[i]);
+        if (stats != nullptr) stats[i] = stats_;
+    }
+}
+
+// -----------------------------------------------------------------------------
+int Reverse_KMIPS::save_params(     // save the params of index to disk
+    const char *fname)                  // address of index params
+{
+    FILE *fp = fopen(fname, "wb");
+    if (!fp) { printf("Could not create %s\n", fname); return 1; }
+    
+    u32 header[9] = { INDEX_MAGIC, (u32) param_.alg_, (u32) param_.n_,
+        (u32) param_.m_, (u32) param_.d_, (u32) param_.k_max_,
+        (u32) param_.K_, (u32) param_.leaf_, (u32) param_.seed_ };
+    fwrite(header, sizeof(u32), 9, fp);
+    fwrite(&param_.b_, sizeof(float), 1, fp);
+    fwrite(&param_.hash_, sizeof(u64), 1, fp);
+    fclose(fp);
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+static float* normalize_users(      // normalize users (allocated)
+    int   m,                            // user cardinality
+    int   d,                            // dimensionality
+    const float *user_set)              // user set
+{
+    float *norm_user_set = new float[(u64) m*d];
+    normalize_data(m, d, user_set, nullptr, norm_user_set);
+    return norm_user_set;
+}
+
+// -----------------------------------------------------------------------------
+Reverse_KMIPS* Reverse_KMIPS::build(// build an index
+    const Index_Param &param,           // method and parameters
+    const float *item_set,              // item set
+    const float *user_set,              // user set
+    const Lower_Bounds *lb)             // precomputed lower bounds
+{
+    int   n = param.n_, m = param.m_, d = param.d_, k_max = param.k_max_;
+    int   huge = param.huge_;
+    float b = param.b_;
+    
+    // the lsh functions and cone-trees are drawn by rand(), so the same seed 
+    // rebuilds the same index
+    srand(param.seed_);
+    
+    Reverse_KMIPS *index = nullptr;
+    float *norm_user_set = nullptr; // normalized users for cone-trees
+    switch (param.alg_) {
+    case ALG_SCAN:
+        index = new Scan(n, m, d, k_max, true, huge, item_set, user_set);
+        break;
+    case ALG_SA_SIMPFER:
+        index = new SA_Simpfer(n, m, d, k_max, param.K_, b, huge, item_set,
+            user_set, lb);
+        break;
+    case ALG_SA_CONE:
+        norm_user_set = normalize_users(m, d, user_set);
+        index = new SA_CONE(n, m, d, k_max, param.K_, param.leaf_, b, huge,
+            item_set, norm_user_set, nullptr, lb);
+        break;
+    case ALG_H2_ALSH:
+        index = new H2_ALSH(n, m, d, b, huge, item_set, user_set);
+        break;
+    case ALG_H2_SIMPFER:
+        index = new H2_Simpfer(n, m, d, k_max, b, huge, item_set, user_set, 
+            lb);
+        break;
+    case ALG_H2_CONE:
+        norm_user_set = normalize_users(m, d, user_set);
+        index = new H2_CONE(n, m, d, k_max, param.leaf_, b, huge, item_set,
+            norm_user_set, lb);
+        break;
+    case ALG_DUAL_CONE:
+        norm_user_set = normalize_users(m, d, user_set);
+        index = new Dual_Cone(n, m, d, k_max, param.leaf_, huge, item_set, 
+            norm_user_set);
+        break;
+    default:
+        return nullptr;
+    }
+    index->param_.seed_ = param.seed_;
+    index->param_.hash_ = param.hash_;
+    delete[] norm_user_set;
+    return index;
+}
+
+// -----------------------------------------------------------------------------
+Reverse_KMIPS* Reverse_KMIPS::rebuild(// rebuild an index by its saved params
+    const char *fname,                  // address of index params
+    int   n,                            // item cardinality
+    int   m,                            // user cardinality
+    int   d,                            // dimensionality
+    int   huge,                         // backing of big arrays (HUGE_*)
+    const float *item_set,              // item set
+    const float *user_set,              // user set
+    const Lower_Bounds *lb)             // precomputed lower bounds
+{
+    FILE *fp = fopen(fname, "rb");
+    if (!fp) { printf("Could not open %s\n", fname); return nullptr; }
+    
+    u32 header[9]; Index_Param param;
+    if (fread(header, sizeof(u32), 9, fp) != 9 ||
+        fread(&param.b_, sizeof(float), 1, fp) != 1 ||
+        fread(&param.hash_, sizeof(u64), 1, fp) != 1 ||
+        header[0] != INDEX_MAGIC) {
+        printf("Could not read %s\n", fname);
+        fclose(fp); return nullptr;
+    }
+    fclose(fp);
+    
+    param.alg_ = (int) header[1]; param.n_ = (int) header[2];
+    param.m_ = (int) header[3]; param.d_ = (int) header[4];
+    param.k_max_ = (int) header[5]; param.K_ = (int) header[6];
+    param.leaf_ = (int) header[7]; param.seed_ = (int) header[8];
+    param.huge_ = huge; // the backing is not a param of the saved index
+    
+    // the index must be rebuilt from the same item_set and user_set
+    if (param.n_ != n || param.m_ != m || param.d_ != d || (param.hash_ != 0UL
+        && param.hash_ != calc_dataset_hash(n, m, d, item_set, user_set))) {
+        printf("Index %s does not match the dataset\n", fname);
+        return nullptr;
+    }
+    return build(param, item_set, user_set, lb);
+}
+
+} // end namespace ip
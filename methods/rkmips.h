@@ -0,0 +1,247 @@
+#pragma once
+
+#include <iostream>
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+#include "def.h"
+#include "util.h"
+#include "huge_page.h"
+#include "lower_bounds.h"
+
+namespace ip {
+
+// -----------------------------------------------------------------------------
+//  methods implementing Reverse_KMIPS (the same ids as -alg of rmips)
+// -----------------------------------------------------------------------------
+const int ALG_SCAN       = 1;       // Scan
+const int ALG_SA_SIMPFER = 2;       // SA_Simpfer
+const int ALG_SA_CONE    = 3;       // SA_CONE
+const int ALG_H2_ALSH    = 4;       // H2_ALSH
+const int ALG_H2_SIMPFER = 5;       // H2_Simpfer
+const int ALG_H2_CONE    = 6;       // H2_CONE
+const int ALG_DUAL_CONE  = 8;       // Dual_Cone (with normalized users)
+const int ALG_SHARD      = 13;      // Shard_Index (coordinator of user shards)
+
+// -----------------------------------------------------------------------------
+//  Index_Param: the method and parameters of an index, which are enough to
+//  rebuild the index from the same item_set and user_set
+// -----------------------------------------------------------------------------
+struct Index_Param {
+    int   alg_;                     // method (ALG_*)
+    int   n_;                       // item cardinality
+    int   m_;                       // user cardinality
+    int   d_;                       // dimensionality
+    int   k_max_;                   // max k value
+    int   K_;                       // # hash tables for SRP-LSH (-1: not used)
+    int   leaf_;                    // leaf size of cone-tree (-1: not used)
+    float b_;                       // interval ratio for blocking items
+    int   huge_;                    // backing of big arrays (HUGE_*)
+    int   seed_;                    // random seed of lsh functions & trees
+    u64   hash_;                    // hash of item_set and user_set (0: none)
+};
+
+// -----------------------------------------------------------------------------
+//  Query_Stats: the statistics of a reverse k-mips query, where a query that
+//  could not be answered (e.g., by a failed read of its leaves) has status_
+//  1 and an empty result
+// -----------------------------------------------------------------------------
+struct Query_Stats {
+    u64    ip_count_;               // # inner product computations
+    double time_;                   // query time (seconds)
+    Prune_Stats prune_;             // counters of pruning stages
+    int    status_;                 // 0: success; 1: failed
+    
+    // -------------------------------------------------------------------------
+    void reset() { ip_count_ = 0UL; time_ = 0.0; prune_.reset(); status_ = 0; }
+    
+    // -------------------------------------------------------------------------
+    void add(const Query_Stats &other) {
+        ip_count_ += other.ip_count_; time_ += other.time_;
+        prune_.add(other.prune_); status_ |= other.status_;
+    }
+};
+
+// -----------------------------------------------------------------------------
+//  User_Filter: a filter of users for reverse k-mips, where a user passes if
+//  it has all attribute bits of all_ and any attribute bit of any_ (if any_ 
+//  is not 0), and it is in the bitmap of user ids (if given). The attributes 
+//  of users are up to 64 flags (e.g., one-hot regions & being active) in a 
+//  u64 for each user
+// -----------------------------------------------------------------------------
+struct User_Filter {
+    u64   all_;                     // attribute bits a user must have all of
+    u64   any_;                     // attribute bits a user must have any of
+    const u64 *bitmap_;             // bitmap of user ids (nullptr: all users)
+    
+    // -------------------------------------------------------------------------
+    bool pass_attrs(u64 attrs) const { // pass the attributes (of users)?
+        return (attrs & all_) == all_ && (any_ == 0UL || (attrs & any_) != 0UL);
+    }
+    
+    // -------------------------------------------------------------------------
+    bool pass_id(int id) const {    // pass the user id?
+        return bitmap_ == nullptr || ((bitmap_[id >> 6] >> (id & 63)) & 1UL);
+    }
+};
+
+// -----------------------------------------------------------------------------
+//  Reverse_KMIPS: the interface of the indexes for reverse k-mips, which is
+//  implemented by Scan, SA_Simpfer, SA_CONE, H2_ALSH, H2_Simpfer, H2_CONE, 
+//  and Dual_Cone
+//
+//  An index keeps its pre-processing time and the statistics of the last
+//  query, so that a query touches no global variable and prints nothing. A
+//  query modifies the statistics (and the buffers) of an index, so an index
+//  serves one query at a time
+//
+//  filtered_reverse_kmips() returns the users of the result passing a filter,
+//  where Scan checks the filter before the inner product of a user, SA_CONE
+//  and SA_Simpfer skip the user blocks with no user passing the filter by
+//  the summary (OR) of the attributes of their users, and the others filter
+//  the result of reverse_kmips()
+//
+//  rank_reverse_kmips() returns the reverse k-mips result together with the
+//  rank of the query for each user of the result, i.e., the reverse k'-mips
+//  result for every k' <= k is the users with rank <= k', where Scan (by its
+//  exact k-th mips), SA_CONE and SA_Simpfer (by the lower bounds of all k
+//  levels) compute the ranks in one pass, and the others answer each k'
+//
+//  SA_CONE and H2_CONE are built from normalized users by their callers, so
+//  build() normalizes the users for them, and frees the normalized users as
+//  soon as the index is built (the leaves of cone-tree keep their copies)
+//
+//  The built structures of an index are not serialized: save_params() keeps
+//  the Index_Param only, and rebuild() checks the hash of the item_set and 
+//  user_set and rebuilds the same index by build() with the same random 
+//  seed, so it pays the full pre-processing again, except for the lower 
+//  bounds of users (the dominant cost) if a precomputed Lower_Bounds is given
+// -----------------------------------------------------------------------------
+class Reverse_KMIPS {
+public:
+    Index_Param param_;             // method and parameters
+    double pre_time_;               // pre-processing time (seconds)
+    std::atomic<u64> heap_bytes_;   // bytes of the arrays & arenas of index
+    Huge_Alloc alloc_;              // backing of arrays (account: heap_bytes_)
+    Query_Stats stats_;             // statistics of the last query
+    const u64 *user_attrs_;         // attributes of users (nullptr: none)
+    
+    // -------------------------------------------------------------------------
+    Reverse_KMIPS(                  // constructor
+        int   alg,                      // method (ALG_*)
+        int   n,                        // item cardinality
+        int   m,                        // user cardinality
+        int   d,                        // dimensionality
+        int   k_max,                    // max k value
+        int   K,                        // # hash tables (-1: not used)
+        int   leaf,                     // leaf size (-1: not used)
+        float b,                        // interval ratio (-1: not used)
+        int   huge);                    // backing of big arrays (HUGE_*)
+    
+    // -------------------------------------------------------------------------
+    virtual ~Reverse_KMIPS() {}     // destructor
+    
+    // -------------------------------------------------------------------------
+    virtual void display() = 0;     // display parameters
+    
+    // -------------------------------------------------------------------------
+    virtual void reverse_kmips(     // reverse k-mips
+        int   k,                        // top k value
+        const float *query,             // query vector
+        std::vector<int> &result) = 0;  // reverse k-mips result (return)
+    
+    // -------------------------------------------------------------------------
+    virtual void filtered_reverse_kmips(// reverse k-mips of filtered users
+        int   k,                        // top k value
+        const float *query,             // query vector
+        const User_Filter *filter,      // filter of users (nullptr: none)
+        std::vector<int> &result);      // reverse k-mips result (return)
+    
+    // -------------------------------------------------------------------------
+    virtual void rank_reverse_kmips(// reverse k-mips with ranks of users
+        int   k,                        // top k value
+        const float *query,             // query vector
+        std::vector<int> &result,       // reverse k-mips result (return)
+        std::vector<int> &ranks);       // rank of query for result (return)
+    
+    // -------------------------------------------------------------------------
+    static int get_rank(            // get the rank from bounds of all k levels
+        float ip,                       // inner product of user and query
+        int   k,                        // top k value
+        float scale,                    // scale of bounds
+        const float *bounds) {          // non-increasing bounds (k)
+        // the smallest r in [1,k] s.t. ip >= scale*bounds[r-1] (k+1: none)
+        int lo = 0, hi = k;
+        while (lo < hi) {
+            int mid = (lo + hi) / 2;
+            if (ip >= scale*bounds[mid]) hi = mid; else lo = mid + 1;
+        }
+        return lo + 1;
+    }
+    
+    // -------------------------------------------------------------------------
+    virtual void set_user_attrs(    // set the attributes of users
+        const u64 *user_attrs) {        // attributes of users (m)
+        user_attrs_ = user_attrs;
+    }
+    
+    // -------------------------------------------------------------------------
+    bool pass_filter(               // does a user pass the filter?
+        const User_Filter *filter,      // filter of users (nullptr: none)
+        int   id) const {               // user id
+        if (filter == nullptr) return true;
+        u64 attrs = user_attrs_ != nullptr ? user_attrs_[id] : 0UL;
+        return filter->pass_attrs(attrs) && filter->pass_id(id);
+    }
+    
+    // -------------------------------------------------------------------------
+    bool pass_block(                // may a user of a block pass the filter?
+        const User_Filter *filter,      // filter of users (nullptr: none)
+        u64   block_attrs,              // summary (OR) of attributes of users
+        int   n,                        // # users of the block
+        const int *index) const {       // user ids of the block
+        if (filter == nullptr) return true;
+        if (user_attrs_ == nullptr) block_attrs = 0UL;
+        if (!filter->pass_attrs(block_attrs)) return false;
+        if (filter->bitmap_ == nullptr) return true;
+        
+        for (int i = 0; i < n; ++i) if (filter->pass_id(index[i])) return true;
+        return false;
+    }
+    
+    // -------------------------------------------------------------------------
+    virtual void batch_reverse_kmips(// reverse k-mips for a batch of queries
+        int   k,                        // top k value
+        int   qn,                       // number of queries
+        const float *query_set,         // query vectors
+        std::vector<std::vector<int> > &results, // results (return)
+        Query_Stats *stats = nullptr);  // stats of each query (return)
+    
+    // -------------------------------------------------------------------------
+    virtual u64 get_estimated_memory() = 0; // get memory usage
+    
+    // -------------------------------------------------------------------------
+    int save_params(                // save the params of index to disk
+        const char *fname);             // address of index params
+    
+    // -------------------------------------------------------------------------
+    static Reverse_KMIPS* build(    // build an index
+        const Index_Param &param,       // method and parameters
+        const float *item_set,          // item set
+        const float *user_set,          // user set
+        const Lower_Bounds *lb = nullptr); // precomputed lower bounds
+    
+    // -------------------------------------------------------------------------
+    static Reverse_KMIPS* rebuild(  // rebuild an index by its saved params
+        const char *fname,              // address of index params
+        int   n,                        // item cardinality
+        int   m,                        // user cardinality
+        int   d,                        // dimensionality
+        int   huge,                     // backing of big arrays (HUGE_*)
+        const float *item_set,          // item set
+        const float *user_set,          // user set
+        const Lower_Bounds *lb = nullptr); // precomputed lower bounds
+};
+
+} // end namespace ip
@@ -85,6 +85,15 @@ do
   done
 done 
 
+# --------------------------------------------------------------------------------
+#  Dual_Cone (User & Item Cone-Trees, exact; compare with SA_Cone above)
+# --------------------------------------------------------------------------------
+for leaf in 20 50 100 200
+do 
+  ./rmips -alg 8 -n ${n} -m ${m} -qn ${qn} -d ${d} -l ${leaf} -is ${items} \
+    -us ${users} -qs ${query} -ts ${truth} -of ${folder}
+done
+
 # ------------------------------------------------------------------------------
 #  Linear Scan User Set
 # ------------------------------------------------------------------------------
@@ -85,6 +85,30 @@ do
   done
 done 
 
+# --------------------------------------------------------------------------------
+#  Dual_Cone (User & Item Cone-Trees, exact; compare with SA_Cone above)
+# --------------------------------------------------------------------------------
+for leaf in 20 50 100 200
+do 
+  ./rmips -alg 8 -n ${n} -m ${m} -qn ${qn} -d ${d} -l ${leaf} -is ${items} \
+    -us ${users} -qs ${query} -ts ${truth} -of ${folder}
+done
+
+# ------------------------------------------------------------------------------
+#  Precompute the lower bounds of users once (with a larger -cf for tighter 
+#  bounds), and pass "-lb ${lb}" to alg 2, 3, 5, 6, 9 (and simpfer) to load them
+# ------------------------------------------------------------------------------
+# lb=../data/bin/${name}/${name}.lb
+# ./rmips -alg 10 -n ${n} -m ${m} -d ${d} -cf 4 -is ${items} -us ${users} \
+#   -lb ${lb}
+
+# ------------------------------------------------------------------------------
+#  Sweep all methods & parameters of sweep.conf in one process (the results 
+#  are written to ${folder}sweep.csv and ${folder}sweep.json)
+# ------------------------------------------------------------------------------
+# ./rmips -alg 9 -n ${n} -m ${m} -qn ${qn} -d ${d} -sf sweep.conf -is ${items} \
+#   -us ${users} -qs ${query} -ts ${truth} -of ${folder}
+
 # ------------------------------------------------------------------------------
 #  Linear Scan User Set
 # ------------------------------------------------------------------------------
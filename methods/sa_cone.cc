@@ -12,38 +12,106 @@ SA_CONE::SA_CONE(                   // constructor
     int   K,                            // # hash tables for SRP-LSH
     int   leaf,                         // leaf size of cone-tree
     float b,                            // interval ratio for blocking items
+    int   huge,                         // backing of big arrays (HUGE_*)
     const float *item_set,              // item set
-    const float *user_set)              // user set
-    : n_(n), m_(m), d_(d), k_max_(k_max), K_(K), leaf_(leaf), b_(b)
+    const float *user_set,              // user set
+    const char  *leaf_addr,             // address of leaf file (optional)
+    const Lower_Bounds *lb)             // precomputed lower bounds
+    : Reverse_KMIPS(ALG_SA_CONE, n, m, d, k_max, K, leaf, b, huge), n_(n), 
+    m_(m), d_(d), k_max_(k_max), K_(K), leaf_(leaf), b_(b), 
+    leaf_file_(nullptr), buffers_{nullptr, nullptr}, shared_(nullptr), 
+    n0_(0), lb_(nullptr)
 {
-    gettimeofday(&g_start_time, nullptr);
+    timeval start_time, end_time;
+    gettimeofday(&start_time, nullptr);
     
     // 1. compute l2-norms & sort item_set in descending order of l2-norms
     item_index_ = new int[n];
     item_norms_ = new float[n];
-    item_set_   = new float[(u64) n*d];
+    item_set_   = new_huge<float>((u64) n*d, alloc_);
     compute_norm_and_sort(item_set);
     
-    // 2. build blocks (with cone-tree) for user_set for batch pruning
+    // 2. build blocks (with cone-tree) for user_set for batch pruning, and 
+    //    compute the lower bounds & srp-lsh hash keys for the users (with 
+    //    the srp-lsh functions & lookup table shared by all item blocks), 
+    //    where the payloads of user blocks are moved to disk as they are 
+    //    built (if a leaf file is given)
+    if (leaf_addr != nullptr) leaf_file_ = new Leaf_File(leaf_addr);
     int n0 = k_max*COEFF; // only consider the first n0 elements in item_set
     if (n0 > n) n0 = n;   // keep at most n
+    if (lb != nullptr) {  // use the n0 of the precomputed lower bounds
+        assert(lb->m_ == m && lb->d_ == d && lb->k_max_ == k_max);
+        n0 = lb->n0_;
+    }
     
-    blocking_user_set(n0, user_set);
+    srp_ = new SRP_LSH(0, d+1, K, alloc_);
+    blocking_user_set(n0, user_set, lb);
     
     // 3. build blocks for the rest item_set (with sa-trans) for batch pruning
     blocking_item_set(n-n0, item_norms_+n0, item_set_+(u64)n0*d);
     
-    // get the pre-processing time and estimated memory
-    gettimeofday(&g_end_time, nullptr);
-    g_pre_time = g_end_time.tv_sec - g_start_time.tv_sec + 
-        (g_end_time.tv_usec - g_start_time.tv_usec) / 1000000.0;
-    g_memory = get_estimated_memory();
+    // 4. allocate double buffers for batch reads (if a leaf file is given)
+    if (leaf_file_ != nullptr) {
+        u64 size = leaf_file_->max_size_ * LEAF_BATCH;
+        buffers_[0] = new char[size];
+        buffers_[1] = new char[size];
+    }
+    
+    // get the pre-processing time
+    gettimeofday(&end_time, nullptr);
+    pre_time_ = end_time.tv_sec - start_time.tv_sec + 
+        (end_time.tv_usec - start_time.tv_usec) / 1000000.0;
+}
+
+// -----------------------------------------------------------------------------
+SA_CONE::SA_CONE(                   // constructor (with shared artifacts)
+    int   K,                            // # hash tables for SRP-LSH
+    int   leaf,                         // leaf size of cone-tree
+    float b,                            // interval ratio for blocking items
+    Shared_Index *shared)               // sorted items & cone-tree of users
+    : Reverse_KMIPS(ALG_SA_CONE, shared->n_, shared->m_, shared->d_, 
+    shared->k_max_, K, leaf, b, shared->alloc_.mode_), n_(shared->n_), 
+    m_(shared->m_), d_(shared->d_), k_max_(shared->k_max_), K_(K), 
+    leaf_(leaf), b_(b), leaf_file_(nullptr), buffers_{nullptr, nullptr}, 
+    shared_(shared), n0_(shared->n0_), lb_(nullptr)
+{
+    timeval start_time, end_time;
+    gettimeofday(&start_time, nullptr);
+    
+    // 1. use the sorted item_set from the shared artifacts
+    item_index_ = shared->item_index_;
+    item_norms_ = shared->item_norms_;
+    item_set_   = shared->item_set_;
+    
+    // 2. use the shared cone-tree (with the lower bounds of users) as blocks 
+    //    for user_set, and compute the srp-lsh hash keys for the users
+    srp_ = new SRP_LSH(0, d_+1, K_, alloc_);
+    tree_ = shared->get_cone_tree(leaf);
+    blocks_.clear();
+    tree_->traversal(blocks_);
+    for (auto block : blocks_) {
+        int m = block->n_; // number of users
+        assert(block->hash_keys_ == nullptr); // the cone-tree is not in use
+        block->hash_keys_ = new_huge<u64>((u64) m*srp_->m_, alloc_);
+        srp_->calc_hash_keys(m, block->data_, block->hash_keys_);
+    }
+    
+    // 3. build blocks for the rest item_set for batch pruning
+    int n0 = shared->n0_;
+    blocking_item_set(n_-n0, item_norms_+n0, item_set_+(u64)n0*d_);
+    
+    // get the pre-processing time (excluding the shared artifacts)
+    gettimeofday(&end_time, nullptr);
+    pre_time_ = end_time.tv_sec - start_time.tv_sec + 
+        (end_time.tv_usec - start_time.tv_usec) / 1000000.0;
 }
 
 // -----------------------------------------------------------------------------
 void SA_CONE::compute_norm_and_sort(// compute l2-norm and sort (descending)
     const float *item_set)              // item_set
 {
+    Perf_Scope perf(PHASE_NORM_SORT);
+    
     // compute l2-norms for item_set
     Result *ret = new Result[n_];
     for (int i = 0; i < n_; ++i) {
@@ -69,31 +137,62 @@ void SA_CONE::compute_norm_and_sort(// compute l2-norm and sort (descending)
 // -----------------------------------------------------------------------------
 void SA_CONE::blocking_user_set(    // split the user_set into blocks
     int   n0,                           // the first n0 elements in item_set
-    const float *user_set)              // user_set
+    const float *user_set,              // user_set
+    const Lower_Bounds *lb)             // precomputed lower bounds
 {
-    // build a cone-tree for user_set
-    tree_ = new Cone_Tree(m_, d_, leaf_, user_set);
+    // build a cone-tree for user_set, with the lower bounds & hash keys of
+    // users in its arenas; with a leaf file, each leaf is streamed to disk 
+    // by add_leaf() as soon as it is built
+    n0_ = n0; lb_ = lb;
+    tree_ = new Cone_Tree(m_, d_, leaf_, user_set, alloc_,
+        sizeof(float)*k_max_ + sizeof(u64)*srp_->m_, sizeof(float)*k_max_,
+        leaf_file_ != nullptr ? this : nullptr);
     
     // traversal the cone-tree to get the blocks (cone-nodes) of user_set 
     blocks_.clear();
     tree_->traversal(blocks_);
     
-    // build lower bounds for the users in each cone-node
-    for (auto block : blocks_) {
-        int   m = block->n_; // number of users 
-        const float *user_set = block->data_;
-        
-        block->k_max_ = k_max_;
-        block->lower_bounds_ = new float[m*k_max_];
-        block->node_lower_bounds_ = new float[k_max_];
-        
-        // compute lower bounds for the users
-        lower_bounds_computation(m, n0, user_set, block->lower_bounds_);
-        
-        // compute lower bounds for this cone-node
-        node_lower_bounds_computation(m, block->lower_bounds_,
-            block->node_lower_bounds_);
+    // build lower bounds for the users in each cone-node (if not streamed)
+    if (leaf_file_ == nullptr) {
+        for (auto block : blocks_) add_leaf(tree_, block);
     }
+    lb_ = nullptr;
+    tree_->data_ = nullptr; // user_set is not kept (the leaves have copies)
+}
+
+// -----------------------------------------------------------------------------
+void SA_CONE::add_leaf(             // build the payload of a user block
+    Cone_Tree *tree,                    // cone-tree (arena_ & leaf_arena_)
+    Cone_Node *block)                   // user block (with users)
+{
+    int   m = block->n_; // number of users 
+    const float *user_set = block->data_;
+    
+    block->k_max_ = k_max_;
+    block->lower_bounds_ = tree->leaf_arena_->alloc<float>((u64) m*k_max_);
+    block->node_lower_bounds_ = tree->arena_->alloc<float>(k_max_);
+    block->hash_keys_ = tree->leaf_arena_->alloc<u64>((u64) m*srp_->m_);
+    
+    // compute lower bounds & srp-lsh hash keys for the users
+    if (lb_ != nullptr) { // load the precomputed lower bounds
+        lb_->copy(true, m, block->index_, block->lower_bounds_);
+    }
+    else lower_bounds_computation(m, n0_, user_set, block->lower_bounds_);
+    srp_->calc_hash_keys(m, user_set, block->hash_keys_);
+    
+    // compute lower bounds for this cone-node
+    node_lower_bounds_computation(m, block->lower_bounds_,
+        block->node_lower_bounds_);
+    if (leaf_file_ == nullptr) return;
+    
+    // write the payload of this block (in the order of blocks_) with the 
+    // layout: hash_keys_, data_, x_cos_, x_sin_, and lower_bounds_
+    u64 mu = (u64) m;
+    const void *segments[5] = { block->hash_keys_, block->data_, 
+        block->x_cos_, block->x_sin_, block->lower_bounds_ };
+    u64 sizes[5] = { sizeof(u64)*mu*srp_->m_, sizeof(float)*mu*d_,
+        sizeof(float)*mu, sizeof(float)*mu, sizeof(float)*mu*k_max_ };
+    leaf_file_->write(5, segments, sizes);
 }
 
 // -----------------------------------------------------------------------------
@@ -103,6 +202,8 @@ void SA_CONE::lower_bounds_computation(// compute lower bounds for users
     const float *user_set,              // users
     float *lower_bounds)                // lower bounds (return)
 {
+    Perf_Scope perf(PHASE_LOWER_BOUNDS);
+    
     MaxK_Array *arr = new MaxK_Array(k_max_);
     for (int i = 0; i < m; ++i) {
         // get user vector and its l2-norm
@@ -158,6 +259,8 @@ void SA_CONE::blocking_item_set(    // split the rest item_set into blocks
     const float *item_norms,            // item l2-norms
     const float *item_set)              // item set
 {
+    Perf_Scope perf(PHASE_HASHING);
+    
     hashs_.clear();
     
     // split item_set into blocks and build qalsh for each block
@@ -205,8 +308,8 @@ void SA_CONE::add_block_by_items(   // add one block by items
             shift_norms);
         block->R_ = sqrt(R);
         
-        // build hash tables for srp-lsh
-        block->srp_ = new SRP_LSH(n, d_+1, K_);
+        // build hash tables for srp-lsh (with the shared srp-lsh functions)
+        block->srp_ = new SRP_LSH(n, srp_, alloc_);
         
         SRP_LSH *srp = block->srp_;
         bool *hash_code = new bool[K_];
@@ -239,14 +342,23 @@ SA_CONE::~SA_CONE()                 // destructor
 {
     for (auto hash : hashs_) { delete hash; hash = nullptr; }
     std::vector<Item_Block*>().swap(hashs_);
+    if (srp_ != nullptr) { delete srp_; srp_ = nullptr; }
     
-    if (!item_set_)   { delete[] item_set_;   item_set_   = nullptr; }
-    if (!item_norms_) { delete[] item_norms_; item_norms_ = nullptr; }
-    if (!item_index_) { delete[] item_index_; item_index_ = nullptr; }
-    
+    if (shared_ == nullptr) { // the sorted items & cone-tree are owned
+        delete_huge(item_set_); delete[] item_norms_; delete[] item_index_;
+        if (tree_ != nullptr) delete tree_;
+    }
+    else { // release the srp-lsh hash keys of users from the shared cone-tree
+        for (auto block : blocks_) {
+            delete_huge(block->hash_keys_);
+        }
+    }
+    item_set_ = nullptr; item_norms_ = nullptr; item_index_ = nullptr;
+    tree_ = nullptr; shared_ = nullptr;
     std::vector<Cone_Node*>().swap(blocks_);
-    
-    if (tree_ != nullptr) { delete tree_; tree_ = nullptr; }
+    if (leaf_file_ != nullptr) { delete leaf_file_; leaf_file_ = nullptr; }
+    delete[] buffers_[0]; buffers_[0] = nullptr;
+    delete[] buffers_[1]; buffers_[1] = nullptr;
 }
 
 // -------------------------------------------------------------------------
@@ -261,7 +373,11 @@ void SA_CONE::display()             // display parameters
     printf("leaf          = %d\n",   leaf_);
     printf("b             = %g\n",   b_);
     printf("# user blocks = %d\n",   (int) blocks_.size());
-    printf("# item blocks = %d\n\n", (int) hashs_.size());
+    printf("# item blocks = %d\n",   (int) hashs_.size());
+    if (leaf_file_ != nullptr) {
+        printf("leaf file     = %g MB\n", leaf_file_->file_size_/1048576.0);
+    }
+    printf("\n");
     // for (int i = 0; i < hashs_.size(); ++i) {
     //     printf("%d (%g) ", hashs_[i]->n_, hashs_[i]->M_);
     //     if ((i+1) % 20 == 0) printf("\n");
@@ -275,72 +391,258 @@ void SA_CONE::reverse_kmips(        // reverse k-mips
     const float *query,                 // query vector
     std::vector<int> &result)           // reverse k-mips result (return)
 {
-    gettimeofday(&g_start_time, nullptr);
+    filtered_reverse_kmips(k, query, nullptr, result);
+}
+
+// -----------------------------------------------------------------------------
+void SA_CONE::set_user_attrs(       // set the attributes of users
+    const u64 *user_attrs)              // attributes of users (m)
+{
+    user_attrs_ = user_attrs;
+    std::vector<u64>().swap(block_attrs_);
+    if (user_attrs == nullptr) return;
+    
+    block_attrs_.assign(blocks_.size(), 0UL);
+    for (int j = 0; j < (int) blocks_.size(); ++j) {
+        const Cone_Node *block = blocks_[j];
+        for (int i = 0; i < block->n_; ++i) {
+            block_attrs_[j] |= user_attrs[block->index_[i]];
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+void SA_CONE::filtered_reverse_kmips(// reverse k-mips of filtered users
+    int   k,                            // top k value
+    const float *query,                 // query vector
+    const User_Filter *filter,          // filter of users (nullptr: none)
+    std::vector<int> &result)           // reverse k-mips result (return)
+{
+    search(k, query, filter, result, nullptr);
+}
+
+// -----------------------------------------------------------------------------
+void SA_CONE::rank_reverse_kmips(   // reverse k-mips with ranks of users
+    int   k,                            // top k value
+    const float *query,                 // query vector
+    std::vector<int> &result,           // reverse k-mips result (return)
+    std::vector<int> &ranks)            // rank of query for result (return)
+{
+    std::vector<int>().swap(ranks);
+    search(k, query, nullptr, result, &ranks);
+}
+
+// -----------------------------------------------------------------------------
+void SA_CONE::search(               // reverse k-mips (with ranks of users)
+    int   k,                            // top k value
+    const float *query,                 // query vector
+    const User_Filter *filter,          // filter of users (nullptr: none)
+    std::vector<int> &result,           // reverse k-mips result (return)
+    std::vector<int> *ranks)            // ranks of users (nullptr: no rank)
+{
+    Perf_Scope perf(PHASE_USER_SCAN);
+    
+    double start_time = get_time();
+    stats_.ip_count_ = 0UL;
+    stats_.prune_.reset();
+    stats_.status_ = 0;
     std::vector<int>().swap(result);// clear space for result
     assert(k > 0 && k <= k_max_);   // validate the range of k
     
     // compute l2-norm for query
     float query_norm = sqrt(calc_inner_product(d_, query, query)); 
-    ++g_ip_count;
+    ++stats_.ip_count_;
     
-    // check user_set
+    // check user_set: batch pruning for user blocks
     float item_k_norm = item_norms_[k-1]; // k-th largest item norm
     MaxK_Array *arr = new MaxK_Array(k);
     
-    for (auto block : blocks_) {
+    std::vector<int>   cand;        // candidate user blocks
+    std::vector<float> cand_cos;    // |q| cos(phi) of candidate blocks
+    std::vector<float> cand_sin;    // |q| sin(phi) of candidate blocks
+    for (int j = 0; j < (int) blocks_.size(); ++j) {
+        Cone_Node *block = blocks_[j];
+        
+        // skip the blocks with no user passing the filter (before any ip)
+        u64 attrs = block_attrs_.empty() ? 0UL : block_attrs_[j];
+        if (!pass_block(filter, attrs, block->n_, block->index_)) continue;
+        
         // lemma 3
         float block_k_lb = block->node_lower_bounds_[k-1];
-        if (query_norm < block_k_lb) continue;
+        if (query_norm < block_k_lb) {
+            ++stats_.prune_[STAGE_BLOCK_LEMMA3]; continue;
+        }
         
         // New Lemma: use node upper bound for batch pruning
-        float ip = calc_inner_product(d_, query, block->center_); ++g_ip_count;
+        float ip = calc_inner_product(d_, query, block->center_); ++stats_.ip_count_;
         float q_cos = ip / block->norm_c_;
         float q_sin = sqrt(SQR(query_norm) - SQR(q_cos));
         
         float ub = block->est_upper_bound(q_cos, q_sin);
-        if (ub < block_k_lb) continue;
+        if (ub < block_k_lb) { ++stats_.prune_[STAGE_BLOCK_CONE]; continue; }
         
-        // get user statistics from this block
-        int   m = block->n_;
-        const int   *user_index   = block->index_;
-        const float *user_set     = block->data_;
-        const float *lower_bounds = block->lower_bounds_;
+        cand.push_back(j);
+        cand_cos.push_back(q_cos);
+        cand_sin.push_back(q_sin);
+    }
+    
+    // check the users in the candidate user blocks
+    int num = (int) cand.size();
+    if (leaf_file_ == nullptr) {
+        for (int i = 0; i < num; ++i) {
+            check_user_block(k, item_k_norm, cand_cos[i], cand_sin[i], query,
+                filter, blocks_[cand[i]], nullptr, arr, result, ranks);
+        }
+    }
+    else {
+        // load the candidate blocks by batches from disk, where the next 
+        // batch is read in the background (by the i/o threads of the leaf 
+        // file) when checking the current batch; a failed batch fails the
+        // query (with an empty result)
+        int  ids[2][LEAF_BATCH];
+        char *leaves[2][LEAF_BATCH];
+        auto load = [&](int buf, int start) {
+            int cnt = std::min(LEAF_BATCH, num - start);
+            std::copy(cand.begin()+start, cand.begin()+start+cnt, ids[buf]);
+            leaf_file_->read_async(cnt, ids[buf], buffers_[buf], leaves[buf]);
+        };
         
-        for (int i = 0; i < m; ++i) {
-            // get the lower bound for this user
-            const float *lower_bound = lower_bounds + (u64) i*k_max_;
-            float user_k_lb = lower_bound[k-1];
-            
-            // 1.1 New Lemma: use point (user) upper bound for pruning
-            ub = block->est_upper_bound(i, q_cos, q_sin);
-            if (ub < user_k_lb) continue; // No
-            
-            // 1.2 use lower_bound for pruning  (lemma 1)
-            const float *user = user_set + (u64) i*d_;
-            ip = calc_inner_product(d_, query, user); ++g_ip_count;
-            if (ip < user_k_lb) continue; // No
-            
-            // 2. use item upper bound for pruning (lemma 2)
-            if (ip >= item_k_norm) { 
-                // add user id into the result of this query
-                result.push_back(user_index[i]); // Yes
+        if (num > 0) load(0, 0);
+        for (int start = 0, buf = 0; start < num; start += LEAF_BATCH) {
+            if (leaf_file_->wait()) { // wait for the current batch
+                stats_.status_ = 1; result.clear();
+                if (ranks != nullptr) ranks->clear();
+                break;
             }
-            else {
-                // init the top-k array from the lower bound of this user
-                arr->init(k, lower_bound);
-                arr->add(ip);
-                if (kmips(k, ip, user, arr) == 1) {
-                    result.push_back(user_index[i]); // Yes
-                }
+            if (start + LEAF_BATCH < num) load(1-buf, start + LEAF_BATCH);
+            int cnt = std::min(LEAF_BATCH, num - start);
+            for (int i = 0; i < cnt; ++i) {
+                int j = start + i;
+                check_user_block(k, item_k_norm, cand_cos[j], cand_sin[j], 
+                    query, filter, blocks_[cand[j]], leaves[buf][i], arr, 
+                    result, ranks);
             }
+            buf = 1 - buf;
         }
     }
     delete arr;
-    gettimeofday(&g_end_time, nullptr);
+    double end_time = get_time();
+    
+    stats_.time_ = end_time - start_time;
+}
+
+// -----------------------------------------------------------------------------
+void SA_CONE::check_user_block(     // check users in a user block
+    int   k,                            // top k value
+    float item_k_norm,                  // k-th largest item norm
+    float q_cos,                        // |q| cos(phi) of block center
+    float q_sin,                        // |q| sin(phi) of block center
+    const float *query,                 // query vector
+    const User_Filter *filter,          // filter of users (nullptr: none)
+    const Cone_Node *block,             // user block
+    const char  *leaf,                  // leaf payload (nullptr: in memory)
+    MaxK_Array  *arr,                   // top-k mips array (buffer)
+    std::vector<int> &result,           // reverse k-mips result (return)
+    std::vector<int> *ranks)            // ranks of users (nullptr: no rank)
+{
+    // get user statistics from this block (or from its leaf payload)
+    int   m = block->n_;
+    const int   *user_index   = block->index_;
+    const u64   *user_keys    = block->hash_keys_;
+    const float *user_set     = block->data_;
+    const float *x_cos        = block->x_cos_;
+    const float *x_sin        = block->x_sin_;
+    const float *lower_bounds = block->lower_bounds_;
+    if (leaf != nullptr) {
+        user_keys    = (const u64*) leaf;
+        user_set     = (const float*) (user_keys + (u64) m*srp_->m_);
+        x_cos        = user_set + (u64) m*d_;
+        x_sin        = x_cos + m;
+        lower_bounds = x_sin + m;
+    }
+    
+    for (int i = 0; i < m; ++i) {
+        if (!pass_filter(filter, user_index[i])) continue;
+        
+        // get the lower bound for this user
+        const float *lower_bound = lower_bounds + (u64) i*k_max_;
+        float user_k_lb = lower_bound[k-1];
+        
+        // 1.1 New Lemma: use point (user) upper bound for pruning
+        float ub = q_cos * x_cos[i] + q_sin * x_sin[i];
+        if (ub < user_k_lb) { ++stats_.prune_[STAGE_USER_CONE]; continue; }
+        
+        // 1.2 use lower_bound for pruning  (lemma 1)
+        const float *user = user_set + (u64) i*d_;
+        float ip = calc_inner_product(d_, query, user); ++stats_.ip_count_;
+        if (ip < user_k_lb) { ++stats_.prune_[STAGE_USER_LEMMA1]; continue; }
+        
+        // 2. use item upper bound for pruning (lemma 2), where the users 
+        //    with ranks are all ranked below
+        if (ranks == nullptr && ip >= item_k_norm) { 
+            // add user id into the result of this query
+            result.push_back(user_index[i]); // Yes
+            ++stats_.prune_[STAGE_USER_LEMMA2];
+        }
+        else { pend_.push_back(i); pend_ip_.push_back(ip); }
+    }
+    if (pend_.empty()) return;
+    
+    // 3. verify the users left by k-mips as a batch, so that the phase of 
+    //    k-mips is switched once per block
+    Perf_Scope kmips_perf(PHASE_KMIPS);
+    for (int j = 0; j < (int) pend_.size(); ++j) {
+        int   i  = pend_[j];
+        float ip = pend_ip_[j];
+        const float *user        = user_set + (u64) i*d_;
+        const u64   *user_key    = user_keys + (u64) i*srp_->m_;
+        const float *lower_bound = lower_bounds + (u64) i*k_max_;
+        
+        if (ranks != nullptr) {
+            int rank = rank_user(k, ip, user, user_key, lower_bound, arr);
+            if (rank <= k) {
+                result.push_back(user_index[i]); ranks->push_back(rank);
+            }
+            continue;
+        }
+        
+        // init the top-k array from the lower bound of this user
+        ++stats_.prune_[STAGE_USER_KMIPS];
+        arr->init(k, lower_bound);
+        arr->add(ip);
+        if (kmips(k, ip, user, user_key, arr) == 1) {
+            result.push_back(user_index[i]); // Yes
+        }
+    }
+    pend_.clear(); pend_ip_.clear();
+}
+
+// -----------------------------------------------------------------------------
+int SA_CONE::rank_user(             // rank of query for a user (k+1: not in)
+    int   k,                            // top k value
+    float uq_ip,                        // inner product of user and query
+    const float *user,                  // input user
+    const u64   *user_key,              // srp-lsh hash key of input user
+    const float *lower_bound,           // lower bounds of user (k_max)
+    MaxK_Array  *arr)                   // top-k mips array (buffer)
+{
+    // the user is not in the result for k' < k0 (lemma 1), and it is in the
+    // result for k' >= k2 (lemma 2, where user_norm = 1.0)
+    int k0 = get_rank(uq_ip, k, 1.0f, lower_bound);
+    int k2 = get_rank(uq_ip, k, 1.0f, item_norms_);
+    if (k2 <= k0) { ++stats_.prune_[STAGE_USER_LEMMA2]; return k0; }
     
-    double query_time = g_end_time.tv_sec - g_start_time.tv_sec + 
-        (g_end_time.tv_usec - g_start_time.tv_usec) / 1000000.0;
-    g_run_time += query_time;
+    // verify the largest undecided k' once, where the top-k' mips array 
+    // keeps all items whose ip is larger than uq_ip if the user is in
+    ++stats_.prune_[STAGE_USER_KMIPS];
+    int kv = k2 - 1;
+    arr->init(kv, lower_bound);
+    arr->add(uq_ip);
+    if (kmips(kv, uq_ip, user, user_key, arr) == 0) return k2;
+    
+    int rank = 1;
+    while (rank < kv && arr->ith_key(rank-1) > uq_ip) ++rank;
+    return std::max(rank, k0);
 }
 
 // -----------------------------------------------------------------------------
@@ -348,18 +650,21 @@ int SA_CONE::kmips(                 // k-mips
     int   k,                            // top-k value
     float uq_ip,                        // inner product of user and query
     const float *user,                  // input user
+    const u64   *user_key,              // srp-lsh hash key of input user
     MaxK_Array  *arr)                   // top-k mips array (return)
 {
     // initialize parameters
-    std::vector<float> sa_user(d_+1, 0.0f);
     std::vector<int> cand;
     float kip = arr->min_key();
     
     // check item_set with blocks for batch pruning
     for (auto hash : hashs_) {
         // early pruning (NOTE: as kip may NOT be true, 1 is not promising)
+        ++stats_.prune_[STAGE_ITEM_VISIT];
         float ub = hash->M_; // user_norm = 1.0
-        if (ub <= uq_ip || ub <= kip) return 1; // Yes 
+        if (ub <= uq_ip || ub <= kip) {
+            ++stats_.prune_[STAGE_ITEM_EARLY]; return 1; // Yes
+        }
         
         // k-mips
         int   n = hash->n_;
@@ -367,14 +672,11 @@ int SA_CONE::kmips(                 // k-mips
         const float *items = hash->items_;
         
         if (n > N_PTS_INDEX) {
-            // get sa-user
-            float lambda = hash->R_; // user_norm = 1.0
-            for (int j = 0; j < d_; ++j) sa_user[j] = lambda*user[j];
-            sa_user[d_] = 0.0f;
-            
-            // perform knns by srp-lsh
+            // perform knns by srp-lsh (with the pre-computed hash key of 
+            // sa-user, which is the same for all blocks)
             SRP_LSH *srp = hash->srp_;
-            srp->kmcss(k, sa_user.data(), cand);
+            srp->kmcss(k, user_key, cand);
+            ++stats_.prune_[STAGE_ITEM_LSH];
             
             // verify the candidates
             for (int id : cand) {
@@ -382,7 +684,7 @@ int SA_CONE::kmips(                 // k-mips
                 if (norms[id] >= kip) {
                     const float *item = items + (u64) id*d_;
                     float ip = calc_inner_product(d_, item, user);
-                    ++g_ip_count;
+                    ++stats_.ip_count_; ++stats_.prune_[STAGE_CANDIDATE];
                     
                     kip = arr->add(ip);
                     if (kip > uq_ip) return 0; // return No
@@ -391,6 +693,7 @@ int SA_CONE::kmips(                 // k-mips
         }
         else {
             // linear scan
+            ++stats_.prune_[STAGE_ITEM_LINEAR];
             for (int j = 0; j < n; ++j) {
                 // NOTE: since kip may NOT be the true, 1 is not promising
                 ub = norms[j]; // user_norm = 1.0
@@ -398,7 +701,7 @@ int SA_CONE::kmips(                 // k-mips
                 
                 const float *item = items + (u64) j*d_;
                 float ip = calc_inner_product(d_, item, user);
-                ++g_ip_count;
+                ++stats_.ip_count_; ++stats_.prune_[STAGE_CANDIDATE];
                 
                 kip = arr->add(ip);
                 if (kip > uq_ip) return 0; // return No
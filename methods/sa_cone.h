@@ -8,9 +8,12 @@
 
 #include "def.h"
 #include "util.h"
+#include "rkmips.h"
 #include "pri_queue.h"
 #include "block.h"
 #include "cone_tree.h"
+#include "shared_index.h"
+#include "leaf_file.h"
 
 namespace ip {
 
@@ -26,8 +29,17 @@ namespace ip {
 //  1. check user_set with blocks (with cone-tree) for batch pruning
 //  2. for each user, check item_set with blocks for batch pruning
 //  3. for each block in item_set, use srp-lsh (with sa-trans) for speedup
+//
+//  Disk-Resident Leaves (if a leaf file is given):
+//  only the skeleton of the cone-tree (with node lower bounds) is kept in 
+//  memory; the users, x_cos, x_sin, lower bounds & hash keys of the leaves 
+//  are stored in a leaf file, and only the leaves surviving the batch pruning 
+//  are loaded by batches, where the next batch is read asynchronously. Each 
+//  leaf is written as soon as it is built (by add_leaf()), so the build only
+//  holds the payload of one leaf, and reads user_set by the tree build only 
+//  (which may thus be a read-only mapping of a file)
 // -----------------------------------------------------------------------------
-class SA_CONE {
+class SA_CONE : public Reverse_KMIPS, public Leaf_Sink {
 public:
     SA_CONE(                        // constructor
         int   n,                        // item cardinality
@@ -37,8 +49,18 @@ public:
         int   K,                        // # hash tables for SRP-LSH
         int   leaf,                     // leaf size of cone-tree
         float b,                        // interval ratio for blocking items
+        int   huge,                     // backing of big arrays (HUGE_*)
         const float *item_set,          // item set
-        const float *user_set);         // user set
+        const float *user_set,          // user set
+        const char  *leaf_addr = nullptr, // address of leaf file (optional)
+        const Lower_Bounds *lb = nullptr); // precomputed lower bounds
+    
+    // -------------------------------------------------------------------------
+    SA_CONE(                        // constructor (with shared artifacts)
+        int   K,                        // # hash tables for SRP-LSH
+        int   leaf,                     // leaf size of cone-tree
+        float b,                        // interval ratio for blocking items
+        Shared_Index *shared);          // sorted items & cone-tree of users
     
     // -------------------------------------------------------------------------
     ~SA_CONE();                     // destructor
@@ -52,15 +74,46 @@ public:
         const float *query,             // query vector
         std::vector<int> &result);      // reverse k-mips result (return)
     
+    // -------------------------------------------------------------------------
+    void filtered_reverse_kmips(    // reverse k-mips of filtered users
+        int   k,                        // top k value
+        const float *query,             // query vector
+        const User_Filter *filter,      // filter of users (nullptr: none)
+        std::vector<int> &result);      // reverse k-mips result (return)
+    
+    // -------------------------------------------------------------------------
+    void rank_reverse_kmips(        // reverse k-mips with ranks of users
+        int   k,                        // top k value
+        const float *query,             // query vector
+        std::vector<int> &result,       // reverse k-mips result (return)
+        std::vector<int> &ranks);       // rank of query for result (return)
+    
+    // -------------------------------------------------------------------------
+    void set_user_attrs(            // set the attributes of users
+        const u64 *user_attrs);         // attributes of users (m)
+    
+    // -------------------------------------------------------------------------
+    void add_leaf(                  // build the payload of a user block
+        Cone_Tree *tree,                // cone-tree (arena_ & leaf_arena_)
+        Cone_Node *leaf);               // user block (with users)
+    
     // -------------------------------------------------------------------------
     u64 get_estimated_memory() {    // get memory usage
         u64 ret = 0;
         ret += sizeof(*this);
         ret += (sizeof(int)+sizeof(float))*n_; // item_index_ & item_norms_
+        if (shared_ == nullptr) ret += sizeof(float)*n_*d_; // item_set_
+        ret += srp_->get_estimated_memory(); // shared srp_
         for (auto hash : hashs_) {  // hashs_
             ret += hash->get_estimated_memory();
         }
         ret += tree_->get_estimated_memory();
+        if (leaf_file_ == nullptr) { // hash_keys_ of users in leaves
+            ret += sizeof(u64)*m_*srp_->m_;
+        } else { // leaf file & double buffers for batch reads
+            ret += leaf_file_->get_estimated_memory();
+            ret += 2*leaf_file_->max_size_*LEAF_BATCH;
+        }
         
         return ret;
     }
@@ -78,9 +131,18 @@ protected:
     float *item_norms_;             // sorted item l2-norms
     int   *item_index_;             // sorted item index
     std::vector<Item_Block*> hashs_;// lsh index for item blocks
+    SRP_LSH *srp_;                  // srp-lsh functions shared by item blocks
     
     Cone_Tree *tree_;               // cone-tree
     std::vector<Cone_Node*> blocks_;// user blocks
+    std::vector<u64> block_attrs_;  // summary (OR) of attributes of blocks_
+    Leaf_File *leaf_file_;          // leaf file of user blocks (optional)
+    char  *buffers_[2];             // double buffers for batch reads
+    Shared_Index *shared_;          // shared artifacts (nullptr: owned)
+    int   n0_;                      // # items for lower bounds (by the build)
+    const Lower_Bounds *lb_;        // precomputed lower bounds (by the build)
+    std::vector<int>   pend_;       // users of a block left to k-mips
+    std::vector<float> pend_ip_;    // inner products of users of pend_
     
     // -------------------------------------------------------------------------
     void compute_norm_and_sort(     // compute norm and sort data (descending)
@@ -89,7 +151,8 @@ protected:
     // -------------------------------------------------------------------------
     void blocking_user_set(         // build blocks (with cone-tree) for user_set
         int   n0,                       // the first n0 elements in item_set
-        const float *user_set);         // user_set
+        const float *user_set,          // user_set
+        const Lower_Bounds *lb);        // precomputed lower bounds (optional)
         
     // -------------------------------------------------------------------------
     void lower_bounds_computation(  // compute lower bounds for users
@@ -123,11 +186,43 @@ protected:
         const float *norms,             // l2-norm of items
         const float *items);            // items 
     
+    // -------------------------------------------------------------------------
+    void search(                    // reverse k-mips (with ranks of users)
+        int   k,                        // top k value
+        const float *query,             // query vector
+        const User_Filter *filter,      // filter of users (nullptr: none)
+        std::vector<int> &result,       // reverse k-mips result (return)
+        std::vector<int> *ranks);       // ranks of users (nullptr: no rank)
+    
+    // -------------------------------------------------------------------------
+    void check_user_block(          // check users in a user block
+        int   k,                        // top k value
+        float item_k_norm,              // k-th largest item norm
+        float q_cos,                    // |q| cos(phi) of block center
+        float q_sin,                    // |q| sin(phi) of block center
+        const float *query,             // query vector
+        const User_Filter *filter,      // filter of users (nullptr: none)
+        const Cone_Node *block,         // user block
+        const char  *leaf,              // leaf payload (nullptr: in memory)
+        MaxK_Array  *arr,               // top-k mips array (buffer)
+        std::vector<int> &result,       // reverse k-mips result (return)
+        std::vector<int> *ranks);       // ranks of users (nullptr: no rank)
+    
+    // -------------------------------------------------------------------------
+    int rank_user(                  // rank of query for a user (k+1: not in)
+        int   k,                        // top k value
+        float uq_ip,                    // inner product of user and query
+        const float *user,              // input user
+        const u64   *user_key,          // srp-lsh hash key of input user
+        const float *lower_bound,       // lower bounds of user (k_max)
+        MaxK_Array  *arr);              // top-k mips array (buffer)
+    
     // -------------------------------------------------------------------------
     int kmips(                      // k-mips
         int   k,                        // top-k value
         float uq_ip,                    // inner product of user and query
         const float *user,              // input user
+        const u64   *user_key,          // srp-lsh hash key of input user
         MaxK_Array  *arr);              // top-k mips array (return)
 };
 
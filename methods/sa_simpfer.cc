@@ -11,42 +11,97 @@ SA_Simpfer::SA_Simpfer(             // constructor
     int   k_max,                        // max k value
     int   K,                            // # hash tables for SRP-LSH
     float b,                            // interval ratio for blocking itemss
+    int   huge,                         // backing of big arrays (HUGE_*)
     const float *item_set,              // item set
-    const float *user_set)              // user set
-    : n_(n), m_(m), d_(d), k_max_(k_max), K_(K), b_(b)
+    const float *user_set,              // user set
+    const Lower_Bounds *lb)             // precomputed lower bounds
+    : Reverse_KMIPS(ALG_SA_SIMPFER, n, m, d, k_max, K, -1, b, huge), n_(n), 
+    m_(m), d_(d), k_max_(k_max), K_(K), b_(b), shared_(nullptr)
 {
-    gettimeofday(&g_start_time, nullptr);
+    timeval start_time, end_time;
+    gettimeofday(&start_time, nullptr);
     
     // 1. compute l2-norms & sort item_set in descending order of l2-norms
     item_index_ = new int[n];
     item_norms_ = new float[n];
-    item_set_   = new float[(u64) n*d];
+    item_set_   = new_huge<float>((u64) n*d, alloc_);
     compute_norm_and_sort(n, item_set, item_index_, item_norms_, item_set_);
     
     // 2. compute l2-norms & sort user_set in descending order of l2-norms
     user_index_ = new int[m];
     user_norms_ = new float[m];
-    user_set_   = new float[(u64) m*d];
+    user_set_   = new_huge<float>((u64) m*d, alloc_);
     compute_norm_and_sort(m, user_set, user_index_, user_norms_, user_set_);
     
     // 3. determine k_max approximate mips results as lower bounds for user_set
     int n0 = k_max*COEFF; // only consider the first n0 elements in item_set
     if (n0 > n) n0 = n;
     
-    lower_bounds_ = new float[(u64) m*k_max];
-    lower_bounds_computation(n0);
+    lower_bounds_ = new_huge<float>((u64) m*k_max, alloc_);
+    if (lb != nullptr) { // load the precomputed lower bounds (with its n0)
+        assert(lb->m_ == m && lb->d_ == d && lb->k_max_ == k_max);
+        n0 = lb->n0_;
+        lb->copy(false, m, user_index_, lower_bounds_);
+    }
+    else lower_bounds_computation(n0);
     
-    // 4. build blocks for user_set for batch pruning
-    blocking_user_set();
+    // 4-6. build blocks for user_set & the rest item_set
+    build_blocks(n0);
+    
+    // get the pre-processing time
+    gettimeofday(&end_time, nullptr);
+    pre_time_ = end_time.tv_sec - start_time.tv_sec + 
+        (end_time.tv_usec - start_time.tv_usec) / 1000000.0;
+}
+
+// -----------------------------------------------------------------------------
+SA_Simpfer::SA_Simpfer(             // constructor (with shared artifacts)
+    int   K,                            // # hash tables for SRP-LSH
+    float b,                            // interval ratio for blocking items
+    Shared_Index *shared)               // sorted items, users & lower bounds
+    : Reverse_KMIPS(ALG_SA_SIMPFER, shared->n_, shared->m_, shared->d_, 
+    shared->k_max_, K, -1, b, shared->alloc_.mode_), n_(shared->n_), 
+    m_(shared->m_), d_(shared->d_), k_max_(shared->k_max_), K_(K), b_(b), 
+    shared_(shared)
+{
+    timeval start_time, end_time;
+    gettimeofday(&start_time, nullptr);
     
-    // 5. build blocks for the rest item_set (with sa-trans) for batch pruning
-    blocking_item_set(n-n0, item_norms_+n0, item_set_+(u64)n0*d);
+    // 1-3. use the sorted item_set & user_set and the lower bounds for 
+    //      user_set from the shared artifacts
+    shared->prepare_sorted_users();
+    item_index_   = shared->item_index_;
+    item_norms_   = shared->item_norms_;
+    item_set_     = shared->item_set_;
+    user_index_   = shared->user_index_;
+    user_norms_   = shared->user_norms_;
+    user_set_     = shared->user_set_;
+    lower_bounds_ = shared->lower_bounds_;
     
-    // get the pre-processing time and estimated memory
-    gettimeofday(&g_end_time, nullptr);
-    g_pre_time = g_end_time.tv_sec - g_start_time.tv_sec + 
-        (g_end_time.tv_usec - g_start_time.tv_usec) / 1000000.0;
-    g_memory = get_estimated_memory();
+    // 4-6. build blocks for user_set & the rest item_set
+    build_blocks(shared->n0_);
+    
+    // get the pre-processing time (excluding the shared artifacts)
+    gettimeofday(&end_time, nullptr);
+    pre_time_ = end_time.tv_sec - start_time.tv_sec + 
+        (end_time.tv_usec - start_time.tv_usec) / 1000000.0;
+}
+
+// -----------------------------------------------------------------------------
+void SA_Simpfer::build_blocks(      // build user blocks & item blocks
+    int n0)                             // the first n0 elements in item_set
+{
+    // 4. compute srp-lsh hash keys for user_set (with the srp-lsh functions 
+    //    & lookup table shared by all item blocks)
+    srp_ = new SRP_LSH(0, d_+1, K_, alloc_);
+    user_keys_ = new_huge<u64>((u64) m_*srp_->m_, alloc_);
+    srp_->calc_hash_keys(m_, user_set_, user_keys_);
+    
+    // 5. build blocks for user_set for batch pruning
+    blocking_user_set();
+    
+    // 6. build blocks for the rest item_set (with sa-trans) for batch pruning
+    blocking_item_set(n_-n0, item_norms_+n0, item_set_+(u64)n0*d_);
 }
 
 // -----------------------------------------------------------------------------
@@ -57,6 +112,8 @@ void SA_Simpfer::compute_norm_and_sort(// compute l2-norm and sort (descending)
     float *data_norms,                  // l2-norm of sorted data (return)
     float *data_set)                    // sorted data (return)
 {
+    Perf_Scope perf(PHASE_NORM_SORT);
+    
     // compute l2-norm for input_set
     Result *ret = new Result[n];
     for (int i = 0; i < n; ++i) {
@@ -82,6 +139,8 @@ void SA_Simpfer::compute_norm_and_sort(// compute l2-norm and sort (descending)
 void SA_Simpfer::lower_bounds_computation(// compute lower bounds for user_set
     int n0)                             // the first n0 elements in item_set
 {
+    Perf_Scope perf(PHASE_LOWER_BOUNDS);
+    
     MaxK_Array *arr = new MaxK_Array(k_max_);
     for (int i = 0; i < m_; ++i) {
         // get user vector and its l2-norm
@@ -118,6 +177,8 @@ void SA_Simpfer::update_lower_bound(// update lower bound
 // -----------------------------------------------------------------------------
 void SA_Simpfer::blocking_user_set()// split the user_set into blocks
 {
+    Perf_Scope perf(PHASE_TREE_BUILD);
+    
     // clear blocks & calc block size
     blocks_.clear();
     block_size_ = (int) ceil(log2((double)m_)*20.0);
@@ -131,7 +192,8 @@ void SA_Simpfer::blocking_user_set()// split the user_set into blocks
         
         // add a new block
         User_Block *block = new User_Block(block_size, k_max_, user_index_+i,
-            user_norms_+i, user_set_+(u64)i*d_, lower_bounds_+(u64)i*k_max_);
+            user_norms_+i, user_set_+(u64)i*d_, lower_bounds_+(u64)i*k_max_,
+            user_keys_+(u64)i*srp_->m_);
         blocks_.push_back(block);
     }
 }
@@ -142,6 +204,8 @@ void SA_Simpfer::blocking_item_set( // split the rest item_set into blocks
     const float *item_norms,            // item l2-norms
     const float *item_set)              // item set
 {
+    Perf_Scope perf(PHASE_HASHING);
+    
     hashs_.clear();
     
     // split item_set into blocks and build qalsh for each block
@@ -189,8 +253,8 @@ void SA_Simpfer::add_block_by_items(// add one block by items
             shift_norms);
         block->R_ = sqrt(R);
         
-        // build hash tables for srp-lsh
-        block->srp_ = new SRP_LSH(n, d_+1, K_);
+        // build hash tables for srp-lsh (with the shared srp-lsh functions)
+        block->srp_ = new SRP_LSH(n, srp_, alloc_);
         
         SRP_LSH *srp = block->srp_;
         bool *hash_code = new bool[K_];
@@ -223,18 +287,20 @@ SA_Simpfer::~SA_Simpfer()           // destructor
 {
     for (auto hash : hashs_) { delete hash; hash = nullptr; }
     std::vector<Item_Block*>().swap(hashs_);
-    
-    if (!item_set_)     { delete[] item_set_;     item_set_     = nullptr; }
-    if (!item_norms_)   { delete[] item_norms_;   item_norms_   = nullptr; }
-    if (!item_index_)   { delete[] item_index_;   item_index_   = nullptr; }
+    if (srp_ != nullptr) { delete srp_; srp_ = nullptr; }
     
     for (auto block : blocks_) { delete block; block = nullptr; }
     std::vector<User_Block*>().swap(blocks_);
+    delete_huge(user_keys_);
     
-    if (!user_set_)     { delete[] user_set_;     user_set_     = nullptr; }
-    if (!user_norms_)   { delete[] user_norms_;   user_norms_   = nullptr; }
-    if (!user_index_)   { delete[] user_index_;   user_index_   = nullptr; }
-    if (!lower_bounds_) { delete[] lower_bounds_; lower_bounds_ = nullptr; }
+    if (shared_ == nullptr) { // the sorted items & users are owned
+        delete_huge(item_set_); delete[] item_norms_; delete[] item_index_;
+        delete_huge(user_set_); delete[] user_norms_; delete[] user_index_;
+        delete_huge(lower_bounds_);
+    }
+    item_set_ = nullptr; item_norms_ = nullptr; item_index_ = nullptr;
+    user_set_ = nullptr; user_norms_ = nullptr; user_index_ = nullptr;
+    lower_bounds_ = nullptr; shared_ = nullptr;
 }
 
 // -------------------------------------------------------------------------
@@ -263,22 +329,85 @@ void SA_Simpfer::reverse_kmips(     // reverse k-mips
     const float *query,                 // query vector
     std::vector<int> &result)           // reverse k-mips result (return)
 {
-    gettimeofday(&g_start_time, nullptr);
+    filtered_reverse_kmips(k, query, nullptr, result);
+}
+
+// -----------------------------------------------------------------------------
+void SA_Simpfer::set_user_attrs(    // set the attributes of users
+    const u64 *user_attrs)              // attributes of users (m)
+{
+    user_attrs_ = user_attrs;
+    std::vector<u64>().swap(block_attrs_);
+    if (user_attrs == nullptr) return;
+    
+    block_attrs_.assign(blocks_.size(), 0UL);
+    for (int j = 0; j < (int) blocks_.size(); ++j) {
+        const User_Block *block = blocks_[j];
+        for (int i = 0; i < block->m_; ++i) {
+            block_attrs_[j] |= user_attrs[block->index_[i]];
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+void SA_Simpfer::filtered_reverse_kmips(// reverse k-mips of filtered users
+    int   k,                            // top k value
+    const float *query,                 // query vector
+    const User_Filter *filter,          // filter of users (nullptr: none)
+    std::vector<int> &result)           // reverse k-mips result (return)
+{
+    search(k, query, filter, result, nullptr);
+}
+
+// -----------------------------------------------------------------------------
+void SA_Simpfer::rank_reverse_kmips(// reverse k-mips with ranks of users
+    int   k,                            // top k value
+    const float *query,                 // query vector
+    std::vector<int> &result,           // reverse k-mips result (return)
+    std::vector<int> &ranks)            // rank of query for result (return)
+{
+    std::vector<int>().swap(ranks);
+    search(k, query, nullptr, result, &ranks);
+}
+
+// -----------------------------------------------------------------------------
+void SA_Simpfer::search(            // reverse k-mips (with ranks of users)
+    int   k,                            // top k value
+    const float *query,                 // query vector
+    const User_Filter *filter,          // filter of users (nullptr: none)
+    std::vector<int> &result,           // reverse k-mips result (return)
+    std::vector<int> *ranks)            // ranks of users (nullptr: no rank)
+{
+    Perf_Scope perf(PHASE_USER_SCAN);
+    
+    double start_time = get_time();
+    stats_.ip_count_ = 0UL;
+    stats_.prune_.reset();
     std::vector<int>().swap(result);// clear space for result
     assert(k > 0 && k <= k_max_);   // validate the range of k
     
     // compute l2-norm for query
     float query_norm = sqrt(calc_inner_product(d_, query, query)); 
-    ++g_ip_count;
+    ++stats_.ip_count_;
     
     // check user_set with blocks for batch pruning
     float item_k_norm = item_norms_[k-1]; // k-th largest item norm
     MaxK_Array *arr = new MaxK_Array(k);
+    std::vector<int>   pend;        // users of a block left to k-mips
+    std::vector<float> pend_ip;     // inner products of users of pend
     
-    for (auto block : blocks_) {
+    for (int j = 0; j < (int) blocks_.size(); ++j) {
+        User_Block *block = blocks_[j];
+        
+        // skip the blocks with no user passing the filter (before any ip)
+        u64 attrs = block_attrs_.empty() ? 0UL : block_attrs_[j];
+        if (!pass_block(filter, attrs, block->m_, block->index_)) continue;
+        
         // lemma 3
         float ub = query_norm * block->norms_[0];
-        if (ub < block->block_lower_bounds_[k-1]) continue;
+        if (ub < block->block_lower_bounds_[k-1]) {
+            ++stats_.prune_[STAGE_BLOCK_LEMMA3]; continue;
+        }
         
         // get user statistics from this block
         int   m = block->m_;
@@ -286,43 +415,103 @@ void SA_Simpfer::reverse_kmips(     // reverse k-mips
         const float *user_norms   = block->norms_;
         const float *user_set     = block->users_;
         const float *lower_bounds = block->lower_bounds_;
+        const u64   *user_keys    = block->hash_keys_;
         
         for (int i = 0; i < m; ++i) {
+            if (!pass_filter(filter, user_index[i])) continue;
+            
             // get the lower bound for this user
             const float *lower_bound = lower_bounds + (u64) i*k_max_;
             float user_norm = user_norms[i];
             
             // 1.1 as <q,u> <= |q|*|u|, use lower_buond for pruning (lemma 1*)
             ub = query_norm * user_norm; 
-            if (ub < lower_bound[k-1]) continue; // No
+            if (ub < lower_bound[k-1]) {
+                ++stats_.prune_[STAGE_USER_CONE]; continue; // No
+            }
             
             // 1.2 use lower_bound for pruning  (lemma 1)
             const float *user = user_set + (u64) i*d_;
-            float ip = calc_inner_product(d_, query, user); ++g_ip_count;
-            if (ip < lower_bound[k-1]) continue; // No
+            float ip = calc_inner_product(d_, query, user); ++stats_.ip_count_;
+            if (ip < lower_bound[k-1]) {
+                ++stats_.prune_[STAGE_USER_LEMMA1]; continue; // No
+            }
             
-            // 2. use item upper bound for pruning (lemma 2)
+            // 2. use item upper bound for pruning (lemma 2), where the users
+            //    with ranks are all ranked below
             ub = user_norm * item_k_norm;
-            if (ip >= ub) { 
+            if (ranks == nullptr && ip >= ub) { 
                 // add user id into the result of this query
                 result.push_back(user_index[i]); // Yes
+                ++stats_.prune_[STAGE_USER_LEMMA2];
             }
-            else {
-                // init the top-k array from the lower bound of this user
-                arr->init(k, lower_bound);
-                arr->add(ip);
-                if (kmips(k, ip, user_norm, user, arr) == 1) {
-                    result.push_back(user_index[i]); // Yes
+            else { pend.push_back(i); pend_ip.push_back(ip); }
+        }
+        if (pend.empty()) continue;
+        
+        // 3. verify the users left by k-mips as a batch, so that the phase 
+        //    of k-mips is switched once per block
+        Perf_Scope kmips_perf(PHASE_KMIPS);
+        for (int x = 0; x < (int) pend.size(); ++x) {
+            int   i  = pend[x];
+            float ip = pend_ip[x];
+            float user_norm = user_norms[i];
+            const float *user        = user_set + (u64) i*d_;
+            const u64   *user_key    = user_keys + (u64) i*srp_->m_;
+            const float *lower_bound = lower_bounds + (u64) i*k_max_;
+            
+            if (ranks != nullptr) {
+                int rank = rank_user(k, ip, user_norm, user, user_key, 
+                    lower_bound, arr);
+                if (rank <= k) {
+                    result.push_back(user_index[i]); ranks->push_back(rank);
                 }
+                continue;
+            }
+            
+            // init the top-k array from the lower bound of this user
+            ++stats_.prune_[STAGE_USER_KMIPS];
+            arr->init(k, lower_bound);
+            arr->add(ip);
+            if (kmips(k, ip, user_norm, user, user_key, arr) == 1) {
+                result.push_back(user_index[i]); // Yes
             }
         }
+        pend.clear(); pend_ip.clear();
     }
     delete arr;
-    gettimeofday(&g_end_time, nullptr);
+    double end_time = get_time();
     
-    double query_time = g_end_time.tv_sec - g_start_time.tv_sec + 
-        (g_end_time.tv_usec - g_start_time.tv_usec) / 1000000.0;
-    g_run_time += query_time;
+    stats_.time_ = end_time - start_time;
+}
+
+// -----------------------------------------------------------------------------
+int SA_Simpfer::rank_user(          // rank of query for a user (k+1: not in)
+    int   k,                            // top k value
+    float uq_ip,                        // inner product of user and query
+    float user_norm,                    // l2-norm of input user
+    const float *user,                  // input user
+    const u64   *user_key,              // srp-lsh hash key of input user
+    const float *lower_bound,           // lower bounds of user (k_max)
+    MaxK_Array  *arr)                   // top-k mips array (buffer)
+{
+    // the user is not in the result for k' < k0 (lemma 1), and it is in the
+    // result for k' >= k2 (lemma 2)
+    int k0 = get_rank(uq_ip, k, 1.0f, lower_bound);
+    int k2 = get_rank(uq_ip, k, user_norm, item_norms_);
+    if (k2 <= k0) { ++stats_.prune_[STAGE_USER_LEMMA2]; return k0; }
+    
+    // verify the largest undecided k' once, where the top-k' mips array 
+    // keeps all items whose ip is larger than uq_ip if the user is in
+    ++stats_.prune_[STAGE_USER_KMIPS];
+    int kv = k2 - 1;
+    arr->init(kv, lower_bound);
+    arr->add(uq_ip);
+    if (kmips(kv, uq_ip, user_norm, user, user_key, arr) == 0) return k2;
+    
+    int rank = 1;
+    while (rank < kv && arr->ith_key(rank-1) > uq_ip) ++rank;
+    return std::max(rank, k0);
 }
 
 // -----------------------------------------------------------------------------
@@ -331,19 +520,22 @@ int SA_Simpfer::kmips(              // k-mips
     float uq_ip,                        // inner product of user and query
     float user_norm,                    // l2-norm of input user
     const float *user,                  // input user
+    const u64   *user_key,              // srp-lsh hash key of input user
     MaxK_Array  *arr)                   // top-k mips array (return)
 {
     // initialize parameters
-    std::vector<float> sa_user(d_+1, 0.0f);
     std::vector<int> cand;
     float kip = arr->min_key();
     
     // check item_set with blocks for batch pruning
     for (auto hash : hashs_) {
         // early pruning (NOTE: as kip may NOT be  true, 1 is not promising)
+        ++stats_.prune_[STAGE_ITEM_VISIT];
         float M = hash->M_;
         float ub = M * user_norm;
-        if (ub <= uq_ip || ub <= kip) return 1; // Yes 
+        if (ub <= uq_ip || ub <= kip) {
+            ++stats_.prune_[STAGE_ITEM_EARLY]; return 1; // Yes
+        }
         
         // k-mips
         int   n = hash->n_;
@@ -351,14 +543,11 @@ int SA_Simpfer::kmips(              // k-mips
         const float *items = hash->items_;
         
         if (n > N_PTS_INDEX) {
-            // get sa-user
-            float lambda = hash->R_ / user_norm;
-            for (int j = 0; j < d_; ++j) sa_user[j] = lambda*user[j];
-            sa_user[d_] = 0.0f;
-            
-            // perform knns by srp-lsh
+            // perform knns by srp-lsh (with the pre-computed hash key of 
+            // sa-user, which is the same for all blocks)
             SRP_LSH *srp = hash->srp_;
-            srp->kmcss(k, sa_user.data(), cand);
+            srp->kmcss(k, user_key, cand);
+            ++stats_.prune_[STAGE_ITEM_LSH];
             
             // verify the candidates
             for (int id : cand) {
@@ -366,7 +555,7 @@ int SA_Simpfer::kmips(              // k-mips
                 if (norms[id] * user_norm >= kip) {
                     const float *item = items + (u64) id*d_;
                     float ip = calc_inner_product(d_, item, user);
-                    ++g_ip_count;
+                    ++stats_.ip_count_; ++stats_.prune_[STAGE_CANDIDATE];
                     
                     kip = arr->add(ip);
                     if (kip > uq_ip) return 0; // return No
@@ -375,6 +564,7 @@ int SA_Simpfer::kmips(              // k-mips
         }
         else {
             // linear scan
+            ++stats_.prune_[STAGE_ITEM_LINEAR];
             for (int j = 0; j < n; ++j) {
                 // NOTE: since kip may NOT be the true, 1 is not promising
                 ub = norms[j] * user_norm;
@@ -382,7 +572,7 @@ int SA_Simpfer::kmips(              // k-mips
                 
                 const float *item = items + (u64) j*d_;
                 float ip = calc_inner_product(d_, item, user);
-                ++g_ip_count;
+                ++stats_.ip_count_; ++stats_.prune_[STAGE_CANDIDATE];
                 
                 kip = arr->add(ip);
                 if (kip > uq_ip) return 0; // return No
@@ -8,8 +8,10 @@
 
 #include "def.h"
 #include "util.h"
+#include "rkmips.h"
 #include "pri_queue.h"
 #include "block.h"
+#include "shared_index.h"
 
 namespace ip {
 
@@ -28,7 +30,7 @@ namespace ip {
 //  2. for each user, check item_set with blocks for batch pruning
 //  3. for each block in item_set, use srp-lsh (with sa-trans) for speedup
 // -----------------------------------------------------------------------------
-class SA_Simpfer {
+class SA_Simpfer : public Reverse_KMIPS {
 public:
     SA_Simpfer(                     // constructor
         int   n,                        // item cardinality
@@ -37,8 +39,16 @@ public:
         int   k_max,                    // max k value
         int   K,                        // # hash tables for SRP-LSH
         float b,                        // interval ratio for blocking items
+        int   huge,                     // backing of big arrays (HUGE_*)
         const float *item_set,          // item set
-        const float *user_set);         // user set
+        const float *user_set,          // user set
+        const Lower_Bounds *lb = nullptr); // precomputed lower bounds
+    
+    // -------------------------------------------------------------------------
+    SA_Simpfer(                     // constructor (with shared artifacts)
+        int   K,                        // # hash tables for SRP-LSH
+        float b,                        // interval ratio for blocking items
+        Shared_Index *shared);          // sorted items, users & lower bounds
     
     // -------------------------------------------------------------------------
     ~SA_Simpfer();                  // destructor
@@ -52,13 +62,36 @@ public:
         const float *query,             // query vector
         std::vector<int> &result);      // reverse k-mips result (return)
     
+    // -------------------------------------------------------------------------
+    void filtered_reverse_kmips(    // reverse k-mips of filtered users
+        int   k,                        // top k value
+        const float *query,             // query vector
+        const User_Filter *filter,      // filter of users (nullptr: none)
+        std::vector<int> &result);      // reverse k-mips result (return)
+    
+    // -------------------------------------------------------------------------
+    void rank_reverse_kmips(        // reverse k-mips with ranks of users
+        int   k,                        // top k value
+        const float *query,             // query vector
+        std::vector<int> &result,       // reverse k-mips result (return)
+        std::vector<int> &ranks);       // rank of query for result (return)
+    
+    // -------------------------------------------------------------------------
+    void set_user_attrs(            // set the attributes of users
+        const u64 *user_attrs);         // attributes of users (m)
+    
     // -------------------------------------------------------------------------
     u64 get_estimated_memory() {    // get memory usage
         u64 ret = 0;
         ret += sizeof(*this);
         ret += (sizeof(int)+sizeof(float))*n_; // item_index_ & item_norms_
         ret += (sizeof(int)+sizeof(float))*m_; // user_index_ & user_norms_
+        if (shared_ == nullptr) {       // item_set_ & user_set_
+            ret += sizeof(float)*(n_+m_)*d_;
+        }
         ret += sizeof(float)*m_*k_max_; // lower_bounds_
+        ret += sizeof(u64)*m_*srp_->m_; // user_keys_
+        ret += srp_->get_estimated_memory(); // shared srp_
         for (auto hash : hashs_) {      // hashs_
             ret += hash->get_estimated_memory();
         }
@@ -80,14 +113,22 @@ protected:
     float *item_norms_;             // sorted item l2-norms
     int   *item_index_;             // sorted item index
     std::vector<Item_Block*> hashs_;// lsh index for item blocks
+    SRP_LSH *srp_;                  // srp-lsh functions shared by item blocks
     
     float *user_set_;               // sorted user vectors
     float *user_norms_;             // sorted user l2-norms
     int   *user_index_;             // sorted user index
     float *lower_bounds_;           // lower bounds for sorted user vectors
+    u64   *user_keys_;              // srp-lsh hash keys for sorted user vectors
     
     int   block_size_;              // block size of users
     std::vector<User_Block*> blocks_;// user blocks
+    std::vector<u64> block_attrs_;  // summary (OR) of attributes of blocks_
+    Shared_Index *shared_;          // shared artifacts (nullptr: owned)
+    
+    // -------------------------------------------------------------------------
+    void build_blocks(              // build user blocks & item blocks
+        int n0);                        // the first n0 elements in item_set
     
     // -------------------------------------------------------------------------
     void compute_norm_and_sort(     // compute norm and sort data (descending)
@@ -123,12 +164,31 @@ protected:
         const float *norms,             // l2-norm of items
         const float *items);            // items 
     
+    // -------------------------------------------------------------------------
+    void search(                    // reverse k-mips (with ranks of users)
+        int   k,                        // top k value
+        const float *query,             // query vector
+        const User_Filter *filter,      // filter of users (nullptr: none)
+        std::vector<int> &result,       // reverse k-mips result (return)
+        std::vector<int> *ranks);       // ranks of users (nullptr: no rank)
+    
+    // -------------------------------------------------------------------------
+    int rank_user(                  // rank of query for a user (k+1: not in)
+        int   k,                        // top k value
+        float uq_ip,                    // inner product of user and query
+        float user_norm,                // l2-norm of input user
+        const float *user,              // input user
+        const u64   *user_key,          // srp-lsh hash key of input user
+        const float *lower_bound,       // lower bounds of user (k_max)
+        MaxK_Array  *arr);              // top-k mips array (buffer)
+    
     // -------------------------------------------------------------------------
     int kmips(                      // k-mips
         int   k,                        // top-k value
         float uq_ip,                    // inner product of user and query
         float user_norm,                // l2-norm of input user
         const float *user,              // input user
+        const u64   *user_key,          // srp-lsh hash key of input user
         MaxK_Array  *arr);              // top-k mips array (return)
 };
 
@@ -0,0 +1,159 @@
+#include "scheduler.h"
+
+#include <chrono>
+
+namespace ip {
+
+// -----------------------------------------------------------------------------
+Scheduler::Scheduler(               // constructor
+    Reverse_KMIPS *index,               // index of reverse k-mips
+    int   max_batch,                    // max # queries of a batch
+    double max_delay)                   // max queueing delay (ms)
+    : index_(index), d_(index->param_.d_), max_batch_(max_batch),
+    max_delay_(max_delay / 1000.0), stop_(false), batch_count_(0UL),
+    query_count_(0UL), total_queue_time_(0.0), max_queue_time_(0.0)
+{
+    assert(max_batch_ > 0 && max_delay_ >= 0.0);
+    dispatcher_ = std::thread(&Scheduler::dispatch, this);
+}
+
+// -----------------------------------------------------------------------------
+Scheduler::~Scheduler()             // destructor
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    arrive_cv_.notify_all();
+    dispatcher_.join();
+}
+
+// -----------------------------------------------------------------------------
+void Scheduler::display()           // display parameters & statistics
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    double avg_batch = batch_count_ > 0 ? (double) query_count_/batch_count_
+        : 0.0;
+    double avg_queue = query_count_ > 0 ? total_queue_time_/query_count_ : 0.0;
+    
+    printf("Parameters of Scheduler:\n");
+    printf("max batch   = %d\n",  max_batch_);
+    printf("max delay   = %g ms\n", max_delay_*1000.0);
+    printf("batches     = %lu\n", batch_count_);
+    printf("queries     = %lu\n", query_count_);
+    printf("avg batch   = %g\n",  avg_batch);
+    printf("avg queue   = %g ms\n", avg_queue*1000.0);
+    printf("max queue   = %g ms\n", max_queue_time_*1000.0);
+    printf("\n");
+}
+
+// -----------------------------------------------------------------------------
+void Scheduler::submit(             // submit a query and wait for its result
+    int   k,                            // top k value
+    const float *query,                 // query vector
+    const User_Filter *filter,          // filter of users (nullptr: none)
+    std::vector<int> &result,           // reverse k-mips result (return)
+    Query_Stats &stats,                 // stats of the query (return)
+    double &queue_time)                 // queueing time (seconds) (return)
+{
+    Request req;
+    req.k_ = k; req.query_ = query; req.filter_ = filter;
+    req.result_ = &result; req.stats_ = &stats;
+    req.queue_time_ = 0.0; req.done_ = false;
+    req.arrival_ = get_time();
+    
+    std::unique_lock<std::mutex> lock(mutex_);
+    queue_.push_back(&req);
+    arrive_cv_.notify_one();
+    done_cv_.wait(lock, [&req] { return req.done_; });
+    
+    queue_time = req.queue_time_;
+}
+
+// -----------------------------------------------------------------------------
+int Scheduler::count_same_batch(    // count the waiting queries of a batch
+    const Request *first)               // the first query of the batch
+{
+    int cnt = 0;
+    for (Request *req : queue_) if (same_batch(req, first)) ++cnt;
+    return cnt;
+}
+
+// -----------------------------------------------------------------------------
+void Scheduler::dispatch()          // dispatch batches until stopped
+{
+    std::vector<Request*> batch;
+    std::vector<std::vector<int> > results;
+    std::vector<Query_Stats> stats(max_batch_);
+    float *query_set = new float[(u64) max_batch_*d_];
+    
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        arrive_cv_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+        if (queue_.empty()) break; // stopped
+        
+        // wait for a full batch of the k (and the filter) of the oldest query,
+        // or until the oldest query has waited for max_delay
+        Request *oldest = queue_.front();
+        int k = oldest->k_;
+        const User_Filter *filter = oldest->filter_;
+        while (!stop_ && count_same_batch(oldest) < max_batch_) {
+            double wait = max_delay_ - (get_time() - oldest->arrival_);
+            if (wait <= 0.0) break;
+            
+            arrive_cv_.wait_for(lock, std::chrono::microseconds(
+                (u64) (wait * 1000000.0) + 1));
+        }
+        
+        // take the queries of the batch in the order of arrival
+        batch.clear();
+        for (auto it = queue_.begin(); it != queue_.end() &&
+            (int) batch.size() < max_batch_; ) {
+            if (same_batch(*it, oldest)) {
+                batch.push_back(*it); it = queue_.erase(it);
+            }
+            else ++it;
+        }
+        double now = get_time();
+        int num = (int) batch.size();
+        for (int i = 0; i < num; ++i) {
+            Request *req = batch[i];
+            req->queue_time_ = now - req->arrival_;
+            
+            total_queue_time_ += req->queue_time_;
+            max_queue_time_ = std::max(max_queue_time_, req->queue_time_);
+            memcpy(query_set + (u64) i*d_, req->query_, sizeof(float)*d_);
+        }
+        ++batch_count_; query_count_ += num;
+        
+        // answer the batch without the lock, so that the queries keep arriving
+        lock.unlock();
+        if (filter == nullptr) {
+            index_->batch_reverse_kmips(k, num, query_set, results, 
+                stats.data());
+        }
+        else {
+            // the filtered queries are answered one by one (with the filter of
+            // the oldest query, which waits until the batch is answered)
+            results.resize(num);
+            for (int i = 0; i < num; ++i) {
+                index_->filtered_reverse_kmips(k, query_set + (u64) i*d_, 
+                    filter, results[i]);
+                stats[i] = index_->stats_;
+            }
+        }
+        lock.lock();
+        
+        // return the results to the submitters
+        for (int i = 0; i < num; ++i) {
+            Request *req = batch[i];
+            req->result_->swap(results[i]);
+            *req->stats_ = stats[i];
+            req->done_ = true;
+        }
+        done_cv_.notify_all();
+    }
+    delete[] query_set;
+}
+
+} // end namespace ip
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <iostream>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "def.h"
+#include "util.h"
+#include "rkmips.h"
+
+namespace ip {
+
+// -----------------------------------------------------------------------------
+//  Scheduler: a micro-batching scheduler of concurrent reverse k-mips queries
+//  in front of a Reverse_KMIPS index
+//
+//  The queries are submitted by many threads (e.g., the connections of a
+//  Server) and wait in a queue. A dispatcher thread takes the oldest query,
+//  and waits until max_batch queries of the same k (and the same filter) have
+//  arrived or the oldest query has waited for max_delay. It then answers these
+//  queries (in the order of arrival) by batch_reverse_kmips of the index (or
+//  one by one by filtered_reverse_kmips if filtered), and returns each
+//  result to its submitter together with its queueing time (from arrival to
+//  dispatch)
+// -----------------------------------------------------------------------------
+class Scheduler {
+public:
+    // -------------------------------------------------------------------------
+    Scheduler(                      // constructor
+        Reverse_KMIPS *index,           // index of reverse k-mips
+        int   max_batch,                // max # queries of a batch
+        double max_delay);              // max queueing delay (ms)
+    
+    // -------------------------------------------------------------------------
+    ~Scheduler();                   // destructor
+    
+    // -------------------------------------------------------------------------
+    void display();                 // display parameters & statistics
+    
+    // -------------------------------------------------------------------------
+    void submit(                    // submit a query and wait for its result
+        int   k,                        // top k value
+        const float *query,             // query vector
+        const User_Filter *filter,      // filter of users (nullptr: none)
+        std::vector<int> &result,       // reverse k-mips result (return)
+        Query_Stats &stats,             // stats of the query (return)
+        double &queue_time);            // queueing time (seconds) (return)
+
+protected:
+    struct Request {
+        int   k_;                       // top k value
+        const float *query_;            // query vector
+        const User_Filter *filter_;     // filter of users (nullptr: none)
+        std::vector<int> *result_;      // reverse k-mips result (return)
+        Query_Stats *stats_;            // stats of the query (return)
+        double queue_time_;             // queueing time (seconds) (return)
+        double arrival_;                // arrival time (seconds)
+        bool  done_;                    // answered?
+    };
+    
+    Reverse_KMIPS *index_;          // index of reverse k-mips
+    int   d_;                       // dimensionality
+    int   max_batch_;               // max # queries of a batch
+    double max_delay_;              // max queueing delay (seconds)
+    
+    std::mutex mutex_;              // mutex of queue_ & statistics
+    std::condition_variable arrive_cv_; // wake up the dispatcher
+    std::condition_variable done_cv_;   // wake up the submitters
+    std::deque<Request*> queue_;    // queries waiting for dispatch
+    bool  stop_;                    // stop the dispatcher?
+    std::thread dispatcher_;        // dispatcher thread
+    
+    u64   batch_count_;             // # batches
+    u64   query_count_;             // # queries
+    double total_queue_time_;       // total queueing time (seconds)
+    double max_queue_time_;         // max queueing time (seconds)
+    
+    // -------------------------------------------------------------------------
+    void dispatch();                // dispatch batches until stopped
+    
+    // -------------------------------------------------------------------------
+    int count_same_batch(           // count the waiting queries of a batch
+        const Request *first);          // the first query of the batch
+    
+    // -------------------------------------------------------------------------
+    static bool same_batch(         // can two queries share a batch?
+        const Request *a,               // a query
+        const Request *b) {             // another query
+        if (a->k_ != b->k_) return false;
+        if (a->filter_ == nullptr || b->filter_ == nullptr) {
+            return a->filter_ == b->filter_;
+        }
+        return a->filter_->all_ == b->filter_->all_ && a->filter_->any_ ==
+            b->filter_->any_ && a->filter_->bitmap_ == b->filter_->bitmap_;
+    }
+};
+
+} // end namespace ip
@@ -0,0 +1,252 @@
+#include "server.h"
+
+#include <thread>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+namespace ip {
+
+// -----------------------------------------------------------------------------
+int read_full(                      // read exactly size bytes (0: success)
+    int   fd,                           // file descriptor
+    void  *buf,                         // buffer (return)
+    u64   size)                         // # bytes
+{
+    char *ptr = (char*) buf;
+    while (size > 0) {
+        ssize_t ret = read(fd, ptr, size);
+        if (ret < 0 && errno == EINTR) continue;
+        if (ret <= 0) return 1; // closed or failed
+        
+        ptr += ret; size -= ret;
+    }
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+int write_full(                     // write exactly size bytes (0: success)
+    int   fd,                           // file descriptor
+    const void *buf,                    // buffer
+    u64   size)                         // # bytes
+{
+    const char *ptr = (const char*) buf;
+    while (size > 0) {
+        ssize_t ret = write(fd, ptr, size);
+        if (ret < 0 && errno == EINTR) continue;
+        if (ret <= 0) return 1;
+        
+        ptr += ret; size -= ret;
+    }
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+static int skip_full(               // skip exactly size bytes (0: success)
+    int   fd,                           // file descriptor
+    u64   size,                         // # bytes
+    void  *buf,                         // buffer (return)
+    u64   buf_size)                     // # bytes of buffer
+{
+    while (size > 0) {
+        u64 cnt = std::min(size, buf_size);
+        if (read_full(fd, buf, cnt)) return 1;
+        size -= cnt;
+    }
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+Server::Server(                     // constructor
+    Reverse_KMIPS *index,               // index (built or loaded)
+    int   max_batch,                    // max # queries of a batch (1: none)
+    double max_delay)                   // max queueing delay of a batch (ms)
+    : index_(index), d_(index->param_.d_), scheduler_(nullptr), stop_(false), 
+    conn_count_(0),
+    query_count_(0UL), ip_count_(0UL), listen_fd_(-1)
+{
+    // H2_ALSH is not built for a max k value, so it accepts any k
+    k_max_ = index->param_.k_max_ > 0 ? index->param_.k_max_ : MAXINT;
+    if (max_batch > 1) scheduler_ = new Scheduler(index, max_batch, max_delay);
+    
+    // a client closing its connection must not kill the server
+    signal(SIGPIPE, SIG_IGN);
+}
+
+// -----------------------------------------------------------------------------
+Server::~Server()                   // destructor
+{
+    if (listen_fd_ >= 0) { close(listen_fd_); listen_fd_ = -1; }
+    if (scheduler_ != nullptr) { delete scheduler_; scheduler_ = nullptr; }
+}
+
+// -----------------------------------------------------------------------------
+void Server::display()              // display parameters & statistics
+{
+    printf("Parameters of Server:\n");
+    printf("d           = %d\n",  d_);
+    printf("k_max       = %d\n",  k_max_);
+    printf("connections = %d\n",  conn_count_.load());
+    printf("queries     = %lu\n", query_count_.load());
+    printf("ip          = %lu\n", ip_count_.load());
+    printf("\n");
+    if (scheduler_ != nullptr) scheduler_->display();
+}
+
+// -----------------------------------------------------------------------------
+int Server::serve_stdio(            // serve the requests of stdin/stdout
+    int   out_fd)                       // file descriptor of responses
+{
+    printf("Serve the requests of stdin\n\n"); fflush(stdout);
+    
+    ++conn_count_;
+    serve_conn(STDIN_FILENO, out_fd);
+    display();
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+int Server::serve_socket(           // serve the requests of a unix socket
+    const char *path)                   // path of unix domain socket
+{
+    sockaddr_un addr;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        printf("Socket path %s is too long\n", path); return 1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    
+    listen_fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(path); // remove the socket file of a previous server
+    if (listen_fd_ < 0 || bind(listen_fd_, (sockaddr*) &addr,
+        sizeof(addr)) < 0 || listen(listen_fd_, SOMAXCONN) < 0) {
+        printf("Could not listen on %s\n", path); return 1;
+    }
+    printf("Serve the requests of %s\n\n", path); fflush(stdout);
+    
+    // serve each connection by a detached thread, until a request to stop 
+    // the server
+    while (!stop_) {
+        int fd = accept(listen_fd_, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            break; // shutdown by stop() (or failed)
+        }
+        ++conn_count_;
+        {
+            std::lock_guard<std::mutex> lock(conn_mutex_);
+            conn_fds_.push_back(fd);
+        }
+        std::thread(&Server::serve_socket_conn, this, fd).detach();
+    }
+    
+    // wake up the idle connections, and wait for the running queries (the 
+    // live sockets are only closed by their threads, under conn_mutex_)
+    {
+        std::unique_lock<std::mutex> lock(conn_mutex_);
+        for (int fd : conn_fds_) shutdown(fd, SHUT_RD);
+        conn_cv_.wait(lock, [this]() { return conn_fds_.empty(); });
+    }
+    close(listen_fd_); listen_fd_ = -1;
+    unlink(path);
+    display();
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+void Server::serve_socket_conn(     // serve & close a socket connection
+    int   fd)                           // file descriptor of socket
+{
+    serve_conn(fd, fd);
+    
+    std::lock_guard<std::mutex> lock(conn_mutex_);
+    close(fd);
+    conn_fds_.erase(std::find(conn_fds_.begin(), conn_fds_.end(), fd));
+    conn_cv_.notify_all();
+}
+
+// -----------------------------------------------------------------------------
+void Server::serve_conn(            // serve the requests of a connection
+    int   in_fd,                        // file descriptor of requests
+    int   out_fd)                       // file descriptor of responses
+{
+    std::vector<float> vec(d_);     // query vector
+    std::vector<int> result;
+    Request_Header  req;
+    Response_Header res;
+    User_Filter filter;
+    Query_Stats stats;
+    double queue_time;
+    
+    while (!stop_ && read_full(in_fd, &req, sizeof(req)) == 0) {
+        if (req.magic_ != SERVER_MAGIC) break; // lost the framing
+        if (req.k_ == SERVER_STOP) { stop(); break; }
+        
+        // read the query vector; a vector of another dimensionality is 
+        // skipped (to keep the framing) by the buffer of d_ floats, as its 
+        // size comes from an untrusted header
+        if (req.d_ < 0) break;
+        if (req.d_ == d_) {
+            if (read_full(in_fd, vec.data(), (u64) d_*sizeof(float))) break;
+        }
+        else if (skip_full(in_fd, (u64) req.d_*sizeof(float), vec.data(), 
+            (u64) d_*sizeof(float))) break;
+        
+        memset(&res, 0, sizeof(res));
+        res.magic_ = SERVER_MAGIC;
+        if (req.d_ != d_ || req.k_ <= 0 || req.k_ > k_max_) {
+            res.status_ = 1; result.clear();
+        }
+        else {
+            filter.all_ = req.all_; filter.any_ = req.any_;
+            filter.bitmap_ = nullptr;
+            bool filtered = req.all_ != 0UL || req.any_ != 0UL;
+            
+            query(req.k_, vec.data(), filtered ? &filter : nullptr, result,
+                stats, queue_time);
+            if (stats.status_ != 0) { res.status_ = 2; result.clear(); }
+            res.num_        = (int) result.size();
+            res.ip_count_   = stats.ip_count_;
+            res.time_       = stats.time_;
+            res.queue_time_ = queue_time;
+        }
+        if (write_full(out_fd, &res, sizeof(res)) || write_full(out_fd,
+            result.data(), (u64) res.num_*sizeof(int))) break;
+    }
+}
+
+// -----------------------------------------------------------------------------
+void Server::query(                 // answer a reverse k-mips request
+    int   k,                            // top k value
+    const float *query,                 // query vector
+    const User_Filter *filter,          // filter of users (nullptr: none)
+    std::vector<int> &result,           // reverse k-mips result (return)
+    Query_Stats &stats,                 // stats of the query (return)
+    double &queue_time)                 // queueing time (seconds) (return)
+{
+    if (scheduler_ != nullptr) {
+        scheduler_->submit(k, query, filter, result, stats, queue_time);
+    }
+    else {
+        // the queueing time is the wait for the queries of other connections
+        double arrival = get_time();
+        
+        std::lock_guard<std::mutex> lock(index_mutex_);
+        queue_time = get_time() - arrival;
+        
+        index_->filtered_reverse_kmips(k, query, filter, result);
+        stats = index_->stats_;
+    }
+    ++query_count_;
+    ip_count_ += stats.ip_count_;
+}
+
+// -----------------------------------------------------------------------------
+void Server::stop()                 // stop the server
+{
+    stop_ = true;
+    if (listen_fd_ >= 0) shutdown(listen_fd_, SHUT_RDWR);
+}
+
+} // end namespace ip
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#include "def.h"
+#include "util.h"
+#include "rkmips.h"
+#include "scheduler.h"
+
+namespace ip {
+
+// -----------------------------------------------------------------------------
+//  Request_Header & Response_Header: the framing of a reverse k-mips request
+//  and its response (in the byte order of the host), where a request is a
+//  Request_Header followed by d_ floats of the query vector, and a response
+//  is a Response_Header followed by num_ ints of user ids
+//
+//  A request may restrict its result to the users with some attributes (see
+//  User_Filter), where all_ = any_ = 0 means no filter
+// -----------------------------------------------------------------------------
+struct Request_Header {
+    u32   magic_;                   // SERVER_MAGIC
+    int   k_;                       // top k value (SERVER_STOP: stop server)
+    int   d_;                       // dimensionality of query vector
+    int   reserved_;                // alignment (always 0)
+    u64   all_;                     // attribute bits a user must have all of
+    u64   any_;                     // attribute bits a user must have any of
+};
+
+struct Response_Header {
+    u32   magic_;                   // SERVER_MAGIC
+    int   status_;                  // 0: success; 1: invalid request; 
+                                    // 2: failed query (no result)
+    int   num_;                     // # user ids of the result
+    int   reserved_;                // alignment (always 0)
+    u64   ip_count_;                // # inner product computations
+    double time_;                   // query time (seconds)
+    double queue_time_;             // queueing time (seconds)
+};
+
+const int SERVER_STOP = -1;         // k of a request to stop the server
+
+// -----------------------------------------------------------------------------
+//  Server: a long-running server of reverse k-mips over a built (or loaded)
+//  Reverse_KMIPS index, which serves the requests of a Unix domain socket
+//  (a detached thread per connection, which closes its socket when the 
+//  client leaves) or of stdin/stdout
+//
+//  An index serves one query at a time, so the connections read requests and
+//  write responses concurrently, while their queries are serialized by a
+//  mutex on the index, or grouped into batches by a Scheduler if max_batch > 1
+// -----------------------------------------------------------------------------
+class Server {
+public:
+    Server(                         // constructor
+        Reverse_KMIPS *index,           // index (built or loaded)
+        int   max_batch,                // max # queries of a batch (1: none)
+        double max_delay);              // max queueing delay of a batch (ms)
+    
+    // -------------------------------------------------------------------------
+    ~Server();                      // destructor
+    
+    // -------------------------------------------------------------------------
+    void display();                 // display parameters & statistics
+    
+    // -------------------------------------------------------------------------
+    int serve_stdio(                // serve the requests of stdin/stdout
+        int   out_fd);                  // file descriptor of responses
+    
+    // -------------------------------------------------------------------------
+    int serve_socket(               // serve the requests of a unix socket
+        const char *path);              // path of unix domain socket
+
+protected:
+    Reverse_KMIPS *index_;          // index of reverse k-mips
+    int   d_;                       // dimensionality
+    int   k_max_;                   // max k value
+    
+    std::mutex index_mutex_;        // one query on the index at a time
+    Scheduler *scheduler_;          // scheduler of batches (nullptr: no batch)
+    std::atomic<bool> stop_;        // stop the server?
+    std::atomic<int>  conn_count_;  // # connections
+    std::atomic<u64>  query_count_; // # queries
+    std::atomic<u64>  ip_count_;    // # inner product computations
+    int   listen_fd_;               // file descriptor of listening socket
+    
+    std::mutex conn_mutex_;         // mutex of conn_fds_
+    std::condition_variable conn_cv_; // signal of a closed connection
+    std::vector<int> conn_fds_;     // sockets of live connections
+    
+    // -------------------------------------------------------------------------
+    void serve_socket_conn(         // serve & close a socket connection
+        int   fd);                      // file descriptor of socket
+    
+    // -------------------------------------------------------------------------
+    void serve_conn(                // serve the requests of a connection
+        int   in_fd,                    // file descriptor of requests
+        int   out_fd);                  // file descriptor of responses
+    
+    // -------------------------------------------------------------------------
+    void query(                     // answer a reverse k-mips request
+        int   k,                        // top k value
+        const float *query,             // query vector
+        const User_Filter *filter,      // filter of users (nullptr: none)
+        std::vector<int> &result,       // reverse k-mips result (return)
+        Query_Stats &stats,             // stats of the query (return)
+        double &queue_time);            // queueing time (seconds) (return)
+    
+    // -------------------------------------------------------------------------
+    void stop();                    // stop the server
+};
+
+// -----------------------------------------------------------------------------
+int read_full(                      // read exactly size bytes (0: success)
+    int   fd,                           // file descriptor
+    void  *buf,                         // buffer (return)
+    u64   size);                        // # bytes
+
+// -----------------------------------------------------------------------------
+int write_full(                     // write exactly size bytes (0: success)
+    int   fd,                           // file descriptor
+    const void *buf,                    // buffer
+    u64   size);                        // # bytes
+
+} // end namespace ip
@@ -0,0 +1,220 @@
+#include "shard.h"
+
+#include <thread>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+namespace ip {
+
+// -----------------------------------------------------------------------------
+int connect_socket(                 // connect to a unix socket (-1: fail)
+    const char *path)                   // path of unix domain socket
+{
+    sockaddr_un addr;
+    if (strlen(path) >= sizeof(addr.sun_path)) return -1;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (sockaddr*) &addr, sizeof(addr)) < 0) {
+        close(fd); return -1;
+    }
+    return fd;
+}
+
+// -----------------------------------------------------------------------------
+Shard_Index::Shard_Index(           // constructor
+    int   n,                            // item cardinality
+    int   m,                            // user cardinality
+    int   d,                            // dimensionality
+    int   k_max,                        // max k value
+    int   num_shards,                   // number of user shards
+    const int *fds)                     // connected worker sockets
+    : Reverse_KMIPS(ALG_SHARD, n, m, d, k_max, -1, -1, -1.0f, HUGE_OFF),
+    num_shards_(num_shards)
+{
+    for (int i = 0; i < num_shards; ++i) {
+        starts_.push_back(get_shard_start(m, num_shards, i));
+        fds_.push_back(fds[i]);
+    }
+}
+
+// -----------------------------------------------------------------------------
+Shard_Index::~Shard_Index()         // destructor (stop the workers)
+{
+    Request_Header req = { SERVER_MAGIC, SERVER_STOP, 0, 0, 0UL, 0UL };
+    for (int fd : fds_) {
+        write_full(fd, &req, sizeof(req));
+        close(fd);
+    }
+}
+
+// -----------------------------------------------------------------------------
+void Shard_Index::display()         // display parameters
+{
+    printf("Parameters of Shard_Index:\n");
+    printf("n             = %d\n", param_.n_);
+    printf("m             = %d\n", param_.m_);
+    printf("d             = %d\n", param_.d_);
+    printf("k_max         = %d\n", param_.k_max_);
+    printf("# shards      = %d\n", num_shards_);
+    printf("\n");
+}
+
+// -----------------------------------------------------------------------------
+int Shard_Index::send_query(        // send a query to a worker (0: success)
+    int   shard,                        // shard id
+    int   k,                            // top k value
+    const float *query,                 // query vector
+    const User_Filter *filter)          // filter of users (nullptr: none)
+{
+    Request_Header req = { SERVER_MAGIC, k, param_.d_, 0, 0UL, 0UL };
+    if (filter != nullptr) { req.all_ = filter->all_; req.any_ = filter->any_; }
+    if (write_full(fds_[shard], &req, sizeof(req))) return 1;
+    return write_full(fds_[shard], query, sizeof(float)*param_.d_);
+}
+
+// -----------------------------------------------------------------------------
+int Shard_Index::recv_result(       // receive a result of a worker
+    int   shard,                        // shard id
+    std::vector<int> &result,           // reverse k-mips result (append)
+    u64   &ip_count)                    // # inner products (accumulate)
+{
+    // return 0 on success, 1 if the worker is lost, and 2 if the worker 
+    // failed the query (where the framing is kept)
+    Response_Header res;
+    if (read_full(fds_[shard], &res, sizeof(res)) || res.magic_ !=
+        SERVER_MAGIC) return 1;
+    
+    // the user ids of a shard are local to the shard
+    u64 size = result.size();
+    result.resize(size + res.num_);
+    int *ids = result.data() + size;
+    if (read_full(fds_[shard], ids, sizeof(int)*res.num_)) return 1;
+    for (int i = 0; i < res.num_; ++i) ids[i] += starts_[shard];
+    
+    ip_count += res.ip_count_;
+    return res.status_ != 0 ? 2 : 0;
+}
+
+// -----------------------------------------------------------------------------
+void Shard_Index::reverse_kmips(    // reverse k-mips
+    int   k,                            // top k value
+    const float *query,                 // query vector
+    std::vector<int> &result)           // reverse k-mips result (return)
+{
+    filtered_reverse_kmips(k, query, nullptr, result);
+}
+
+// -----------------------------------------------------------------------------
+void Shard_Index::filtered_reverse_kmips(// reverse k-mips of filtered users
+    int   k,                            // top k value
+    const float *query,                 // query vector
+    const User_Filter *filter,          // filter of users (nullptr: none)
+    std::vector<int> &result)           // reverse k-mips result (return)
+{
+    double start_time = get_time();
+    stats_.ip_count_ = 0UL;
+    stats_.prune_.reset();
+    stats_.status_ = 0;
+    
+    // clear space for result
+    std::vector<int>().swap(result);
+    assert(k > 0 && k <= param_.k_max_);
+    
+    // send the query to all workers first, so that they answer in parallel,
+    // and then concatenate their results in the order of shards (a worker 
+    // that did not get the query is not waited for)
+    std::vector<int> sent(num_shards_, 1);
+    for (int i = 0; i < num_shards_; ++i) {
+        if (send_query(i, k, query, filter)) {
+            printf("Lost the worker of shard %d\n", i);
+            sent[i] = 0; stats_.status_ = 1;
+        }
+    }
+    for (int i = 0; i < num_shards_; ++i) {
+        if (!sent[i]) continue;
+        int ret = recv_result(i, result, stats_.ip_count_);
+        if (ret == 1) printf("Lost the worker of shard %d\n", i);
+        if (ret != 0) stats_.status_ = 1;
+    }
+    if (stats_.status_ != 0) result.clear();
+    if (filter != nullptr && filter->bitmap_ != nullptr) {
+        int cnt = 0;
+        for (int id : result) if (filter->pass_id(id)) result[cnt++] = id;
+        result.resize(cnt);
+    }
+    double end_time = get_time();
+    
+    stats_.time_ = end_time - start_time;
+}
+
+// -----------------------------------------------------------------------------
+void Shard_Index::batch_reverse_kmips(// reverse k-mips for a batch of queries
+    int   k,                            // top k value
+    int   qn,                           // number of queries
+    const float *query_set,             // query vectors
+    std::vector<std::vector<int> > &results, // results (return)
+    Query_Stats *stats)                 // stats of each query (return)
+{
+    double start_time = get_time();
+    assert(k > 0 && k <= param_.k_max_);
+    
+    results.resize(qn);
+    for (int j = 0; j < qn; ++j) std::vector<int>().swap(results[j]);
+    
+    // the batch is pipelined to each worker, i.e., a thread sends all queries
+    // while another thread receives the results (so that neither side blocks 
+    // on a full socket), and the results of the shards are concatenated in 
+    // the order of shards
+    std::vector<std::vector<std::vector<int> > > shard_results(num_shards_);
+    std::vector<std::vector<u64> > shard_ips(num_shards_);
+    std::vector<std::vector<int> > shard_status(num_shards_); // 0: success
+    std::vector<std::thread> threads;
+    for (int i = 0; i < num_shards_; ++i) {
+        shard_results[i].resize(qn);
+        shard_ips[i].assign(qn, 0UL);
+        shard_status[i].assign(qn, 1);
+        threads.emplace_back([&, i] {
+            for (int j = 0; j < qn; ++j) {
+                const float *query = query_set + (u64) j*param_.d_;
+                if (send_query(i, k, query, nullptr)) break;
+            }
+        });
+        threads.emplace_back([&, i] {
+            for (int j = 0; j < qn; ++j) {
+                int ret = recv_result(i, shard_results[i][j], shard_ips[i][j]);
+                if (ret == 1) {
+                    printf("Lost the worker of shard %d\n", i); break;
+                }
+                shard_status[i][j] = ret;
+            }
+        });
+    }
+    for (auto &thread : threads) thread.join();
+    
+    std::vector<u64> ips(qn, 0UL);
+    std::vector<int> status(qn, 0);
+    for (int i = 0; i < num_shards_; ++i) {
+        for (int j = 0; j < qn; ++j) {
+            results[j].insert(results[j].end(), shard_results[i][j].begin(),
+                shard_results[i][j].end());
+            ips[j] += shard_ips[i][j];
+            if (shard_status[i][j] != 0) status[j] = 1;
+        }
+    }
+    for (int j = 0; j < qn; ++j) if (status[j] != 0) results[j].clear();
+    double end_time = get_time();
+    
+    // each query shares the time of the batch
+    double time = (end_time - start_time) / qn;
+    for (int j = 0; j < qn; ++j) {
+        stats_.ip_count_ = ips[j]; stats_.time_ = time;
+        stats_.status_ = status[j];
+        if (stats != nullptr) stats[j] = stats_;
+    }
+}
+
+} // end namespace ip
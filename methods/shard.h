@@ -0,0 +1,112 @@
+#pragma once
+
+#include <iostream>
+#include <algorithm>
+#include <vector>
+#include <sys/wait.h>
+
+#include "def.h"
+#include "util.h"
+#include "rkmips.h"
+#include "server.h"
+
+namespace ip {
+
+// -----------------------------------------------------------------------------
+//  Shard_Index: a coordinator of reverse k-mips over user shards, where the
+//  user set is partitioned into num_shards contiguous shards, and each shard
+//  is served by a Server (of its own index over the whole item set and the
+//  users of the shard) in a worker process
+//
+//  The decision of a user depends only on the item set and the query, so a
+//  query is sent to all workers, which answer it in parallel, and the results
+//  are concatenated (the user ids of a shard are local to the shard). The
+//  workers are connected by Unix domain sockets on one host, which stand in
+//  for the transport across nodes
+//
+//  The attribute masks of a filter are sent to the workers (which keep the
+//  attributes of their users), while the bitmap of user ids is checked on the
+//  results of the workers
+//
+//  A query fails (stats_.status_ = 1, with an empty result) if any worker is
+//  lost or fails it, as the result of the other shards is not complete
+// -----------------------------------------------------------------------------
+class Shard_Index : public Reverse_KMIPS {
+public:
+    int   num_shards_;              // number of user shards
+    std::vector<int> starts_;       // start user id of each shard
+    std::vector<int> fds_;          // file descriptors of worker sockets
+    
+    // -------------------------------------------------------------------------
+    Shard_Index(                    // constructor
+        int   n,                        // item cardinality
+        int   m,                        // user cardinality
+        int   d,                        // dimensionality
+        int   k_max,                    // max k value
+        int   num_shards,               // number of user shards
+        const int *fds);                // connected worker sockets
+    
+    // -------------------------------------------------------------------------
+    ~Shard_Index();                 // destructor (stop the workers)
+    
+    // -------------------------------------------------------------------------
+    void display();                 // display parameters
+    
+    // -------------------------------------------------------------------------
+    void reverse_kmips(             // reverse k-mips
+        int   k,                        // top k value
+        const float *query,             // query vector
+        std::vector<int> &result);      // reverse k-mips result (return)
+    
+    // -------------------------------------------------------------------------
+    void filtered_reverse_kmips(    // reverse k-mips of filtered users
+        int   k,                        // top k value
+        const float *query,             // query vector
+        const User_Filter *filter,      // filter of users (nullptr: none)
+        std::vector<int> &result);      // reverse k-mips result (return)
+    
+    // -------------------------------------------------------------------------
+    void batch_reverse_kmips(       // reverse k-mips for a batch of queries
+        int   k,                        // top k value
+        int   qn,                       // number of queries
+        const float *query_set,         // query vectors
+        std::vector<std::vector<int> > &results, // results (return)
+        Query_Stats *stats = nullptr);  // stats of each query (return)
+    
+    // -------------------------------------------------------------------------
+    u64 get_estimated_memory() {    // get memory usage (of the coordinator)
+        u64 ret = 0UL;
+        ret += sizeof(*this);
+        ret += sizeof(int)*num_shards_*2; // starts_ & fds_
+        
+        return ret;
+    }
+    
+    // -------------------------------------------------------------------------
+    static int get_shard_start(     // get the start user id of a shard
+        int   m,                        // user cardinality
+        int   num_shards,               // number of user shards
+        int   shard) {                  // shard id (num_shards: the end)
+        return (int) ((u64) m*shard/num_shards);
+    }
+
+protected:
+    // -------------------------------------------------------------------------
+    int send_query(                 // send a query to a worker (0: success)
+        int   shard,                    // shard id
+        int   k,                        // top k value
+        const float *query,             // query vector
+        const User_Filter *filter);     // filter of users (nullptr: none)
+    
+    // -------------------------------------------------------------------------
+    int recv_result(                // receive a result of a worker
+        int   shard,                    // shard id
+        std::vector<int> &result,       // reverse k-mips result (append)
+        u64   &ip_count);               // # inner products (accumulate)
+};
+
+// -----------------------------------------------------------------------------
+int connect_socket(                 // connect to a unix socket (-1: fail)
+    const char *path);                  // path of unix domain socket
+
+} // end namespace ip
@@ -0,0 +1,176 @@
+#include "shared_index.h"
+
+namespace ip {
+
+// -----------------------------------------------------------------------------
+Shared_Index::Shared_Index(         // constructor
+    int   n,                            // item cardinality
+    int   m,                            // user cardinality
+    int   d,                            // dimensionality
+    int   k_max,                        // max k value
+    int   huge,                         // backing of big arrays (HUGE_*)
+    const float *item_set,              // item set
+    const float *user_set,              // user set
+    const Lower_Bounds *lb)             // precomputed lower bounds
+    : n_(n), m_(m), d_(d), k_max_(k_max), pre_time_(0.0), 
+    alloc_({ huge, nullptr }), user_index_(nullptr), user_norms_(nullptr), 
+    user_set_(nullptr), lower_bounds_(nullptr), norm_user_set_(nullptr),
+    norm_lower_bounds_(nullptr), input_user_set_(user_set), lb_(lb)
+{
+    timeval start_time, end_time;
+    gettimeofday(&start_time, nullptr);
+    
+    // only consider the first n0 elements in item_set for lower bounds
+    n0_ = k_max*COEFF;
+    if (n0_ > n) n0_ = n;
+    if (lb != nullptr) {
+        assert(lb->m_ == m && lb->d_ == d && lb->k_max_ == k_max);
+        n0_ = lb->n0_;
+    }
+    
+    // compute l2-norms & sort item_set in descending order of l2-norms
+    item_index_ = new int[n];
+    item_norms_ = new float[n];
+    item_set_   = new_huge<float>((u64) n*d, alloc_);
+    sort_by_norm(n, d, item_set, item_index_, item_norms_, item_set_);
+    
+    gettimeofday(&end_time, nullptr);
+    pre_time_ += end_time.tv_sec - start_time.tv_sec +
+        (end_time.tv_usec - start_time.tv_usec) / 1000000.0;
+}
+
+// -----------------------------------------------------------------------------
+Shared_Index::~Shared_Index()       // destructor
+{
+    for (auto tree : trees_) { delete tree; tree = nullptr; }
+    std::vector<Cone_Tree*>().swap(trees_);
+    
+    delete[] item_index_;        item_index_        = nullptr;
+    delete[] item_norms_;        item_norms_        = nullptr;
+    delete_huge(item_set_);
+    
+    delete[] user_index_;        user_index_        = nullptr;
+    delete[] user_norms_;        user_norms_        = nullptr;
+    delete[] user_set_;          user_set_          = nullptr;
+    delete[] lower_bounds_;      lower_bounds_      = nullptr;
+    
+    delete[] norm_user_set_;     norm_user_set_     = nullptr;
+    delete[] norm_lower_bounds_; norm_lower_bounds_ = nullptr;
+}
+
+// -----------------------------------------------------------------------------
+void Shared_Index::display()        // display parameters
+{
+    printf("Parameters of Shared_Index:\n");
+    printf("n             = %d\n",   n_);
+    printf("m             = %d\n",   m_);
+    printf("d             = %d\n",   d_);
+    printf("k_max         = %d\n",   k_max_);
+    printf("n0            = %d\n",   n0_);
+    printf("# cone-trees  = %d\n",   (int) trees_.size());
+    printf("pre_time      = %g\n\n", pre_time_);
+}
+
+// -----------------------------------------------------------------------------
+void Shared_Index::prepare_sorted_users()// prepare sorted users & lower bounds
+{
+    if (user_set_ != nullptr) return; // already prepared
+    
+    timeval start_time, end_time;
+    gettimeofday(&start_time, nullptr);
+    
+    // compute l2-norms & sort user_set in descending order of l2-norms
+    user_index_ = new int[m_];
+    user_norms_ = new float[m_];
+    user_set_   = new float[(u64) m_*d_];
+    sort_by_norm(m_, d_, input_user_set_, user_index_, user_norms_, 
+        user_set_);
+    
+    // determine k_max approximate mips results as lower bounds for user_set
+    lower_bounds_ = new float[(u64) m_*k_max_];
+    if (lb_ != nullptr) { // load the precomputed lower bounds
+        lb_->copy(false, m_, user_index_, lower_bounds_);
+    }
+    else {
+        calc_lower_bounds(m_, n0_, d_, k_max_, item_norms_, item_set_, 
+            user_norms_, user_set_, lower_bounds_);
+    }
+    
+    gettimeofday(&end_time, nullptr);
+    pre_time_ += end_time.tv_sec - start_time.tv_sec +
+        (end_time.tv_usec - start_time.tv_usec) / 1000000.0;
+}
+
+// -----------------------------------------------------------------------------
+void Shared_Index::prepare_normalized_users()// prepare normalized users
+{
+    if (norm_user_set_ != nullptr) return; // already prepared
+    
+    timeval start_time, end_time;
+    gettimeofday(&start_time, nullptr);
+    
+    // normalize the user_set (in the input order)
+    norm_user_set_ = new float[(u64) m_*d_];
+    normalize_data(m_, d_, input_user_set_, nullptr, norm_user_set_);
+    
+    // determine k_max approximate mips results as lower bounds for users,
+    // which are shared by the cone-trees of all leaf sizes
+    norm_lower_bounds_ = new float[(u64) m_*k_max_];
+    if (lb_ != nullptr) { // load the precomputed lower bounds
+        std::copy(lb_->norm_, lb_->norm_+(u64) m_*k_max_, norm_lower_bounds_);
+    }
+    else {
+        calc_lower_bounds(m_, n0_, d_, k_max_, item_norms_, item_set_, 
+            nullptr, norm_user_set_, norm_lower_bounds_);
+    }
+    
+    gettimeofday(&end_time, nullptr);
+    pre_time_ += end_time.tv_sec - start_time.tv_sec +
+        (end_time.tv_usec - start_time.tv_usec) / 1000000.0;
+}
+
+// -----------------------------------------------------------------------------
+Cone_Tree* Shared_Index::get_cone_tree(// get the cone-tree of normalized users
+    int   leaf)                         // leaf size of cone-tree
+{
+    for (auto tree : trees_) if (tree->leaf_size_ == leaf) return tree;
+    prepare_normalized_users();
+    
+    timeval start_time, end_time;
+    gettimeofday(&start_time, nullptr);
+    
+    // build a cone-tree for the normalized users (its arenas are shared, so
+    // they are not measured as the memory of the index asking for it)
+    Cone_Tree *tree = new Cone_Tree(m_, d_, leaf, norm_user_set_, alloc_,
+        sizeof(float)*k_max_, sizeof(float)*k_max_);
+    std::vector<Cone_Node*> leaves;
+    tree->traversal(leaves);
+    
+    // copy the lower bounds of users to each leaf (by the data index), and
+    // compute the lower bounds for this leaf
+    for (auto node : leaves) {
+        int m = node->n_; // number of users
+        node->k_max_ = k_max_;
+        node->lower_bounds_ = tree->leaf_arena_->alloc<float>((u64) m*k_max_);
+        node->node_lower_bounds_ = tree->arena_->alloc<float>(k_max_);
+        
+        float *node_lb = node->node_lower_bounds_;
+        for (int j = 0; j < k_max_; ++j) node_lb[j] = MAXREAL;
+        for (int i = 0; i < m; ++i) {
+            const float *lb = norm_lower_bounds_ + (u64) node->index_[i]*k_max_;
+            std::copy(lb, lb+k_max_, node->lower_bounds_ + (u64) i*k_max_);
+            for (int j = 0; j < k_max_; ++j) {
+                if (node_lb[j] > lb[j]) node_lb[j] = lb[j];
+            }
+        }
+    }
+    trees_.push_back(tree);
+    
+    gettimeofday(&end_time, nullptr);
+    pre_time_ += end_time.tv_sec - start_time.tv_sec +
+        (end_time.tv_usec - start_time.tv_usec) / 1000000.0;
+    
+    return tree;
+}
+
+} // end namespace ip
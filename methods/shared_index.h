@@ -0,0 +1,106 @@
+#pragma once
+
+#include <iostream>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <vector>
+
+#include "def.h"
+#include "util.h"
+#include "pri_queue.h"
+#include "cone_tree.h"
+#include "lower_bounds.h"
+
+namespace ip {
+
+// -----------------------------------------------------------------------------
+//  Shared_Index: the pre-processing artifacts shared by SA_Simpfer, SA_CONE,
+//  H2_Simpfer, and H2_CONE, so that a sweep of methods and parameters in one
+//  process builds them only once
+//
+//  1. the item_set sorted in descending order of l2-norms
+//  2. the user_set sorted in descending order of l2-norms, and the lower
+//     bounds of the sorted users by the first n0 items (for Simpfer)
+//  3. the normalized user_set, its lower bounds by the first n0 items, and
+//     the cone-trees of normalized users for each leaf size, whose leaves
+//     keep the lower bounds of users and nodes (for Cone-Tree Blocking)
+//
+//  The artifacts of 2 and 3 are built on the first request, where the lower 
+//  bounds are loaded from a precomputed Lower_Bounds (with its n0) if given. 
+//  An index using a shared cone-tree adds its own hash keys (or values) to 
+//  the leaves, and removes them when it is released, so a cone-tree is used 
+//  by one index at a time
+// -----------------------------------------------------------------------------
+class Shared_Index {
+public:
+    int   n_;                       // item cardinality
+    int   m_;                       // user cardinality
+    int   d_;                       // dimensionality
+    int   k_max_;                   // max k value
+    int   n0_;                      // the first n0 items for lower bounds
+    double pre_time_;               // pre-processing time (seconds)
+    Huge_Alloc alloc_;              // backing of arrays (no account: shared)
+    
+    int   *item_index_;             // sorted item index
+    float *item_norms_;             // sorted item l2-norms
+    float *item_set_;               // sorted item vectors
+    
+    int   *user_index_;             // sorted user index
+    float *user_norms_;             // sorted user l2-norms
+    float *user_set_;               // sorted user vectors
+    float *lower_bounds_;           // lower bounds for sorted user vectors
+    
+    float *norm_user_set_;          // normalized user vectors
+    float *norm_lower_bounds_;      // lower bounds for normalized users
+    
+    // -------------------------------------------------------------------------
+    Shared_Index(                   // constructor
+        int   n,                        // item cardinality
+        int   m,                        // user cardinality
+        int   d,                        // dimensionality
+        int   k_max,                    // max k value
+        int   huge,                     // backing of big arrays (HUGE_*)
+        const float *item_set,          // item set
+        const float *user_set,          // user set
+        const Lower_Bounds *lb = nullptr); // precomputed lower bounds
+    
+    // -------------------------------------------------------------------------
+    ~Shared_Index();                // destructor
+    
+    // -------------------------------------------------------------------------
+    void display();                 // display parameters
+    
+    // -------------------------------------------------------------------------
+    void prepare_sorted_users();    // prepare sorted users & lower bounds
+    
+    // -------------------------------------------------------------------------
+    void prepare_normalized_users();// prepare normalized users & lower bounds
+    
+    // -------------------------------------------------------------------------
+    Cone_Tree* get_cone_tree(       // get the cone-tree of normalized users
+        int   leaf);                    // leaf size of cone-tree
+    
+    // -------------------------------------------------------------------------
+    u64 get_estimated_memory() {    // get memory usage
+        u64 ret = 0UL;
+        ret += sizeof(*this);
+        ret += (sizeof(int)+sizeof(float)*(d_+1))*n_; // sorted items
+        if (user_set_ != nullptr) { // sorted users & lower bounds
+            ret += (sizeof(int)+sizeof(float)*(d_+1+k_max_))*m_;
+        }
+        if (norm_user_set_ != nullptr) { // normalized users & lower bounds
+            ret += sizeof(float)*(d_+k_max_)*m_;
+        }
+        for (auto tree : trees_) ret += tree->get_estimated_memory();
+        
+        return ret;
+    }
+
+protected:
+    const float *input_user_set_;   // input user set
+    const Lower_Bounds *lb_;        // precomputed lower bounds (optional)
+    std::vector<Cone_Tree*> trees_; // cone-trees of normalized users
+};
+
+} // end namespace ip
@@ -6,8 +6,9 @@ namespace ip {
 SRP_LSH::SRP_LSH(                   // constructor
     int   n,                            // cardinality of dataset
     int   d,                            // dimensionality of dataset
-    int   K)                            // number of hash tables
-    : n_(n), d_(d), K_(K), m_(K/64)
+    int   K,                            // number of hash tables
+    const Huge_Alloc &alloc)            // backing & account of hash_keys_
+    : n_(n), d_(d), K_(K), m_(K/64), shared_(false)
 {
     assert(K % 64 == 0);
     // m_ = (int) ceil((double) K / 64.0);
@@ -24,7 +25,19 @@ SRP_LSH::SRP_LSH(                   // constructor
     for (u32 i = 0; i < size; ++i) table16_[i] = bit_count(i);
     
     // allocate space for hash_key
-    hash_keys_ = new u64[n*m_];
+    hash_keys_ = new_huge<u64>((u64) n*m_, alloc);
+}
+
+// -----------------------------------------------------------------------------
+SRP_LSH::SRP_LSH(                   // constructor (share proj_ & table16_)
+    int   n,                            // cardinality of dataset
+    const SRP_LSH *srp,                 // srp-lsh with shared hash functions
+    const Huge_Alloc &alloc)            // backing & account of hash_keys_
+    : n_(n), d_(srp->d_), K_(srp->K_), m_(srp->m_), shared_(true), 
+    proj_(srp->proj_), table16_(srp->table16_)
+{
+    // allocate space for hash_key (only)
+    hash_keys_ = new_huge<u64>((u64) n*m_, alloc);
 }
 
 // -----------------------------------------------------------------------------
@@ -55,12 +68,48 @@ void SRP_LSH::compress_hash_code(   // compress hash code with 64 bits
     }
 }
 
+// -----------------------------------------------------------------------------
+void SRP_LSH::calc_hash_key(        // calc hash key (compressed hash code)
+    const float *data,                  // input data
+    u64   *hash_key)                    // hash key (return)
+{
+    bool *hash_code = new bool[K_];
+    for (int i = 0; i < K_; ++i) {
+        hash_code[i] = calc_hash_code(i, data);
+    }
+    compress_hash_code(hash_code, hash_key);
+    delete[] hash_code;
+}
+
+// -----------------------------------------------------------------------------
+void SRP_LSH::calc_hash_keys(       // calc hash keys of data with a 0 appended
+    int   n,                            // number of data
+    const float *data,                  // input data ((d_-1)-dim)
+    u64   *hash_keys)                   // hash keys (return)
+{
+    Perf_Scope perf(PHASE_HASHING);
+    
+    // as srp-lsh is scale-invariant, the hash key of a user scaled by any 
+    // lambda (e.g., R/|u| of sa-trans) with a zero appended is the same, so 
+    // it is computed once for all item blocks
+    int d = d_ - 1;
+    std::vector<float> point(d_, 0.0f);
+    for (int i = 0; i < n; ++i) {
+        const float *x = data + (u64) i*d;
+        std::copy(x, x+d, point.begin());
+        
+        calc_hash_key(point.data(), hash_keys + (u64) i*m_);
+    }
+}
+
 // -----------------------------------------------------------------------------
 SRP_LSH::~SRP_LSH()                 // destructor
 {
-    if (!proj_)      { delete[] proj_;      proj_      = nullptr; }
-    if (!table16_)   { delete[] table16_;   table16_   = nullptr; }
-    if (!hash_keys_) { delete[] hash_keys_; hash_keys_ = nullptr; }
+    if (!shared_) {
+        if (proj_    != nullptr) { delete[] proj_;    proj_    = nullptr; }
+        if (table16_ != nullptr) { delete[] table16_; table16_ = nullptr; }
+    }
+    delete_huge(hash_keys_);
 }
 
 // -----------------------------------------------------------------------------
@@ -81,17 +130,25 @@ int SRP_LSH::kmcss(                 // k-mcss
     const float *query,                 // input query
     std::vector<int> &cand)             // k-mcss candidates (return)
 {
-    cand.clear();
-    
     // calculate the hash key (compressed hash code) of query
-    bool *hash_code_q = new bool[K_];
-    for (int i = 0; i < K_; ++i) {
-        hash_code_q[i] = calc_hash_code(i, query); ++g_ip_count;
-    }
-    
     u64 *hash_key_q = new u64[m_];
-    compress_hash_code(hash_code_q, hash_key_q);
+    calc_hash_key(query, hash_key_q);
+    
+    // find k-mcss candidates by the hash key of query
+    kmcss(k, hash_key_q, cand);
+    delete[] hash_key_q;
+    
+    return 0;
+}
 
+// -----------------------------------------------------------------------------
+int SRP_LSH::kmcss(                 // k-mcss by the hash key of query
+    int   k,                            // top-k value
+    const u64 *hash_key_q,              // hash key of query
+    std::vector<int> &cand)             // k-mcss candidates (return)
+{
+    cand.clear();
+    
     // find the candidates with largest matched values
     MaxK_List *list = new MaxK_List(CANDIDATES+k-1);
     int total_bits = 64*m_;
@@ -113,8 +170,6 @@ int SRP_LSH::kmcss(                 // k-mcss
     for (int i = 0; i < num; ++i) cand[i] = k_list[i].id_;
 
     // release space
-    delete[] hash_code_q;
-    delete[] hash_key_q;
     delete list;
 
     return 0;
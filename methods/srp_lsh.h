@@ -26,6 +26,7 @@ public:
     int   d_;                       // dimensionality
     int   K_;                       // number of hash functions
     int   m_;                       // number of compressed uint64_t hash code
+    bool  shared_;                  // share proj_ & table16_ or not
     // bool  align_;                   // align or not
     
     float *proj_;                   // random projection vectors
@@ -36,7 +37,14 @@ public:
     SRP_LSH(                        // constructor
         int n,                          // number of data objects
         int d,                          // dimensionality
-        int K);                         // number of hash functions
+        int K,                          // number of hash functions
+        const Huge_Alloc &alloc);       // backing & account of hash_keys_
+    
+    // -------------------------------------------------------------------------
+    SRP_LSH(                        // constructor (share proj_ & table16_)
+        int n,                          // number of data objects
+        const SRP_LSH *srp,             // srp-lsh with shared hash functions
+        const Huge_Alloc &alloc);       // backing & account of hash_keys_
     
     // -------------------------------------------------------------------------
     ~SRP_LSH();                     // destructor
@@ -51,6 +59,17 @@ public:
         const bool *hash_code,          // input hash code
         u64   *hash_key);               // hash key (return)
     
+    // -------------------------------------------------------------------------
+    void calc_hash_key(             // calc hash key (compressed hash code)
+        const float *data,              // input data
+        u64   *hash_key);               // hash key (return)
+    
+    // -------------------------------------------------------------------------
+    void calc_hash_keys(            // calc hash keys of data with a 0 appended
+        int   n,                        // number of data
+        const float *data,              // input data ((d_-1)-dim)
+        u64   *hash_keys);              // hash keys (return)
+    
     // -------------------------------------------------------------------------
     void display();                 // display parameters
     
@@ -60,13 +79,21 @@ public:
         const float *query,             // input query
         std::vector<int> &cand);        // k-mcss candidates (return)
     
+    // -------------------------------------------------------------------------
+    int kmcss(                      // k-mcss by the hash key of query
+        int   k,                        // top-k value
+        const u64 *hash_key_q,          // hash key of query
+        std::vector<int> &cand);        // k-mcss candidates (return)
+    
     // -------------------------------------------------------------------------
     u64 get_estimated_memory() {    // get memory usage
         u64 ret = 0UL;
         ret += sizeof(*this);
-        ret += sizeof(float)*K_*d_;   // proj_
-        ret += sizeof(int)*(1 << 16); // table16_
-        ret += sizeof(u64)*n_*m_;;    // hash_key_
+        if (!shared_) {             // proj_ & table16_ are counted by owner
+            ret += sizeof(float)*K_*d_;   // proj_
+            ret += sizeof(u32)*(1 << 16); // table16_
+        }
+        ret += sizeof(u64)*n_*m_;     // hash_key_
         return ret;
     }
 
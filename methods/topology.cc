@@ -0,0 +1,113 @@
+#include "topology.h"
+
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace ip {
+
+int g_num_threads = 0;              // global param: # threads of parallel build
+
+// -----------------------------------------------------------------------------
+int get_num_threads()               // get the # threads of parallel build
+{
+    if (g_num_threads > 0) return g_num_threads;
+    
+    // the cpus available to this thread (e.g., of the node it is bound to)
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) != 0) return 1;
+    return std::max(CPU_COUNT(&set), 1);
+}
+
+// -----------------------------------------------------------------------------
+Topology::Topology()                // constructor (read the topology)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    sched_getaffinity(0, sizeof(set), &set);
+    
+    // the available cpus of each online node (skip the nodes without them,
+    // e.g., memory-only nodes or the nodes excluded by taskset)
+    std::vector<int> nodes, cpus;
+    read_list("/sys/devices/system/node/online", nodes);
+    for (int node : nodes) {
+        char fname[200];
+        sprintf(fname, "/sys/devices/system/node/node%d/cpulist", node);
+        if (read_list(fname, cpus)) continue;
+        
+        std::vector<int> avail;
+        for (int cpu : cpus) if (CPU_ISSET(cpu, &set)) avail.push_back(cpu);
+        if (avail.empty()) continue;
+        
+        nodes_.push_back(node);
+        cpus_.push_back(avail);
+    }
+    if (nodes_.empty()) { // no numa: a single node of all available cpus
+        nodes_.push_back(0);
+        cpus_.resize(1);
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set)) cpus_[0].push_back(cpu);
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+int Topology::read_list(            // read a list of sysfs (e.g., "0-3,8")
+    const char *fname,                  // file name
+    std::vector<int> &ids)              // ids (return)
+{
+    ids.clear();
+    FILE *fp = fopen(fname, "r");
+    if (!fp) return 1;
+    
+    char line[4096];
+    if (!fgets(line, sizeof(line), fp)) { fclose(fp); return 1; }
+    fclose(fp);
+    
+    char *token = strtok(line, ",\n");
+    while (token != nullptr) {
+        int first = -1, last = -1;
+        int cnt = sscanf(token, "%d-%d", &first, &last);
+        if (cnt == 1) last = first;
+        for (int id = first; cnt >= 1 && id <= last; ++id) ids.push_back(id);
+        
+        token = strtok(nullptr, ",\n");
+    }
+    return ids.empty() ? 1 : 0;
+}
+
+// -----------------------------------------------------------------------------
+int Topology::bind(                 // bind to a node (0: success)
+    int   node)                         // node (0 ~ num_nodes()-1)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus_[node]) CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) return 1;
+    
+    // prefer (rather than bind to) the memory of the node, so an allocation
+    // falls back to other nodes rather than fails when the node is full
+    if (num_nodes() > 1 && nodes_[node] < 64) {
+        unsigned long mask = 1UL << nodes_[node];
+        if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, &mask, 64) != 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+void Topology::display()            // display the nodes & cpus
+{
+    printf("Parameters of Topology:\n");
+    printf("# nodes   = %d\n", num_nodes());
+    for (int i = 0; i < num_nodes(); ++i) {
+        printf("node %-4d = %d cpus:", nodes_[i], num_cpus(i));
+        for (int cpu : cpus_[i]) printf(" %d", cpu);
+        printf("\n");
+    }
+    printf("\n");
+}
+
+} // end namespace ip
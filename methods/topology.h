@@ -0,0 +1,58 @@
+#pragma once
+
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "def.h"
+
+namespace ip {
+
+extern int g_num_threads;           // global param: # threads of parallel
+                                    // build (0: # cpus of this process)
+
+// -----------------------------------------------------------------------------
+int get_num_threads();              // get the # threads of parallel build
+
+// -----------------------------------------------------------------------------
+//  Topology: the numa nodes of this host and their cpus (from sysfs) that are
+//  available to this process
+//
+//  bind() binds the calling thread (and the threads it creates later) to the
+//  cpus of a node, and prefers the memory of the node, so the pages touched
+//  first by them are placed on the node (or on other nodes when it is full).
+//  A host without numa (or sysfs) has a single node of all available cpus
+// -----------------------------------------------------------------------------
+class Topology {
+public:
+    // -------------------------------------------------------------------------
+    Topology();                     // constructor (read the topology)
+    
+    // -------------------------------------------------------------------------
+    int num_nodes() const { return (int) nodes_.size(); } // # nodes
+    
+    // -------------------------------------------------------------------------
+    int num_cpus(                   // get the # cpus of a node
+        int   node) const {             // node (0 ~ num_nodes()-1)
+        return (int) cpus_[node].size();
+    }
+    
+    // -------------------------------------------------------------------------
+    int bind(                       // bind to a node (0: success)
+        int   node);                    // node (0 ~ num_nodes()-1)
+    
+    // -------------------------------------------------------------------------
+    void display();                 // display the nodes & cpus
+
+protected:
+    std::vector<int> nodes_;        // node ids (of sysfs)
+    std::vector<std::vector<int> > cpus_; // available cpus of each node
+    
+    // -------------------------------------------------------------------------
+    static int read_list(           // read a list of sysfs (e.g., "0-3,8")
+        const char *fname,              // file name
+        std::vector<int> &ids);         // ids (return)
+};
+
+} // end namespace ip
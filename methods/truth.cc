@@ -0,0 +1,211 @@
+#include "truth.h"
+
+namespace ip {
+
+// -----------------------------------------------------------------------------
+Truth_Set::Truth_Set(               // constructor
+    int   m)                            // user cardinality
+    : m_(m), qn_(0), data_(nullptr), size_(0UL), mapped_(false),
+    entries_(nullptr)
+{
+    words_  = ((u64) m + 63) / 64;
+    bitmap_ = new u64[words_];
+    memset(bitmap_, 0, sizeof(u64)*words_);
+}
+
+// -----------------------------------------------------------------------------
+Truth_Set::~Truth_Set()             // destructor
+{
+    release();
+    if (bitmap_ != nullptr) { delete[] bitmap_; bitmap_ = nullptr; }
+}
+
+// -----------------------------------------------------------------------------
+void Truth_Set::release()           // release the truth set
+{
+    if (data_ != nullptr) {
+        if (mapped_) munmap(data_, size_);
+        else delete[] data_;
+    }
+    data_ = nullptr; size_ = 0UL; mapped_ = false; entries_ = nullptr;
+}
+
+// -----------------------------------------------------------------------------
+void Truth_Set::build(              // build truth set in memory
+    int   qn,                           // query cardinality
+    const std::vector<std::vector<int> > &truth) // sorted truth results
+{
+    release();
+    qn_ = qn;
+    
+    // determine the entries of queries
+    u64 bitmap_size = sizeof(u64)*words_;
+    u64 offset = sizeof(u32)*4 + sizeof(Truth_Entry)*qn;
+    std::vector<Truth_Entry> entries(qn);
+    for (int i = 0; i < qn; ++i) {
+        u64 num = truth[i].size();
+        entries[i].offset_ = offset;
+        entries[i].num_    = (u32) num;
+        entries[i].type_   = num*32 > (u64) m_ ? TRUTH_BITMAP : TRUTH_IDS;
+        offset += entries[i].type_ == TRUTH_BITMAP ? bitmap_size :
+            sizeof(u32)*num;
+        offset = (offset + 7) / 8 * 8; // keep results 8-byte aligned
+    }
+    
+    // write the header, the entries, and the results
+    size_ = offset;
+    data_ = new char[size_];
+    memset(data_, 0, size_);
+    
+    u32 *header = (u32*) data_;
+    header[0] = TRUTH_MAGIC; header[1] = (u32) qn; header[2] = (u32) m_;
+    std::copy(entries.begin(), entries.end(), (Truth_Entry*) (header+4));
+    entries_ = (const Truth_Entry*) (header+4);
+    
+    for (int i = 0; i < qn; ++i) {
+        char *result = data_ + entries[i].offset_;
+        if (entries[i].type_ == TRUTH_BITMAP) {
+            u64 *bitmap = (u64*) result;
+            for (int id : truth[i]) bitmap[id >> 6] |= 1UL << (id & 63);
+        }
+        else {
+            u32 *ids = (u32*) result;
+            for (int id : truth[i]) *ids++ = (u32) id;
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+int Truth_Set::save(                // save truth set to disk
+    int   k,                            // top-k value
+    const char *truth_addr)             // address of truth set
+{
+    char fname[200]; sprintf(fname, "%s_k=%d.bin", truth_addr, k);
+    FILE *fp = fopen(fname, "wb");
+    if (!fp) { printf("Could not create %s\n", fname); return 1; }
+    
+    fwrite(data_, 1, size_, fp);
+    fclose(fp);
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+int Truth_Set::load(                // load truth set from disk
+    int   k,                            // top-k value
+    int   qn,                           // query cardinality
+    const char *truth_addr)             // address of truth set
+{
+    release();
+    qn_ = qn;
+    
+    // map the binary truth set if it exists
+    char fname[200]; sprintf(fname, "%s_k=%d.bin", truth_addr, k);
+    int fd = open(fname, O_RDONLY);
+    if (fd >= 0) {
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size >= (off_t) (sizeof(u32)*4)) {
+            size_ = (u64) st.st_size;
+            void *data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED) { data_ = (char*) data; mapped_ = true; }
+        }
+        close(fd);
+        
+        if (data_ != nullptr && is_valid(qn)) return 0;
+        printf("Invalid %s, use the csv truth set instead\n", fname);
+        release(); qn_ = qn;
+    }
+    
+    // otherwise, parse the csv truth set
+    std::vector<std::vector<int> > truth;
+    if (read_ground_truth(k, qn, truth_addr, truth)) return 1;
+    
+    build(qn, truth);
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+bool Truth_Set::is_valid(           // is the mapped truth set well-formed
+    int   qn)                           // query cardinality
+{
+    // check the header and that the entries are inside the file
+    const u32 *header = (const u32*) data_;
+    u64 head_size = sizeof(u32)*4;
+    if (size_ < head_size || header[0] != TRUTH_MAGIC ||
+        (int) header[1] < qn || (int) header[2] != m_) return false;
+    
+    head_size += sizeof(Truth_Entry)*header[1];
+    if (size_ < head_size) return false;
+    
+    // check that the result of each query is inside the file, and that its
+    // ids are valid for the bitmap of users
+    const Truth_Entry *entries = (const Truth_Entry*) (header+4);
+    u64 bitmap_size = sizeof(u64)*words_;
+    for (int i = 0; i < qn; ++i) {
+        const Truth_Entry &entry = entries[i];
+        u64 offset = entry.offset_;
+        if (offset < head_size || offset % 8 != 0 || offset > size_) {
+            return false;
+        }
+        
+        u64 len = 0;
+        if (entry.type_ == TRUTH_BITMAP) len = bitmap_size;
+        else if (entry.type_ == TRUTH_IDS) len = sizeof(u32)*entry.num_;
+        else return false;
+        if (len > size_ - offset) return false;
+        
+        if (entry.type_ == TRUTH_IDS) {
+            const u32 *ids = (const u32*) (data_ + offset);
+            for (u32 j = 0; j < entry.num_; ++j) {
+                if (ids[j] >= (u32) m_) return false;
+            }
+        }
+    }
+    entries_ = entries;
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+void Truth_Set::update_global_metric(// update the global metric for a query
+    int   i,                            // ith query
+    const std::vector<int> &result)     // result from a method
+{
+    assert(i >= 0 && i < qn_);
+    const Truth_Entry &entry = entries_[i];
+    
+    u32 n = entry.num_;
+    if (n == 0) return; // the ground truth result is empty
+    ++g_nq_count;
+    
+    u32 m = result.size();
+    if (m == 0) return;
+    
+    // find overlap by the bitmap of truth results
+    u32 overlap = 0;
+    const char *data = data_ + entry.offset_;
+    if (entry.type_ == TRUTH_BITMAP) {
+        const u64 *bitmap = (const u64*) data;
+        for (int id : result) overlap += (bitmap[id >> 6] >> (id & 63)) & 1UL;
+    }
+    else {
+        const u32 *ids = (const u32*) data;
+        for (u32 j = 0; j < n; ++j) {
+            bitmap_[ids[j] >> 6] |= 1UL << (ids[j] & 63);
+        }
+        for (int id : result) overlap += (bitmap_[id >> 6] >> (id & 63)) & 1UL;
+        for (u32 j = 0; j < n; ++j) bitmap_[ids[j] >> 6] = 0UL;
+    }
+    
+    // overlap is not empty => we found some truth results
+    if (overlap > 0) {
+        double precision = (double) overlap / (double) m;
+        double recall    = (double) overlap / (double) n;
+        double f1score   = 2.0*precision*recall / (precision+recall);
+        
+        g_precision += precision;
+        g_recall    += recall;
+        g_f1score   += f1score;
+        ++g_nq_found;
+    }
+}
+
+} // end namespace ip
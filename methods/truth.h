@@ -0,0 +1,91 @@
+#pragma once
+
+#include <iostream>
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "def.h"
+#include "util.h"
+
+namespace ip {
+
+// -----------------------------------------------------------------------------
+//  Truth_Entry: the entry of the ground truth result of a query
+// -----------------------------------------------------------------------------
+struct Truth_Entry {
+    u64   offset_;                  // offset of result in the file (bytes)
+    u32   num_;                     // number of result ids
+    u32   type_;                    // TRUTH_IDS or TRUTH_BITMAP
+};
+
+// -----------------------------------------------------------------------------
+//  Truth_Set: the ground truth results of all queries for a k value, which is
+//  stored in a binary file <truth>_k=K.bin and loaded by mmap
+//
+//  Binary Format:
+//  1. header: TRUTH_MAGIC, qn, m, and 0 (four u32)
+//  2. entries: a Truth_Entry for each query
+//  3. results: the sorted u32 ids of each query, or a bitmap of m bits (in
+//     u64 words) for a dense result where 32*num > m
+//
+//  The truth set is evaluated with a bitmap of users, so the result from a
+//  method needs not to be sorted
+// -----------------------------------------------------------------------------
+class Truth_Set {
+public:
+    Truth_Set(                      // constructor
+        int   m);                       // user cardinality
+    
+    // -------------------------------------------------------------------------
+    ~Truth_Set();                   // destructor
+    
+    // -------------------------------------------------------------------------
+    void build(                     // build truth set in memory
+        int   qn,                       // query cardinality
+        const std::vector<std::vector<int> > &truth); // sorted truth results
+    
+    // -------------------------------------------------------------------------
+    int save(                       // save truth set to disk
+        int   k,                        // top-k value
+        const char *truth_addr);        // address of truth set
+    
+    // -------------------------------------------------------------------------
+    int load(                       // load truth set from disk
+        int   k,                        // top-k value
+        int   qn,                       // query cardinality
+        const char *truth_addr);        // address of truth set
+    
+    // -------------------------------------------------------------------------
+    void update_global_metric(      // update the global metric for a query
+        int   i,                        // ith query
+        const std::vector<int> &result);// result from a method
+    
+    // -------------------------------------------------------------------------
+    inline int size(int i) { return (int) entries_[i].num_; }
+
+protected:
+    int   m_;                       // user cardinality
+    int   qn_;                      // query cardinality
+    u64   words_;                   // # u64 words of a bitmap of m bits
+    u64   *bitmap_;                 // bitmap of users (buffer)
+    
+    char  *data_;                   // truth set (mmap or memory)
+    u64   size_;                    // size of truth set (bytes)
+    bool  mapped_;                  // is the truth set mapped by mmap
+    const Truth_Entry *entries_;    // entries of queries
+    
+    // -------------------------------------------------------------------------
+    void release();                 // release the truth set
+    
+    // -------------------------------------------------------------------------
+    bool is_valid(                  // is the mapped truth set well-formed
+        int   qn);                      // query cardinality
+};
+
+} // end namespace ip
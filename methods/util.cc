@@ -7,6 +7,11 @@ timeval g_end_time;                 // global param: end time
 
 double g_pre_time  = 0.0;           // global param: pre-processing time (ms)
 u64    g_memory    = 0;             // global param: memory usage (bytes)
+u64    g_heap_memory = 0;           // global param: measured memory (bytes)
+u64    g_build_rss = 0;             // global param: peak rss of build (bytes)
+int    g_huge_mode   = 0;           // global param: backing of big arrays
+u64    g_huge_mapped = 0;           // global param: mapped for huge pages
+u64    g_huge_backed = 0;           // global param: backed by huge pages
 
 u64    g_ip_count  = 0;             // global param: # ip computation counter
 int    g_nq_count  = 0;             // global param: # non-empty query counter
@@ -15,6 +20,13 @@ double g_run_time  = 0.0;           // global param: running time (ms)
 double g_recall    = 0.0;           // global param: recall (%)
 double g_precision = 0.0;           // global param: precision (%)
 double g_f1score   = 0.0;           // global param: f1-score (%)
+Histogram g_latency;                // global param: latency of queries (ns)
+Histogram g_ip_hist;                // global param: # ip of queries
+Prune_Stats g_prune;                // global param: pruning stage counters
+
+const char *STAGE_NAMES[NUM_STAGES] = { "blocks_lemma3", "blocks_cone", 
+    "users_cone", "users_lemma1", "users_lemma2", "users_kmips", 
+    "item_blocks", "item_early", "item_linear", "item_lsh", "candidates" };
 
 // -----------------------------------------------------------------------------
 //  Input & Output
@@ -53,6 +65,44 @@ int read_bin_data(                  // read binary data from disk
     return 0;
 }
 
+// -----------------------------------------------------------------------------
+int read_bin_data(                  // read a chunk of binary data from disk
+    u64   start,                        // start position (# data)
+    int   n,                            // number of data of this chunk
+    int   d,                            // dimensionality
+    const char *fname,                  // address of data
+    float *data)                        // data (return)
+{
+    FILE *fp = fopen(fname, "rb");
+    if (!fp) { printf("Could not open %s\n", fname); return 1; }
+    
+    u64 size = (u64) n*d;
+    if (fseeko(fp, (off_t) (start*d*sizeof(float)), SEEK_SET) != 0 || 
+        fread(data, sizeof(float), size, fp) != size) {
+        printf("Could not read %d data from %s\n", n, fname); 
+        fclose(fp); return 1;
+    }
+    fclose(fp);
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+int read_user_attrs(                // read attributes of users from disk
+    int   m,                            // number of users
+    const char *fname,                  // address of attributes (u64 per user)
+    u64   *attrs)                       // attributes of users (return)
+{
+    FILE *fp = fopen(fname, "rb");
+    if (!fp) { printf("Could not open %s\n", fname); return 1; }
+    
+    if (fread(attrs, sizeof(u64), m, fp) != (u64) m) {
+        printf("Could not read %d attributes from %s\n", m, fname);
+        fclose(fp); return 1;
+    }
+    fclose(fp);
+    return 0;
+}
+
 // -----------------------------------------------------------------------------
 void get_csv_from_line(             // get an array with csv format from a line
     std::string str_data,               // a string line
@@ -122,6 +172,44 @@ int write_ground_truth(             // write ground truth results to disk
     return 0;
 }
 
+// -----------------------------------------------------------------------------
+void write_ground_truth_part(       // append partial truth of a chunk to disk
+    int   i,                            // ith query
+    int   start,                        // start user id of this chunk
+    std::vector<int> &result,           // result of this chunk (allow modify)
+    FILE  *fp)                          // file pointer (return)
+{
+    // record format: query id, # results, and the (global) user ids
+    int num = (int) result.size();
+    for (int j = 0; j < num; ++j) result[j] += start;
+    
+    fwrite(&i,   sizeof(int), 1, fp);
+    fwrite(&num, sizeof(int), 1, fp);
+    fwrite(result.data(), sizeof(int), num, fp);
+}
+
+// -----------------------------------------------------------------------------
+int read_ground_truth_part(         // read partial truth of all chunks
+    int   qn,                           // query cardinality
+    FILE  *fp,                          // file pointer
+    std::vector<std::vector<int> > &truth) // ground truth results (return)
+{
+    truth.clear(); truth.resize(qn);
+    rewind(fp);
+    
+    int i = -1, num = -1;
+    while (fread(&i, sizeof(int), 1, fp) == 1) {
+        if (fread(&num, sizeof(int), 1, fp) != 1 || i < 0 || i >= qn) return 1;
+        
+        std::vector<int> &result = truth[i];
+        u64 size = result.size();
+        result.resize(size + num);
+        int *ids = result.data() + size;
+        if (fread(ids, sizeof(int), num, fp) != (u64) num) return 1;
+    }
+    return 0;
+}
+
 // -----------------------------------------------------------------------------
 void output_reverse_kmips_results(  // output reverse kmips result for query
     int   i,                            // ith query
@@ -141,6 +229,33 @@ void output_reverse_kmips_results(  // output reverse kmips result for query
     fclose(fp);
 }
 
+// -----------------------------------------------------------------------------
+u64 get_peak_rss()                  // get the peak rss (bytes) (0: unknown)
+{
+    FILE *fp = fopen("/proc/self/status", "r");
+    if (!fp) return 0UL;
+    
+    char line[256];
+    u64  peak = 0UL; // VmHWM in kB
+    while (fgets(line, sizeof(line), fp)) {
+        if (sscanf(line, "VmHWM: %lu kB", &peak) == 1) break;
+    }
+    fclose(fp);
+    return peak * 1024UL;
+}
+
+// -----------------------------------------------------------------------------
+void reset_peak_rss()               // reset the peak rss to the current rss
+{
+    // writing "5" to clear_refs resets VmHWM (linux >= 4.0); otherwise, the 
+    // peak rss is since the start of this process
+    FILE *fp = fopen("/proc/self/clear_refs", "w");
+    if (!fp) return;
+    
+    fputs("5", fp);
+    fclose(fp);
+}
+
 // -----------------------------------------------------------------------------
 void write_index_info(              // display & write index overhead info
     FILE *fp)                           // file pointer (return)
@@ -148,19 +263,86 @@ void write_index_info(              // display & write index overhead info
     double memory = g_memory / 1048576.0;// convert bytes into megabytes
     
     printf("Indexing Time: %g Seconds\n", g_pre_time);
-    printf("Estimated Mem: %g MB\n\n", memory);
+    printf("Estimated Mem: %g MB\n", memory);
 
     fprintf(fp, "Indexing Time: %g Seconds\n", g_pre_time);
     fprintf(fp, "Estimated Memory: %g MB\n", memory);
+    
+    // the measured memory of the index (its arrays & arenas), the heap of 
+    // its build phases (by huge_alloc(), net of frees), and the peak rss of 
+    // build
+    if (g_heap_memory > 0UL) {
+        printf("Measured Mem: %g MB\n", g_heap_memory / 1048576.0);
+        fprintf(fp, "Measured Memory: %g MB\n", g_heap_memory / 1048576.0);
+    }
+    if (g_heap_bytes.load() > 0UL) {
+        for (int i = PHASE_NORM_SORT; i <= PHASE_HASHING; ++i) {
+            double heap = g_perf.get_heap(i) / 1048576.0;
+            printf("Heap (%s): %g MB\n", PHASE_NAMES[i], heap);
+            fprintf(fp, "Heap (%s): %g MB\n", PHASE_NAMES[i], heap);
+        }
+    }
+    if (g_build_rss > 0UL) {
+        printf("Peak RSS (build): %g MB\n", g_build_rss / 1048576.0);
+        fprintf(fp, "Peak RSS (build): %g MB\n", g_build_rss / 1048576.0);
+    }
+    // the big arrays mapped for huge pages and those actually backed by them
+    if (g_huge_mode != HUGE_OFF) {
+        double mapped = g_huge_mapped / 1048576.0;
+        double backed = g_huge_backed / 1048576.0;
+        const char *mode = HUGE_MODE_NAMES[g_huge_mode];
+        
+        printf("Huge Pages (%s): %g MB of %g MB\n", mode, backed, mapped);
+        fprintf(fp, "Huge Pages (%s): %g MB of %g MB\n", mode, backed, mapped);
+    }
+    printf("\n");
+    
+    // the hardware counters of build phases (since the last index) if any
+    if (!g_perf.enabled()) {
+        g_perf.reset(PHASE_NORM_SORT, PHASE_HASHING);
+        return;
+    }
+    for (int i = PHASE_NORM_SORT; i <= PHASE_HASHING; ++i) {
+        printf("Counters (%s):", PHASE_NAMES[i]);
+        fprintf(fp, "Counters (%s):", PHASE_NAMES[i]);
+        for (int j = 0; j < NUM_EVENTS; ++j) {
+            printf(" %s=%.0f", EVENT_NAMES[j], g_perf.get(i, j));
+            fprintf(fp, " %s=%.0f", EVENT_NAMES[j], g_perf.get(i, j));
+        }
+        printf("\n"); fprintf(fp, "\n");
+    }
+    printf("\n");
+    g_perf.reset(PHASE_NORM_SORT, PHASE_HASHING);
 }
 
 // -----------------------------------------------------------------------------
-void head(                          // display head with method name
-    const char *method_name)            // method name
+void head(                          // display & write head with method name
+    const char *method_name,            // method name
+    FILE  *fp)                          // file pointer (return)
 {
     printf("%s for Reverse k-Maximum Inner Product Search:\n", method_name); 
     printf("Top-k\t\tTime (ms)\t# IP Comput.\t# Non-Empty Qs\tMiss Rate (%%)\t"
         "Precision (%%)\tRecall (%%)\tF1-score (%%)\n");
+    write_head(fp);
+}
+
+// -----------------------------------------------------------------------------
+void write_head(                    // write names of the columns of results
+    FILE  *fp)                          // file pointer (return)
+{
+    // the columns follow the order of calc_and_write_global_metric
+    fprintf(fp, "top_k\ttime_ms\tip\tnon_empty_qs\tmiss_rate\tprecision\t"
+        "recall\tf1score");
+    for (double p : PCTs) fprintf(fp, "\ttime_ms_p%g", p);
+    for (double p : PCTs) fprintf(fp, "\tip_p%g", p);
+    for (int i = 0; i < NUM_STAGES; ++i) fprintf(fp, "\t%s", STAGE_NAMES[i]);
+    fprintf(fp, "\tpeak_rss_mb");
+    for (int i = PHASE_USER_SCAN; i <= PHASE_KMIPS; ++i) {
+        for (int j = 0; j < NUM_EVENTS; ++j) {
+            fprintf(fp, "\t%s_%s", PHASE_NAMES[i], EVENT_NAMES[j]);
+        }
+    }
+    fprintf(fp, "\n");
 }
 
 // -----------------------------------------------------------------------------
@@ -171,7 +353,7 @@ void write_params(                  // write parameters
 {
     fprintf(fp, "seed=%d, b=%g\n", RANDOM_SEED, b);
     printf("seed=%d, b=%g\n", RANDOM_SEED, b);
-    head(method_name);
+    head(method_name, fp);
 }
 
 // -----------------------------------------------------------------------------
@@ -183,7 +365,18 @@ void write_params(                  // write parameters
 {
     fprintf(fp, "seed=%d, K=%d, b=%g\n", RANDOM_SEED, K, b);
     printf("seed=%d, K=%d, b=%g\n", RANDOM_SEED, K, b);
-    head(method_name);
+    head(method_name, fp);
+}
+
+// -----------------------------------------------------------------------------
+void write_params_leaf(             // write parameters
+    int   leaf,                         // leaf size of Cone-Tree
+    const char *method_name,            // method name
+    FILE  *fp)                          // file pointer (return)
+{
+    fprintf(fp, "seed=%d, leaf=%d\n", RANDOM_SEED, leaf);
+    printf("seed=%d, leaf=%d\n", RANDOM_SEED, leaf);
+    head(method_name, fp);
 }
 
 // -----------------------------------------------------------------------------
@@ -195,7 +388,7 @@ void write_params_leaf(             // write parameters
 {
     fprintf(fp, "seed=%d, leaf=%d, b=%g\n", RANDOM_SEED, leaf, b);
     printf("seed=%d, leaf=%d, b=%g\n", RANDOM_SEED, leaf, b);
-    head(method_name);
+    head(method_name, fp);
 }
 
 // -----------------------------------------------------------------------------
@@ -208,7 +401,7 @@ void write_params(                  // write parameters
 {
     fprintf(fp, "seed=%d, K=%d, leaf=%d, b=%g\n", RANDOM_SEED, K, leaf, b);
     printf("seed=%d, K=%d, leaf=%d, b=%g\n", RANDOM_SEED, K, leaf, b);
-    head(method_name);
+    head(method_name, fp);
 }
 
 // -----------------------------------------------------------------------------
@@ -230,6 +423,12 @@ void init_global_metric()           // init the global metric
     g_precision = 0.0;
     g_recall    = 0.0;
     g_f1score   = 0.0;
+    
+    g_latency.reset();
+    g_ip_hist.reset();
+    g_prune.reset();
+    g_perf.reset(PHASE_USER_SCAN, PHASE_KMIPS);
+    reset_peak_rss();
 }
 
 // -----------------------------------------------------------------------------
@@ -271,40 +470,138 @@ void update_global_metric(          // init the global metric
 }
 
 // -----------------------------------------------------------------------------
-void calc_and_write_global_metric(  // init the global metric
-    int  top_k,                         // top-k value
-    int  qn,                            // number of queries
-    FILE *fp)                           // file pointer
+void calc_global_metric(            // calc the averaged global metric
+    int   qn,                           // number of queries
+    Metric &metric)                     // global metric (return)
 {
-    double avg_time = g_run_time * 1000.0 / qn;
-    u64    avg_ip   = (u64) ceil((double) g_ip_count / qn);
+    metric.time_     = g_run_time * 1000.0 / qn;
+    metric.ip_       = (u64) ceil((double) g_ip_count / qn);
+    metric.nq_count_ = g_nq_count;
+    metric.nq_found_ = g_nq_found;
+    
+    // the percentiles of the queries recorded (0 if none)
+    metric.time_pcts_.resize(PCTs.size());
+    metric.ip_pcts_.resize(PCTs.size());
+    for (int i = 0; i < (int) PCTs.size(); ++i) {
+        metric.time_pcts_[i] = g_latency.percentile(PCTs[i]) / 1000000.0;
+        metric.ip_pcts_[i]   = g_ip_hist.percentile(PCTs[i]);
+    }
+    metric.prune_.resize(NUM_STAGES);
+    for (int i = 0; i < NUM_STAGES; ++i) {
+        metric.prune_[i] = (double) g_prune[i] / qn;
+    }
+    metric.peak_rss_ = get_peak_rss();
+    metric.perf_.clear();
+    for (int i = PHASE_USER_SCAN; i <= PHASE_KMIPS; ++i) {
+        for (int j = 0; j < NUM_EVENTS; ++j) {
+            double cnt = g_perf.enabled() ? g_perf.get(i, j) : -1.0;
+            metric.perf_.push_back(cnt < 0.0 ? -1.0 : cnt / qn);
+        }
+    }
     
-    double miss_rate = 0.0;
-    double avg_pre   = 0.0;
-    double avg_rec   = 0.0;
-    double avg_f1    = 0.0;
+    metric.miss_rate_ = 0.0;
+    metric.precision_ = 0.0;
+    metric.recall_    = 0.0;
+    metric.f1score_   = 0.0;
     
     if (g_nq_count > 0) {
-        miss_rate = (g_nq_count - g_nq_found) * 100.0 / g_nq_count;
+        metric.miss_rate_ = (g_nq_count - g_nq_found) * 100.0 / g_nq_count;
         if (g_nq_found > 0) {
-            avg_pre   = g_precision * 100.0 / g_nq_found;
-            avg_rec   = g_recall    * 100.0 / g_nq_found;
-            avg_f1    = g_f1score   * 100.0 / g_nq_found;
+            metric.precision_ = g_precision * 100.0 / g_nq_found;
+            metric.recall_    = g_recall    * 100.0 / g_nq_found;
+            metric.f1score_   = g_f1score   * 100.0 / g_nq_found;
         }
     }
     else {
-        miss_rate = 0.0;
-        avg_pre   = 100.0;
-        avg_rec   = 100.0;
-        avg_f1    = 100.0;
+        metric.precision_ = 100.0;
+        metric.recall_    = 100.0;
+        metric.f1score_   = 100.0;
     }
+}
+
+// -----------------------------------------------------------------------------
+u64 calc_dataset_hash(              // calc the hash of item_set and user_set
+    int   n,                            // item cardinality
+    int   m,                            // user cardinality
+    int   d,                            // dimensionality
+    const float *item_set,              // item set
+    const float *user_set)              // user set
+{
+    // FNV-1a hash over the 32-bit words of (n, m, d, item_set, user_set)
+    const u64 prime = 1099511628211UL;
+    u64 hash = 14695981039346656037UL;
+    
+    u32 sizes[3] = { (u32) n, (u32) m, (u32) d };
+    for (int i = 0; i < 3; ++i) { hash ^= sizes[i]; hash *= prime; }
+    
+    const u32 *items = (const u32*) item_set;
+    for (u64 i = 0; i < (u64) n*d; ++i) { hash ^= items[i]; hash *= prime; }
+    
+    const u32 *users = (const u32*) user_set;
+    for (u64 i = 0; i < (u64) m*d; ++i) { hash ^= users[i]; hash *= prime; }
+    
+    return hash;
+}
+
+// -----------------------------------------------------------------------------
+void calc_and_write_global_metric(  // init the global metric
+    int  top_k,                         // top-k value
+    int  qn,                            // number of queries
+    FILE *fp)                           // file pointer
+{
+    Metric metric; calc_global_metric(qn, metric);
+    
+    double avg_time  = metric.time_;
+    u64    avg_ip    = metric.ip_;
+    double miss_rate = metric.miss_rate_;
+    double avg_pre   = metric.precision_;
+    double avg_rec   = metric.recall_;
+    double avg_f1    = metric.f1score_;
     
     printf("%3d\t\t%.3f\t\t%lu\t\t%d (%d)\t\t%.3f\t\t%.3f\t\t%.3f\t\t%.3f\n", 
         top_k, avg_time, avg_ip, g_nq_count, g_nq_found, miss_rate, 
         avg_pre, avg_rec, avg_f1);
-    fprintf(fp, "%d\t%lf\t%lu\t%d (%d)\t%lf\t%lf\t%lf\t%lf\n", 
+    fprintf(fp, "%d\t%lf\t%lu\t%d (%d)\t%lf\t%lf\t%lf\t%lf", 
         top_k, avg_time, avg_ip, g_nq_count, g_nq_found, miss_rate, 
         avg_pre, avg_rec, avg_f1);
+    
+    // the percentiles (p50, p90, p99, p99.9, max) of query time (ms) and # ip 
+    // computations follow the averages
+    printf("\t\tTime (ms) p50/p90/p99/p99.9/max:");
+    for (double t : metric.time_pcts_) printf(" %.3f", t);
+    printf("\n\t\t# IP      p50/p90/p99/p99.9/max:");
+    for (u64 ip : metric.ip_pcts_) printf(" %lu", ip);
+    printf("\n");
+    
+    // the average counters of pruning stages (STAGE_NAMES) per query follow
+    // the percentiles
+    printf("\t\tPruning per query:");
+    for (int i = 0; i < NUM_STAGES; ++i) {
+        printf(" %s=%.1f", STAGE_NAMES[i], metric.prune_[i]);
+    }
+    printf("\n");
+    
+    // the peak rss (MB) of the queries follows the pruning stages
+    printf("\t\tPeak RSS (query): %g MB\n", metric.peak_rss_ / 1048576.0);
+    
+    // the average hardware counters (EVENT_NAMES) per query of user_scan and 
+    // kmips follow the peak rss (-1 if not captured)
+    int num_perf = g_perf.enabled() ? (int) metric.perf_.size() : 0;
+    for (int i = 0; i < num_perf; ++i) {
+        if (i % NUM_EVENTS == 0) {
+            printf("\t\tCounters per query (%s):", 
+                PHASE_NAMES[PHASE_USER_SCAN + i / NUM_EVENTS]);
+        }
+        printf(" %s=%.0f", EVENT_NAMES[i % NUM_EVENTS], metric.perf_[i]);
+        if (i % NUM_EVENTS == NUM_EVENTS - 1) printf("\n");
+    }
+    
+    for (double t : metric.time_pcts_) fprintf(fp, "\t%lf", t);
+    for (u64 ip : metric.ip_pcts_) fprintf(fp, "\t%lu", ip);
+    for (double c : metric.prune_) fprintf(fp, "\t%lf", c);
+    fprintf(fp, "\t%lf", metric.peak_rss_ / 1048576.0);
+    for (double c : metric.perf_) fprintf(fp, "\t%lf", c);
+    fprintf(fp, "\n");
 }
 
 // -----------------------------------------------------------------------------
@@ -391,7 +688,7 @@ float calc_l2_dist(                 // calc l_2 distance
 }
 
 // -----------------------------------------------------------------------------
-float calc_inner_product(           // calc inner product
+float calc_inner_product_generic(   // calc inner product (sequential)
     int   dim,                          // dimensionality
     const float *p1,                    // 1st point
     const float *p2)                    // 2nd point
@@ -402,6 +699,118 @@ float calc_inner_product(           // calc inner product
     return ret;
 }
 
+// -----------------------------------------------------------------------------
+void calc_inner_products_lanes(     // calc inner products of a tile by lanes
+    int   m,                            // number of 1st points
+    int   n,                            // number of 2nd points
+    int   dim,                          // dimensionality
+    const float *p1,                    // 1st points (m x dim)
+    const float *p2,                    // 2nd points (transposed, dim x n)
+    float *ips)                         // inner products (m x n) (return)
+{
+    // NOTE: each inner product is accumulated by IP_LANES partial sums in 
+    // the same order as that of the fixed-dim calc_inner_product, so the 
+    // results are exactly the same; the IP_LANES x 4 register blocks reuse 
+    // the loaded values of p2
+    const int L = IP_LANES, NB = 4;
+    int   dim0 = dim - dim % L;     // the tail goes to the first lanes
+    float s[L];
+    for (int i = 0; i < m; ++i) {
+        const float *x = p1 + (u64) i*dim;
+        float *ip = ips + (u64) i*n;
+        
+        int j = 0;
+        for (; j + NB <= n; j += NB) {
+            float acc[L][NB] = { { 0.0f } };
+            for (int l = 0; l < dim0; l += L) {
+                for (int t = 0; t < L; ++t) {
+                    const float *y = p2 + (u64) (l+t)*n + j;
+                    for (int c = 0; c < NB; ++c) acc[t][c] += x[l+t] * y[c];
+                }
+            }
+            for (int l = dim0; l < dim; ++l) {
+                const float *y = p2 + (u64) l*n + j;
+                for (int c = 0; c < NB; ++c) acc[l-dim0][c] += x[l] * y[c];
+            }
+            for (int c = 0; c < NB; ++c) {
+                for (int t = 0; t < L; ++t) s[t] = acc[t][c];
+                ip[j+c] = sum_lanes(s);
+            }
+        }
+        for (; j < n; ++j) {
+            std::fill(s, s+L, 0.0f);
+            for (int l = 0; l < dim0; l += L) {
+                for (int t = 0; t < L; ++t) {
+                    s[t] += x[l+t] * p2[(u64) (l+t)*n + j];
+                }
+            }
+            for (int l = dim0; l < dim; ++l) {
+                s[l-dim0] += x[l] * p2[(u64) l*n + j];
+            }
+            ip[j] = sum_lanes(s);
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+void calc_inner_products(           // calc inner products of a tile
+    int   m,                            // number of 1st points
+    int   n,                            // number of 2nd points
+    int   dim,                          // dimensionality
+    const float *p1,                    // 1st points (m x dim)
+    const float *p2,                    // 2nd points (transposed, dim x n)
+    float *ips)                         // inner products (m x n) (return)
+{
+    if (is_fixed_dim(dim)) {
+        calc_inner_products_lanes(m, n, dim, p1, p2, ips); return;
+    }
+    // NOTE: each inner product is accumulated in the same order as that of 
+    // calc_inner_product, so the results are exactly the same; the 4 x 8 
+    // register blocks reuse the loaded values of p1 and p2
+    const int MB = 4, NB = 8;
+    int i = 0;
+    for (; i + MB <= m; i += MB) {
+        const float *x0 = p1 + (u64) i*dim;
+        const float *x1 = x0 + dim;
+        const float *x2 = x1 + dim;
+        const float *x3 = x2 + dim;
+        
+        int j = 0;
+        for (; j + NB <= n; j += NB) {
+            float acc[MB][NB] = { { 0.0f } };
+            for (int l = 0; l < dim; ++l) {
+                const float *y = p2 + (u64) l*n + j;
+                for (int c = 0; c < NB; ++c) {
+                    acc[0][c] += x0[l] * y[c];
+                    acc[1][c] += x1[l] * y[c];
+                    acc[2][c] += x2[l] * y[c];
+                    acc[3][c] += x3[l] * y[c];
+                }
+            }
+            for (int r = 0; r < MB; ++r) {
+                std::copy(acc[r], acc[r]+NB, ips + (u64) (i+r)*n + j);
+            }
+        }
+        for (; j < n; ++j) {
+            float acc[MB] = { 0.0f };
+            for (int l = 0; l < dim; ++l) {
+                float y = p2[(u64) l*n + j];
+                acc[0] += x0[l] * y; acc[1] += x1[l] * y;
+                acc[2] += x2[l] * y; acc[3] += x3[l] * y;
+            }
+            for (int r = 0; r < MB; ++r) ips[(u64) (i+r)*n + j] = acc[r];
+        }
+    }
+    for (; i < m; ++i) {
+        const float *x = p1 + (u64) i*dim;
+        for (int j = 0; j < n; ++j) {
+            float acc = 0.0f;
+            for (int l = 0; l < dim; ++l) acc += x[l] * p2[(u64) l*n + j];
+            ips[(u64) i*n + j] = acc;
+        }
+    }
+}
+
 // -----------------------------------------------------------------------------
 float calc_cosine_angle(            // calc cosine angle, [-1,1]
     int   dim,                          // dimensionality
@@ -485,6 +894,56 @@ float shift_data_and_norms(         // calc shifted data and their l2-norm sqrs
     return max_norm_sqr;
 }
 
+// -----------------------------------------------------------------------------
+void normalize_data(                // normalize data to unit l2-norms
+    int   n,                            // number of data vectors
+    int   d,                            // dimensionality
+    const float *data,                  // data vectors
+    float *norms,                       // l2-norms (return, nullptr: none)
+    float *norm_data)                   // normalized data vectors (return)
+{
+    for (int i = 0; i < n; ++i) {
+        const float *point = data + (u64) i*d;
+        float norm = sqrt(calc_inner_product(d, point, point));
+        if (norms != nullptr) norms[i] = norm;
+        
+        float *new_point = norm_data + (u64) i*d;
+        for (int j = 0; j < d; ++j) new_point[j] = point[j] / norm;
+    }
+}
+
+// -----------------------------------------------------------------------------
+void sort_by_norm(                  // sort data in descending order of l2-norm
+    int   n,                            // number of data vectors
+    int   d,                            // dimensionality
+    const float *data,                  // data vectors
+    int   *data_index,                  // index of sorted data (return)
+    float *data_norms,                  // l2-norms of sorted data (return)
+    float *data_set)                    // sorted data vectors (return)
+{
+    Perf_Scope perf(PHASE_NORM_SORT);
+    
+    // compute l2-norms for data
+    Result *ret = new Result[n];
+    for (int i = 0; i < n; ++i) {
+        const float *point = data + (u64) i*d;
+        ret[i].id_  = i;
+        ret[i].key_ = sqrt(calc_inner_product(d, point, point));
+    }
+    // sort the l2-norms in descending order
+    qsort(ret, n, sizeof(Result), ResultCompDesc);
+    
+    // init data_index, data_norms, and data_set
+    for (int i = 0; i < n; ++i) {
+        data_index[i] = ret[i].id_;
+        data_norms[i] = ret[i].key_;
+        
+        const float *point = data + (u64) data_index[i]*d;
+        std::copy(point, point + d, data_set + (u64) i*d);
+    }
+    delete[] ret;
+}
+
 // -----------------------------------------------------------------------------
 void linear_scan(                   // linear scan user_set for k-mips
     int   m,                            // number of user vectors
@@ -494,7 +953,7 @@ void linear_scan(                   // linear scan user_set for k-mips
     const float *user_set,              // user vectors
     std::vector<int> &result)           // top-k results (return)
 {
-    gettimeofday(&g_start_time, nullptr);
+    double start_time = get_time();
     std::vector<int>().swap(result);// clear space for result
     
     // find top-k mips results from user_set
@@ -511,11 +970,11 @@ void linear_scan(                   // linear scan user_set for k-mips
     for (int i = 0; i < k; ++i) result[i] = list->ith_id(i);
     
     delete list;
-    gettimeofday(&g_end_time, nullptr);
     
-    double query_time = g_end_time.tv_sec - g_start_time.tv_sec + 
-        (g_end_time.tv_usec - g_start_time.tv_usec) / 1000000.0;
+    double query_time = get_time() - start_time;
     g_run_time += query_time;
+    g_latency.add((u64) (query_time * 1000000000.0));
+    g_ip_hist.add((u64) m);
 }
 
 } // end namespace ip
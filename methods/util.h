@@ -22,6 +22,10 @@
 
 #include "def.h"
 #include "pri_queue.h"
+#include "histogram.h"
+#include "perf.h"
+#include "huge_page.h"
+#include "topology.h"
 
 namespace ip {
 
@@ -30,6 +34,11 @@ extern timeval g_end_time;          // global param: end time
 
 extern double g_pre_time;           // global param: pre-processing time (ms)
 extern u64    g_memory;             // global param: memory usage (bytes)
+extern u64    g_heap_memory;        // global param: measured memory (bytes)
+extern u64    g_build_rss;          // global param: peak rss of build (bytes)
+extern int    g_huge_mode;          // global param: backing of big arrays
+extern u64    g_huge_mapped;        // global param: mapped for huge pages
+extern u64    g_huge_backed;        // global param: backed by huge pages
 
 extern u64    g_ip_count;           // global param: # ip computation counter
 extern int    g_nq_count;           // global param: # non-empty query counter
@@ -38,6 +47,75 @@ extern double g_run_time;           // global param: running time (ms)
 extern double g_recall;             // global param: recall (%)
 extern double g_precision;          // global param: precision (%)
 extern double g_f1score;            // global param: f1-score (%)
+extern Histogram g_latency;         // global param: latency of queries (ns)
+extern Histogram g_ip_hist;         // global param: # ip of queries
+
+// -----------------------------------------------------------------------------
+//  Prune_Stats: the counters of the pruning stages of reverse k-mips, where a
+//  user (or a user block) is counted by the first stage deciding it, and the
+//  item stages are counted over all k-mips of the users
+// -----------------------------------------------------------------------------
+enum Prune_Stage {
+    STAGE_BLOCK_LEMMA3 = 0,         // # user blocks pruned by lemma 3
+    STAGE_BLOCK_CONE,               // # user blocks pruned by node upper bound
+    STAGE_USER_CONE,                // # users pruned by point upper bound
+    STAGE_USER_LEMMA1,              // # users pruned by lemma 1
+    STAGE_USER_LEMMA2,              // # users accepted by lemma 2
+    STAGE_USER_KMIPS,               // # users verified by k-mips
+    STAGE_ITEM_VISIT,               // # item blocks visited by k-mips
+    STAGE_ITEM_EARLY,               // # item blocks pruned early (stop k-mips)
+    STAGE_ITEM_LINEAR,              // # item blocks scanned linearly
+    STAGE_ITEM_LSH,                 // # item blocks served by srp-lsh/qalsh
+    STAGE_CANDIDATE,                // # candidate items verified by k-mips
+    NUM_STAGES                      // # pruning stages
+};
+
+extern const char *STAGE_NAMES[NUM_STAGES]; // names of pruning stages
+
+struct Prune_Stats {
+    u64   count_[NUM_STAGES];       // counter of each pruning stage
+    
+    // -------------------------------------------------------------------------
+    void reset() { memset(count_, 0, sizeof(count_)); }
+    
+    // -------------------------------------------------------------------------
+    void add(const Prune_Stats &other) {
+        for (int i = 0; i < NUM_STAGES; ++i) count_[i] += other.count_[i];
+    }
+    
+    // -------------------------------------------------------------------------
+    u64 &operator[](int stage) { return count_[stage]; }
+};
+
+extern Prune_Stats g_prune;         // global param: pruning stage counters
+
+// -----------------------------------------------------------------------------
+inline double get_time()            // get the monotonic time (seconds)
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+// -----------------------------------------------------------------------------
+//  Metric: the averaged global metric of the queries for a top-k value
+// -----------------------------------------------------------------------------
+struct Metric {
+    double time_;                   // average query time (ms)
+    u64    ip_;                     // average # ip computations
+    int    nq_count_;               // # non-empty queries
+    int    nq_found_;               // # non-empty queries found
+    double miss_rate_;              // miss rate (%)
+    double precision_;              // average precision (%)
+    double recall_;                 // average recall (%)
+    double f1score_;                // average f1-score (%)
+    std::vector<double> time_pcts_; // percentiles of query time (ms) (PCTs)
+    std::vector<u64>    ip_pcts_;   // percentiles of # ip computations (PCTs)
+    std::vector<double> prune_;     // average counters of pruning stages
+    u64    peak_rss_;               // peak rss of queries (bytes) (0: none)
+    std::vector<double> perf_;      // average hardware counters of query 
+                                    // phases (-1: not captured)
+};
 
 // -----------------------------------------------------------------------------
 //  Input & Output
@@ -52,6 +130,20 @@ int read_bin_data(                  // read binary data from disk
     const char *fname,                  // address of data
     float *data);                       // data (return)
 
+// -----------------------------------------------------------------------------
+int read_bin_data(                  // read a chunk of binary data from disk
+    u64   start,                        // start position (# data)
+    int   n,                            // number of data of this chunk
+    int   d,                            // dimensionality
+    const char *fname,                  // address of data
+    float *data);                       // data (return)
+
+// -----------------------------------------------------------------------------
+int read_user_attrs(                // read attributes of users from disk
+    int   m,                            // number of users
+    const char *fname,                  // address of attributes (u64 per user)
+    u64   *attrs);                      // attributes of users (return)
+
 // -----------------------------------------------------------------------------
 int read_ground_truth(              // read ground truth results from disk
     int   k,                            // top-k value
@@ -66,19 +158,43 @@ int write_ground_truth(             // write ground truth results to disk
     const char *truth_addr,             // address of truth set
     std::vector<std::vector<int> > &truth); // truth result (allow modify)
 
+// -----------------------------------------------------------------------------
+void write_ground_truth_part(       // append partial truth of a chunk to disk
+    int   i,                            // ith query
+    int   start,                        // start user id of this chunk
+    std::vector<int> &result,           // result of this chunk (allow modify)
+    FILE  *fp);                         // file pointer (return)
+
+// -----------------------------------------------------------------------------
+int read_ground_truth_part(         // read partial truth of all chunks
+    int   qn,                           // query cardinality
+    FILE  *fp,                          // file pointer
+    std::vector<std::vector<int> > &truth); // ground truth results (return)
+
 // -----------------------------------------------------------------------------
 void output_reverse_kmips_results(  // output reverse kmips result for query
     int   i,                            // ith query
     const std::vector<int> &result,     // reverse kmips result
     const char *fname);                 // address of output file
 
+// -----------------------------------------------------------------------------
+u64 get_peak_rss();                 // get the peak rss (bytes) (0: unknown)
+
+// -----------------------------------------------------------------------------
+void reset_peak_rss();              // reset the peak rss to the current rss
+
 // -----------------------------------------------------------------------------
 void write_index_info(              // display & write index overhead info
     FILE *fp);                          // file pointer (return)
 
 // -----------------------------------------------------------------------------
-void head(                          // display head with method name
-    const char *method_name);           // method name
+void head(                          // display & write head with method name
+    const char *method_name,            // method name
+    FILE  *fp);                         // file pointer (return)
+
+// -----------------------------------------------------------------------------
+void write_head(                    // write names of the columns of results
+    FILE  *fp);                         // file pointer (return)
 
 // -----------------------------------------------------------------------------
 void write_params(                  // write parameters
@@ -93,6 +209,12 @@ void write_params(                  // write parameters
     const char *method_name,            // method name
     FILE  *fp);                         // file pointer (return)
 
+// -----------------------------------------------------------------------------
+void write_params_leaf(             // write parameters
+    int   leaf,                         // leaf size of Cone-Tree
+    const char *method_name,            // method name
+    FILE  *fp);                         // file pointer (return)
+
 // -----------------------------------------------------------------------------
 void write_params_leaf(             // write parameters
     int   leaf,                         // leaf size of Cone-Tree
@@ -120,6 +242,19 @@ void update_global_metric(          // init the global metric
     const std::vector<int> &truth,      // ground truth result
     std::vector<int> &result);          // result from a method (allow modify)
 
+// -----------------------------------------------------------------------------
+void calc_global_metric(            // calc the averaged global metric
+    int   qn,                           // number of queries
+    Metric &metric);                    // global metric (return)
+
+// -----------------------------------------------------------------------------
+u64 calc_dataset_hash(              // calc the hash of item_set and user_set
+    int   n,                            // item cardinality
+    int   m,                            // user cardinality
+    int   d,                            // dimensionality
+    const float *item_set,              // item set
+    const float *user_set);             // user set
+
 // -----------------------------------------------------------------------------
 void calc_and_write_global_metric(  // init the global metric
     int  top_k,                         // top-k value
@@ -175,11 +310,83 @@ float calc_l2_dist(                 // calc l_2 distance
     const float *p2);                   // 2nd point
 
 // -----------------------------------------------------------------------------
-float calc_inner_product(           // calc inner product
+//  Inner product kernels: the dimensions of our datasets (100, 128, 150, 256, 
+//  420, 960) have fixed-dim kernels with known trip counts, which accumulate 
+//  the products by IP_LANES partial sums (lane j sums the products of the 
+//  dimensions i % IP_LANES == j), so they are vectorized without re-ordering 
+//  the additions of a lane. Other dimensions use the sequential kernel. The 
+//  kernel is selected by a switch on dim, which is inlined and hoisted out of 
+//  the loops over users and items, and calc_inner_products accumulates in the 
+//  same order, so the inner products are exactly the same everywhere
+// -----------------------------------------------------------------------------
+const int IP_LANES = 8;             // partial sums of fixed-dim kernels
+
+// -----------------------------------------------------------------------------
+inline bool is_fixed_dim(           // has a fixed-dim kernel?
+    int   dim)                          // dimensionality
+{
+    return dim == 100 || dim == 128 || dim == 150 || dim == 256 || 
+        dim == 420 || dim == 960;
+}
+
+// -----------------------------------------------------------------------------
+inline float sum_lanes(             // sum IP_LANES partial sums
+    const float *s)                     // partial sums
+{
+    // the pairwise tree below is written out for 8 lanes (the order of the 
+    // additions must be the same everywhere)
+    static_assert(IP_LANES == 8, "sum_lanes() sums exactly 8 lanes");
+    return ((s[0] + s[4]) + (s[1] + s[5])) + ((s[2] + s[6]) + (s[3] + s[7]));
+}
+
+// -----------------------------------------------------------------------------
+template<int D>
+inline float calc_inner_product(    // calc inner product (fixed-dim)
+    const float *p1,                    // 1st point
+    const float *p2)                    // 2nd point
+{
+    const int D0 = D - D % IP_LANES; // the tail goes to the first lanes
+    float s[IP_LANES] = { 0.0f };
+    for (int i = 0; i < D0; i += IP_LANES) {
+        for (int j = 0; j < IP_LANES; ++j) s[j] += p1[i+j] * p2[i+j];
+    }
+    for (int i = D0; i < D; ++i) s[i-D0] += p1[i] * p2[i];
+    
+    return sum_lanes(s);
+}
+
+// -----------------------------------------------------------------------------
+float calc_inner_product_generic(   // calc inner product (sequential)
     int   dim,                          // dimensionality
     const float *p1,                    // 1st point
     const float *p2);                   // 2nd point
 
+// -----------------------------------------------------------------------------
+inline float calc_inner_product(    // calc inner product
+    int   dim,                          // dimensionality
+    const float *p1,                    // 1st point
+    const float *p2)                    // 2nd point
+{
+    switch (dim) {
+    case 100: return calc_inner_product<100>(p1, p2);
+    case 128: return calc_inner_product<128>(p1, p2);
+    case 150: return calc_inner_product<150>(p1, p2);
+    case 256: return calc_inner_product<256>(p1, p2);
+    case 420: return calc_inner_product<420>(p1, p2);
+    case 960: return calc_inner_product<960>(p1, p2);
+    default:  return calc_inner_product_generic(dim, p1, p2);
+    }
+}
+
+// -----------------------------------------------------------------------------
+void calc_inner_products(           // calc inner products of a tile
+    int   m,                            // number of 1st points
+    int   n,                            // number of 2nd points
+    int   dim,                          // dimensionality
+    const float *p1,                    // 1st points (m x dim)
+    const float *p2,                    // 2nd points (transposed, dim x n)
+    float *ips);                        // inner products (m x n) (return)
+
 // -----------------------------------------------------------------------------
 float calc_cosine_angle(            // calc cosine angle, [-1,1]
     int   dim,                          // dimensionality
@@ -216,6 +423,23 @@ float shift_data_and_norms(         // calc shifted data and their l2-norm sqrs
     float *shift_data,                  // shifted data vectors (return)
     float *shift_norms);                // shifted l2-norm sqrs (return)
 
+// -----------------------------------------------------------------------------
+void normalize_data(                // normalize data to unit l2-norms
+    int   n,                            // number of data vectors
+    int   d,                            // dimensionality
+    const float *data,                  // data vectors
+    float *norms,                       // l2-norms (return, nullptr: none)
+    float *norm_data);                  // normalized data vectors (return)
+
+// -----------------------------------------------------------------------------
+void sort_by_norm(                  // sort data in descending order of l2-norm
+    int   n,                            // number of data vectors
+    int   d,                            // dimensionality
+    const float *data,                  // data vectors
+    int   *data_index,                  // index of sorted data (return)
+    float *data_norms,                  // l2-norms of sorted data (return)
+    float *data_set);                   // sorted data vectors (return)
+
 // -----------------------------------------------------------------------------
 void linear_scan(                   // linear scan user_set for k-mips
     int m,                              // number of user vectors
@@ -26,6 +26,7 @@
 // -----------------------------------------------------------------------------
 const unsigned int K_MAX = 50;      // k_max
 const float COEFF = 4.0f;           // constant for O(k_max)
+const uint32_t LB_MAGIC = 0x424C4B52; // magic of precomputed lower bounds
 
 const unsigned int THREAD_NUM = 1;  // # threads
 const unsigned int RANDOM_SEED = 6; // random seed
@@ -23,6 +23,35 @@ int read_data(                     // read binary data from disk
     return 0;
 }
 
+// -----------------------------------------------------------------------------
+uint64_t calc_dataset_hash(         // calc the hash of item_set and user_set
+    unsigned int d,                     // data dimensionality
+    const std::vector<data> &item_set,  // set of item vectors (input order)
+    const std::vector<data> &user_set)  // set of user vectors (input order)
+{
+    // FNV-1a hash over the 32-bit words of (n, m, d, item_set, user_set),
+    // which is the key of the lower bounds precomputed by rmips -alg 10
+    const uint64_t prime = 1099511628211UL;
+    uint64_t hash = 14695981039346656037UL;
+    
+    uint32_t sizes[3] = { (uint32_t) item_set.size(), 
+        (uint32_t) user_set.size(), d };
+    for (int i = 0; i < 3; ++i) { hash ^= sizes[i]; hash *= prime; }
+    
+    uint32_t word = 0;
+    for (auto& item : item_set) {
+        for (float x : item.vec_) {
+            memcpy(&word, &x, sizeof(float)); hash ^= word; hash *= prime;
+        }
+    }
+    for (auto& user : user_set) {
+        for (float x : user.vec_) {
+            memcpy(&word, &x, sizeof(float)); hash ^= word; hash *= prime;
+        }
+    }
+    return hash;
+}
+
 // -----------------------------------------------------------------------------
 void get_current_time()             // get current time
 {
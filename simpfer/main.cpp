@@ -32,6 +32,7 @@ int main(int nargs, char **args)
     char users_addr[200];           // address of user  set
     char query_addr[200];           // address of query set
     char out_folder[200];           // output folder
+    char lb_addr[200] = "";         // address of lower bounds (optional)
     
     while (cnt < nargs) {
         if (strcmp(args[cnt], "-n") == 0) {
@@ -55,6 +56,9 @@ int main(int nargs, char **args)
         else if (strcmp(args[cnt], "-qs") == 0) {
             strncpy(query_addr, args[++cnt], sizeof(query_addr));
         }
+        else if (strcmp(args[cnt], "-lb") == 0) {
+            strncpy(lb_addr, args[++cnt], sizeof(lb_addr));
+        }
         else if (strcmp(args[cnt], "-of") == 0) {
             strncpy(out_folder,  args[++cnt], sizeof(out_folder));
             create_dir(out_folder);
@@ -73,6 +77,7 @@ int main(int nargs, char **args)
     std::cout << " users address  = " << users_addr << "\n";
     std::cout << " query address  = " << query_addr << "\n";
     std::cout << " output folder  = " << out_folder  << "\n";
+    std::cout << " lower bounds   = " << lb_addr    << "\n";
     std::cout << "--------------------------------------------------------\n\n";
     
     // -------------------------------------------------------------------------
@@ -85,6 +90,10 @@ int main(int nargs, char **args)
     if (read_data(m,  d, users_addr, user_set))  exit(1);
     if (read_data(qn, d, query_addr, query_set)) exit(1);
     
+    // the key of precomputed lower bounds (in the input order)
+    uint64_t hash = lb_addr[0] != '\0' ? 
+        calc_dataset_hash(d, item_set, user_set) : 0UL;
+    
     // print the current time
     get_current_time();
     
@@ -94,7 +103,7 @@ int main(int nargs, char **args)
     char fname[200]; sprintf(fname, "%ssimpfer.csv", out_folder);
     std::vector<block> block_set;     // set of blocks
     
-    pre_processing(d, item_set, user_set, block_set);
+    pre_processing(d, lb_addr, hash, item_set, user_set, block_set);
     output_pre_processing_results(fname);
     
     // -------------------------------------------------------------------------
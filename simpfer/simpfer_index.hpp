@@ -65,6 +65,49 @@ void compute_lowerbound(            // lower-bound computation
     printf("Lower-bound computation time: %lf Seconds\n", g_time_lb_computation/1000000.0);
 }
 
+// -----------------------------------------------------------------------------
+int load_lowerbound(                // load precomputed lower-bounds
+    unsigned int dimensionality,        // data dimensionality
+    uint64_t hash,                      // hash of item & user sets
+    const char *fname,                  // address of lower bounds
+    std::vector<data> &user_set)        // set of user vectors (return)
+{
+    start = std::chrono::system_clock::now();
+    
+    FILE *fp = fopen(fname, "rb");
+    if (!fp) { printf("Could not open %s\n", fname); return 1; }
+    
+    // check the header (magic, m, d, k_max, n0, coeff) and the dataset hash
+    uint32_t header[6]; uint64_t key = 0UL;
+    unsigned int m = user_set.size();
+    if (fread(header, sizeof(uint32_t), 6, fp) != 6 || 
+        fread(&key, sizeof(uint64_t), 1, fp) != 1 || header[0] != LB_MAGIC ||
+        header[1] != m || header[2] != dimensionality || header[3] != K_MAX || 
+        key != hash) {
+        printf("Lower bounds %s do not match the dataset\n", fname);
+        fclose(fp); return 1;
+    }
+    
+    // the lower bounds of raw users are stored in the input order of users
+    std::vector<float> lbs((uint64_t) m*K_MAX);
+    if (fread(lbs.data(), sizeof(float), lbs.size(), fp) != lbs.size()) {
+        printf("Could not read %s\n", fname);
+        fclose(fp); return 1;
+    }
+    fclose(fp);
+    
+    for (unsigned int i = 0; i < m; ++i) {
+        const float *lb = lbs.data() + (uint64_t) user_set[i].identifier_*K_MAX;
+        user_set[i].lowerbound_array_.assign(lb, lb + K_MAX);
+    }
+    end = std::chrono::system_clock::now();
+    g_time_lb_computation = (double) std::chrono::duration_cast<std::chrono::microseconds> (end-start).count();
+    g_time_pre_processing += g_time_lb_computation;
+    printf("Lower-bound loading time (n0 = %u): %lf Seconds\n", header[4], 
+        g_time_lb_computation/1000000.0);
+    return 0;
+}
+
 // -----------------------------------------------------------------------------
 void blocking(                      // blocking
     std::vector<data>  &user_set,       // set of user vectors (return)
@@ -101,6 +144,8 @@ void blocking(                      // blocking
 // -----------------------------------------------------------------------------
 void pre_processing(                // pre-process item & user sets & build block
     unsigned int dimensionality,        // data dimensionality
+    const char *lb_addr,                // address of lower bounds ("": none)
+    uint64_t hash,                      // hash of item & user sets
     std::vector<data>  &item_set,       // set of item vectors (return)
     std::vector<data>  &user_set,       // set of user vectors (return)
     std::vector<block> &block_set)      // set of blocks (return)
@@ -108,8 +153,11 @@ void pre_processing(                // pre-process item & user sets & build bloc
     // norm computation for item_set and user_set and sorting
     compute_norm(item_set, user_set);
 
-    // lower-bound computation for user_set
-    compute_lowerbound(dimensionality, item_set, user_set);
+    // lower-bound computation for user_set (unless precomputed)
+    if (lb_addr[0] == '\0' || 
+        load_lowerbound(dimensionality, hash, lb_addr, user_set)) {
+        compute_lowerbound(dimensionality, item_set, user_set);
+    }
 
     // build blocks for user_set
     blocking(user_set, block_set);